@@ -0,0 +1,10 @@
+#include "stdafx.h"
+#include "AircraftStateCache.h"
+
+void AircraftStateCache::markDirty(const std::string& callsign, uint32_t flags) {
+    records[callsign].dirty |= flags;
+}
+
+void AircraftStateCache::remove(const std::string& callsign) {
+    records.erase(callsign);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "AmanDataTypes.h"
+
+// Traffic state kept up to date from EuroScope's update callbacks, indexed by callsign.
+// Callbacks only mark records dirty; OnTimer re-reads the dirty records that matter to a
+// subscribed airport, so clean aircraft cost nothing per tick. Each record is both a possible
+// arrival at its destination and a possible departure from its origin.
+class AircraftStateCache {
+public:
+    enum DirtyFlags : uint32_t {
+        AirportsDirty = 1 << 0,         // Flight plan changed, origin and destination have to be read again
+        DataDirty = 1 << 1,             // Anything else changed, arrival has to be rebuilt before it is sent
+        DepartureDirty = 1 << 2,        // Flight plan or ground speed changed, departure has to be read again
+        AllDirty = AirportsDirty | DataDirty | DepartureDirty
+    };
+
+    struct Record {
+        std::string origin;
+        std::string destination;
+        AmanAircraft arrival;           // Valid once revision is set
+        uint64_t revision = 0;          // Changes whenever `arrival` is rebuilt; unique across records
+        // Valid once departureRead is set, except for estimatedDepartureTime which depends on the day
+        DmanAircraft departure;
+        int departureMinute = -1;       // Minute of the UTC day the flight plan gives, -1 when it has none
+        bool hasRadarTarget = false;
+        bool departed = false;          // Seen airborne since the origin was last read
+        bool departureRead = false;
+        uint32_t dirty = AllDirty;
+    };
+
+    // Creates the record if the callsign is new
+    void markDirty(const std::string& callsign, uint32_t flags);
+    void remove(const std::string& callsign);
+
+    std::unordered_map<std::string, Record>& getRecords() { return records; }
+
+private:
+    std::unordered_map<std::string, Record> records;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,7 @@ struct RouteFix {
     double latitude;
     double longitude;
     bool isPassed;
+    uint32_t fixId;     // In the FixDictionary
 };
 
 class AmanAircraft {
@@ -28,6 +30,9 @@ public:
     std::string assignedDirectRouting;
     std::string scratchPad;
     std::vector<RouteFix> remainingRoute;
+    uint64_t routeFingerprint = 0;      // Of the extracted route the points were read from
+    uint32_t routeVersion = 0;          // Goes up whenever the points themselves change
+    int nextFixIndex = 0;               // First point of remainingRoute that is not passed
     std::string trackingController;
     std::string arrivalAirportIcao;
 
@@ -65,4 +70,12 @@ struct ControllerInfo {
     std::string callsign;
     std::string positionId;
     int facilityType;
-};
\ No newline at end of file
+};
+// Outcome of a client command, sent back when the command carried a requestId
+struct CommandResult {
+    std::string requestId;
+    std::string command;
+    std::string callsign;
+    std::string status;         // applied, failed or superseded
+    std::string error;
+};
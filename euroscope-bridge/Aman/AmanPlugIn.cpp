@@ -2,18 +2,21 @@
 
 #include "AmanDataTypes.h"
 #include "AmanPlugIn.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "StringUtils.h"
+#include "Tracing.h"
 #include "windows.h"
 
 #include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <ctime>
 #include <iterator>
-#include <regex>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <map>
-#include <iostream>
 
 #define TO_UPPERCASE(str) std::transform(str.begin(), str.end(), str.begin(), ::toupper);
 #define REMOVE_EMPTY(strVec, output)                                                                                   \
@@ -29,6 +32,40 @@
 #define MY_PLUGIN_DEVELOPER     CONTRIBUTORS
 #define MY_PLUGIN_COPYRIGHT     "GPL v3"
 
+// OnTimer ticks between two bridgeStats messages
+static const int BRIDGE_STATS_INTERVAL_SECONDS = 10;
+// Bounds the EuroScope API reads per tick. A busy sector has a few hundred arrivals, each
+// reporting every five seconds, so this is only reached after a burst such as a reconnect.
+static const int MAX_ARRIVAL_UPDATES_PER_TICK = 500;
+// Below this, an aircraft is on the ground: an arrival that landed, or a departure yet to take off
+static const int AIRBORNE_GROUND_SPEED = 60;
+static const long SECONDS_PER_DAY = 24 * 60 * 60;
+
+// HHMM to minutes since midnight, or -1 when it is anything else
+static int parseDepartureMinute(const char* departureTime) {
+    for (int i = 0; i < 4; i++) {
+        if (departureTime[i] < '0' || departureTime[i] > '9') {
+            return -1;
+        }
+    }
+    if (departureTime[4] != '\0') {
+        return -1;
+    }
+    int hour = (departureTime[0] - '0') * 10 + (departureTime[1] - '0');
+    int minute = (departureTime[2] - '0') * 10 + (departureTime[3] - '0');
+    if (hour > 23 || minute > 59) {
+        return -1;
+    }
+    return hour * 60 + minute;
+}
+
+// A whole number of minutes, zero or more, as typed after a command
+static bool parseMinutes(const std::string& text, int& minutes) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, minutes);
+    return result.ec == std::errc() && result.ptr == end && minutes >= 0;
+}
+
 AmanPlugIn::AmanPlugIn() 
     : CPlugIn(COMPATIBILITY_CODE, MY_PLUGIN_NAME, MY_PLUGIN_VERSION, MY_PLUGIN_DEVELOPER, MY_PLUGIN_COPYRIGHT)
     , AmanServer()
@@ -38,45 +75,461 @@ AmanPlugIn::AmanPlugIn()
     char fullPluginPath[_MAX_PATH];
     GetModuleFileNameA((HINSTANCE)&__ImageBase, fullPluginPath, sizeof(fullPluginPath));
     std::string fullPluginPathStr(fullPluginPath);
-    pluginDirectory = fullPluginPathStr.substr(0, fullPluginPathStr.find_last_of("\\"));
+    pluginDirectory = fullPluginPathStr.substr(0, fullPluginPathStr.find_last_of("\\/"));
+    Logger::start(getPluginFilePath("aman-bridge.log"));
+
+    Tracing::setThreadName("EuroScope");
+    pipeline.start([this](TrafficSnapshot& snapshot) { publishSnapshot(snapshot); });
 }
 
 AmanPlugIn::~AmanPlugIn() { 
-    
+    // Both threads stop before the members they use go away. The I/O thread first: its handlers
+    // fill commandQueue, and ~AmanServer only runs after the members of this class are destroyed.
+    AmanServer::stop();
+    pipeline.stop();
 }
 
 void AmanPlugIn::OnTimer(int Counter) {
-    std::cout << "OnTimer called, Counter: " << Counter << std::endl;
-    
-    for each(auto& airportIcao in airportsSubscribedTo) {
-        auto inbounds = getInboundsForAirport(airportIcao);
-        auto inboundsJson = jsonSerializer.getJsonOfArrivals(inbounds);
-        std::cout << "Enqueueing inbounds message: " << inboundsJson.substr(0, 100) << "..." << std::endl;
-        enqueueMessage(inboundsJson);
+    TraceSpan span("OnTimer", Counter);
+    static LatencyHistogram& tickLatency = Metrics::histogram("aman_tick_micros", "Duration of OnTimer on the EuroScope thread");
+    ScopedLatency tickTimer(tickLatency);
+    LOG_DEBUG("OnTimer called, Counter: ", Counter);
+
+    PublishBatch batch(*this);
+
+    // Client commands received since the last tick are applied before the traffic is read
+    runQueuedCommands();
+
+    // Flight plans filed before the plugin was loaded raise no update until they change
+    if (!flightPlansSeeded) {
+        for (CFlightPlan fp = FlightPlanSelectFirst(); fp.IsValid(); fp = FlightPlanSelectNext(fp)) {
+            aircraftStates.markDirty(fp.GetCallsign(), AircraftStateCache::AllDirty);
+        }
+        flightPlansSeeded = true;
     }
 
-    for each(auto & airportIcao in airportsSubscribedTo) {
-        auto outbounds = getOutboundsFromAirport(airportIcao);
-        auto outboundsJson = jsonSerializer.getJsonOfDepartures(outbounds);
-        std::cout << "Enqueueing outbounds message: " << outboundsJson.substr(0, 100) << "..." << std::endl;
-        enqueueMessage(outboundsJson);
+    // Only what needs the EuroScope API happens here; serializing is left to the publisher thread
+    TrafficSnapshot& snapshot = pipeline.acquire();
+    snapshot.counter = Counter;
+    snapshot.airportCount = 0;
+    {
+        SubscriptionRegistry::Reader subscriptions(getSubscriptions());
+        for (auto& subscribed : subscriptions->airports) {
+            auto& airport = recycleNext(snapshot.airports, snapshot.airportCount);
+            airport.icao = subscribed.icao;
+            airport.inboundCount = 0;
+            airport.outboundCount = 0;
+        }
     }
+    indexSnapshotAirports(snapshot);
+
+    // One pass over the cached aircraft for arrivals and one for departures
+    collectInbounds(snapshot);
+    collectOutbounds(snapshot);
 
     auto me = this->ControllerMyself();
-    if (me.IsValid()) {
-        ControllerInfo controllerInfo;
-        controllerInfo.positionId = me.GetPositionId();
-        controllerInfo.callsign = me.GetCallsign();
-        controllerInfo.facilityType = me.GetFacility();
-        auto controllerInfoJson = jsonSerializer.getJsonOfControllerInfo(controllerInfo);
-        enqueueMessage(controllerInfoJson);
+    snapshot.hasController = me.IsValid();
+    if (snapshot.hasController) {
+        snapshot.controller.positionId = me.GetPositionId();
+        snapshot.controller.callsign = me.GetCallsign();
+        snapshot.controller.facilityType = me.GetFacility();
+    }
+
+    pipeline.submit();
+}
+
+void AmanPlugIn::publishSnapshot(TrafficSnapshot& snapshot) {
+    TraceSpan span("publishSnapshot", snapshot.counter);
+    // Each message is serialized once and shared by every client subscribed to the airport.
+    // The whole tick is handed to the I/O thread at once, so each client gets a single write.
+    PublishBatch batch(*this);
+    publishCount++;
+
+    for (size_t a = 0; a < snapshot.airportCount; a++) {
+        auto& airport = snapshot.airports[a];
+        auto& airportIcao = airport.icao;
+        serializeArrivals(airport);
+        inboundAircraft.clear();
+        for (size_t i = 0; i < airport.inboundCount; i++) {
+            inboundAircraft.push_back(&airport.inbounds[i].aircraft);
+        }
+
+        // What this tick has to be serialized as: the arrival fields of each full subscription
+        // that is due, and whether anyone takes a delta stream or full departures now. The Reader
+        // is only held for this scan, so versions replaced meanwhile are not kept for the whole tick.
+        arrivalFieldSets.clear();
+        bool arrivalsDelta = false;
+        bool departuresDelta = false;
+        bool departuresDue = false;
+        {
+            SubscriptionRegistry::Reader subscriptions(getSubscriptions());
+            auto subscribed = subscriptions->find(airportIcao);
+            for (size_t i = 0; subscribed != nullptr && i < subscribed->subscribers.size(); i++) {
+                auto& options = subscribed->subscribers[i].options;
+                if (options.usesDelta("arrivals")) {
+                    arrivalsDelta = true;
+                } else if (options.isDue(snapshot.counter)
+                    && std::find(arrivalFieldSets.begin(), arrivalFieldSets.end(), options.arrivalFields) == arrivalFieldSets.end()) {
+                    arrivalFieldSets.push_back(options.arrivalFields);
+                }
+                if (options.usesDelta("departures")) {
+                    departuresDelta = true;
+                } else {
+                    departuresDue |= options.isDue(snapshot.counter);
+                }
+            }
+        }
+
+        for (uint32_t fields : arrivalFieldSets) {
+            AmanServer::Audience audience(snapshot.counter, fields);
+            if (fields != ArrivalAllFields) {
+                // Rarely used, so not worth caching per aircraft like the complete ones
+                TraceSpan serializeSpan("writeArrivalFields", airportIcao);
+                jsonSerializer.writeArrivals(inboundAircraft, fields, publishBuffer);
+                publishToSubscribers(airportIcao, "arrivals", publishBuffer, std::string(), audience);
+                continue;
+            }
+
+            {
+                TraceSpan serializeSpan("writeArrivals", airportIcao);
+                ScopedLatency serializeTimer(serializeLatency(airportIcao, "arrivals"));
+                inboundsJson.clear();
+                for (auto serialized : airportArrivals) {
+                    inboundsJson.push_back(&serialized->json);
+                }
+                jsonSerializer.writeArrivals(inboundsJson, publishBuffer);
+            }
+            std::string arrivalsCbor;
+            if (hasCborClients()) {
+                std::string envelope;
+                jsonSerializer.writeArrivals({}, envelope);
+                arrivalsCbor = encodeArrivalsCbor(envelope, airport);
+            }
+            LOG_DEBUG("Enqueueing arrivals for ", airportIcao, ": ", airport.inboundCount, " aircraft, ", publishBuffer.size(), " bytes");
+            publishToSubscribers(airportIcao, "arrivals", publishBuffer, std::move(arrivalsCbor), audience);
+        }
+
+        if (arrivalsDelta) {
+            publishArrivalsDelta(airport, isSnapshotPending(airportIcao, "arrivals"));
+        } else {
+            arrivalsDeltaTrackers.erase(airportIcao);
+        }
+
+        if (departuresDue) {
+            {
+                TraceSpan serializeSpan("writeDepartures", airportIcao);
+                ScopedLatency serializeTimer(serializeLatency(airportIcao, "departures"));
+                jsonSerializer.writeDepartures(airport.outbounds, airport.outboundCount, publishBuffer);
+            }
+            LOG_DEBUG("Enqueueing departures for ", airportIcao, ": ", airport.outboundCount, " aircraft, ", publishBuffer.size(), " bytes");
+            publishToSubscribers(airportIcao, "departures", publishBuffer, std::string(), Audience(snapshot.counter));
+        }
+
+        if (departuresDelta) {
+            publishDeparturesDelta(airport, isSnapshotPending(airportIcao, "departures"));
+        } else {
+            departuresDeltaTrackers.erase(airportIcao);
+        }
+    }
+
+    // Nobody left to diff against for airports that lost all subscribers
+    auto firstAirport = snapshot.airports.begin();
+    auto lastAirport = firstAirport + snapshot.airportCount;
+    auto isSubscribed = [firstAirport, lastAirport](const std::string& icao) {
+        return std::any_of(firstAirport, lastAirport, [&icao](const TrafficSnapshot::Airport& airport) {
+            return airport.icao == icao;
+        });
+    };
+    for (auto it = arrivalsDeltaTrackers.begin(); it != arrivalsDeltaTrackers.end();) {
+        if (!isSubscribed(it->first)) {
+            it = arrivalsDeltaTrackers.erase(it);
+        } else {
+            it++;
+        }
+    }
+    for (auto it = departuresDeltaTrackers.begin(); it != departuresDeltaTrackers.end();) {
+        if (!isSubscribed(it->first)) {
+            it = departuresDeltaTrackers.erase(it);
+        } else {
+            it++;
+        }
+    }
+    // Nor any use for aircraft that were not in this snapshot
+    for (auto it = serializedArrivals.begin(); it != serializedArrivals.end();) {
+        if (it->second.lastPublished != publishCount) {
+            it = serializedArrivals.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    if (snapshot.hasController) {
+        jsonSerializer.writeControllerInfo(snapshot.controller, publishBuffer);
+        broadcast("controllerInfo", publishBuffer);
+    }
+
+    if (snapshot.counter % BRIDGE_STATS_INTERVAL_SECONDS == 0 && hasBridgeStatsSubscribers()) {
+        jsonSerializer.writeBridgeStats(Metrics::sample(), publishBuffer);
+        publishBridgeStats(publishBuffer);
     }
 }
 
+void AmanPlugIn::serializeArrivals(TrafficSnapshot::Airport& airport) {
+    TraceSpan span("serializeArrivals", airport.icao);
+    airportArrivals.clear();
+    for (size_t i = 0; i < airport.inboundCount; i++) {
+        auto& inbound = airport.inbounds[i];
+        auto& route = inbound.aircraft.remainingRoute;
+        auto& serialized = serializedArrivals[inbound.aircraft.callsign];
+
+        // Only aircraft OnTimer read again since they were last published are serialized again
+        if (serialized.revision != inbound.revision) {
+            serialized.routeFixIds.resize(route.size());
+            for (size_t fix = 0; fix < route.size(); fix++) {
+                auto& point = route[fix];
+                serialized.routeFixIds[fix] = fixDictionary.intern(point.name.data(), point.name.size(), point.latitude, point.longitude);
+            }
+            jsonSerializer.writeArrival(inbound.aircraft, serialized.json);
+            serialized.cbor.clear();
+            serialized.revision = inbound.revision;
+        }
+        for (size_t fix = 0; fix < route.size(); fix++) {
+            route[fix].fixId = serialized.routeFixIds[fix];
+        }
+        serialized.lastPublished = publishCount;
+        airportArrivals.push_back(&serialized);
+    }
+}
+
+LatencyHistogram& AmanPlugIn::serializeLatency(const std::string& airportIcao, const char* messageType) {
+    auto& histogram = serializeLatencies[std::make_pair(airportIcao, messageType)];
+    if (histogram == nullptr) {
+        histogram = &Metrics::histogram("aman_serialize_micros", "Serialization of a published message",
+            { { "airport", airportIcao }, { "type", messageType } });
+    }
+    return *histogram;
+}
+
+void AmanPlugIn::publishArrivalsDelta(const TrafficSnapshot::Airport& airport, bool snapshotPending) {
+    auto& airportIcao = airport.icao;
+
+    auto& tracker = arrivalsDeltaTrackers[airportIcao];
+    auto& delta = arrivalsDelta;
+    {
+        TraceSpan span("diffArrivals", airportIcao);
+        tracker.update(inboundAircraft, delta);
+    }
+
+    // Written into the reused buffer; only the published copy is allocated
+    std::string deltaJson;
+    if (!delta.empty()) {
+        TraceSpan span("writeArrivalsDelta", airportIcao);
+        jsonSerializer.writeArrivalsDelta(airportIcao, delta, publishBuffer);
+        deltaJson = publishBuffer;
+    }
+
+    // Only write the full list when a client just subscribed or asked for a resync
+    std::string snapshotJson;
+    if (snapshotPending) {
+        TraceSpan span("writeArrivalsSnapshot", airportIcao);
+        jsonSerializer.writeArrivalsSnapshot(airportIcao, tracker.getSequence(), inboundAircraft, snapshotJson);
+    }
+
+    DeltaDictionary dictionary;
+    dictionary.size = fixDictionary.size();
+    dictionary.serializeFrom = [this](uint32_t firstId) {
+        std::string json;
+        jsonSerializer.writeFixDictionary(fixDictionary, firstId, json);
+        return json;
+    };
+    publishDelta(airportIcao, "arrivals", std::move(deltaJson), std::move(snapshotJson), std::string(), &dictionary);
+}
+
+void AmanPlugIn::publishDeparturesDelta(const TrafficSnapshot::Airport& airport, bool snapshotPending) {
+    auto& airportIcao = airport.icao;
+
+    auto& tracker = departuresDeltaTrackers[airportIcao];
+    {
+        TraceSpan span("diffDepartures", airportIcao);
+        tracker.update(airport.outbounds, airport.outboundCount, departuresDelta);
+    }
+
+    std::string deltaJson;
+    if (!departuresDelta.empty()) {
+        TraceSpan span("writeDeparturesDelta", airportIcao);
+        jsonSerializer.writeDeparturesDelta(airportIcao, departuresDelta, publishBuffer);
+        deltaJson = publishBuffer;
+    }
+
+    std::string snapshotJson;
+    if (snapshotPending) {
+        TraceSpan span("writeDeparturesSnapshot", airportIcao);
+        jsonSerializer.writeDeparturesSnapshot(airportIcao, tracker.getSequence(), airport.outbounds, airport.outboundCount, snapshotJson);
+    }
+
+    publishDelta(airportIcao, "departures", std::move(deltaJson), std::move(snapshotJson), std::string(), nullptr);
+}
+
+std::string AmanPlugIn::encodeArrivalsCbor(const std::string& envelopeJson, const TrafficSnapshot::Airport& airport) {
+    TraceSpan span("encodeArrivalsCbor");
+    std::vector<const std::string*> inboundsCbor;
+    inboundsCbor.reserve(airportArrivals.size());
+    for (size_t i = 0; i < airportArrivals.size(); i++) {
+        // Only aircraft that changed since they were last sent to a CBOR client are encoded again
+        auto serialized = airportArrivals[i];
+        if (serialized->cbor.empty()) {
+            jsonSerializer.writeArrivalCbor(airport.inbounds[i].aircraft, serialized->cbor);
+        }
+        inboundsCbor.push_back(&serialized->cbor);
+    }
+
+    std::string frame;
+    encodeCborFrameWithItems(envelopeJson, inboundsCbor, frame);
+    return frame;
+}
+
+void AmanPlugIn::OnRadarTargetPositionUpdate(CRadarTarget RadarTarget) {
+    // Position, speeds and the passed part of the route; the ground speed also shows a departure took off
+    aircraftStates.markDirty(RadarTarget.GetCallsign(), AircraftStateCache::DataDirty | AircraftStateCache::DepartureDirty);
+}
+
+void AmanPlugIn::OnFlightPlanFlightPlanDataUpdate(CFlightPlan FlightPlan) {
+    // Origin, destination, SID, STAR, runways, type, TAS, route and departure time may all have changed
+    aircraftStates.markDirty(FlightPlan.GetCallsign(), AircraftStateCache::AllDirty);
+}
+
+void AmanPlugIn::OnFlightPlanControllerAssignedDataUpdate(CFlightPlan FlightPlan, int DataType) {
+    // Scratchpad and direct-to are the only controller assigned data sent to clients
+    if (DataType == CTR_DATA_TYPE_SCRATCH_PAD_STRING || DataType == CTR_DATA_TYPE_DIRECT_TO) {
+        aircraftStates.markDirty(FlightPlan.GetCallsign(), AircraftStateCache::DataDirty);
+    }
+}
+
+void AmanPlugIn::OnFlightPlanDisconnect(CFlightPlan FlightPlan) {
+    aircraftStates.remove(FlightPlan.GetCallsign());
+}
+
 void AmanPlugIn::OnAirportRunwayActivityChanged(void) {
+    TraceSpan span("runwayActivityChanged");
+    runwayIndex.rebuild(*this);
     sendUpdatedRunwayStatuses();
 }
 
+// .aman capture on [file]   Record the client sessions, by default to a timestamped file next to the DLL
+// .aman capture off
+// .aman trace on            Record timing spans of the bridge threads
+// .aman trace off [file]    Stop and write them as Chrome trace JSON, by default next to the DLL
+// .aman log debug|info|warning|error   Least severe level written to aman-bridge.log
+// .aman metrics on [port]   Serve Prometheus metrics on 127.0.0.1, port 9464 by default
+// .aman metrics off
+bool AmanPlugIn::OnCompileCommand(const char* sCommandLine) {
+    auto words = splitString(sCommandLine, ' ');
+    if (words.size() < 3 || words[0] != ".aman") {
+        return false;
+    }
+    std::string action(words[2]);
+    std::string path(words.size() > 3 ? words[3] : std::string_view());
+
+    if (words[1] == "capture" && action == "on") {
+        if (path.empty()) {
+            path = getTimestampedPath("aman-%Y%m%d-%H%M%S.amancap");
+        }
+        if (isCapturing()) {
+            DISPLAY_WARNING("A capture is already running");
+        } else if (startCapture(path)) {
+            DisplayUserMessage("Aman", "Capture", ("Capturing client sessions to " + path).c_str(), true, true, false, false, false);
+        } else {
+            DISPLAY_WARNING(("Cannot write capture file " + path).c_str());
+        }
+        return true;
+    }
+    if (words[1] == "capture" && action == "off") {
+        stopCapture();
+        DisplayUserMessage("Aman", "Capture", "Capture stopped", true, true, false, false, false);
+        return true;
+    }
+
+    if (words[1] == "log") {
+        static const std::map<std::string, LogLevel> levels = {
+            { "debug", LogDebug }, { "info", LogInfo }, { "warning", LogWarning }, { "error", LogError }
+        };
+        auto level = levels.find(action);
+        if (level == levels.end()) {
+            return false;
+        }
+        Logger::setLevel(level->second);
+        DisplayUserMessage("Aman", "Log", ("Logging " + action + " and above").c_str(), true, true, false, false, false);
+        return true;
+    }
+
+    if (words[1] == "trace" && action == "on") {
+        Tracing::start();
+        DisplayUserMessage("Aman", "Trace", "Tracing started", true, true, false, false, false);
+        return true;
+    }
+    if (words[1] == "trace" && action == "off") {
+        Tracing::stop();
+        if (path.empty()) {
+            path = getTimestampedPath("aman-trace-%Y%m%d-%H%M%S.json");
+        }
+        if (Tracing::writeChromeTrace(path)) {
+            DisplayUserMessage("Aman", "Trace", ("Trace written to " + path).c_str(), true, true, false, false, false);
+        } else {
+            DISPLAY_WARNING(("Cannot write trace file " + path).c_str());
+        }
+        return true;
+    }
+
+    if (words[1] == "metrics" && action == "on") {
+        int port = path.empty() ? MetricsEndpoint::DEFAULT_PORT : atoi(path.c_str());
+        if (metricsEndpoint.isRunning()) {
+            DISPLAY_WARNING(("Metrics are already served on port " + std::to_string(metricsEndpoint.getPort())).c_str());
+        } else if (port > 0 && port < 65536 && metricsEndpoint.start(port)) {
+            DisplayUserMessage("Aman", "Metrics", ("Serving metrics at http://127.0.0.1:" + std::to_string(port) + "/metrics").c_str(), true, true, false, false, false);
+        } else {
+            DISPLAY_WARNING(("Cannot serve metrics on port " + path).c_str());
+        }
+        return true;
+    }
+    if (words[1] == "metrics" && action == "off") {
+        metricsEndpoint.stop();
+        DisplayUserMessage("Aman", "Metrics", "Metrics endpoint stopped", true, true, false, false, false);
+        return true;
+    }
+
+    if (words[1] == "departures") {
+        int minutesPast;
+        int minutesAhead;
+        if (!parseMinutes(action, minutesPast) || !parseMinutes(path, minutesAhead)) {
+            DISPLAY_WARNING("Usage: .aman departures <minutes past> <minutes ahead>");
+            return true;
+        }
+        departuresMinutesPast = minutesPast;
+        departuresMinutesAhead = minutesAhead;
+        DisplayUserMessage("Aman", "Departures", ("Listing flight plans due to depart from " + action + " minutes ago to " + path + " minutes ahead").c_str(), true, true, false, false, false);
+        return true;
+    }
+    return false;
+}
+
+std::string AmanPlugIn::getTimestampedPath(const char* nameFormat) {
+    struct tm tm {};
+    time_t now;
+    time(&now);
+    gmtime_s(&tm, &now);
+    char name[64];
+    strftime(name, sizeof(name), nameFormat, &tm);
+    return getPluginFilePath(name);
+}
+
+std::string AmanPlugIn::getPluginFilePath(const std::string& fileName) {
+#ifdef _WIN32
+    return pluginDirectory + "\\" + fileName;
+#else
+    return pluginDirectory + "/" + fileName;
+#endif
+}
+
 bool AmanPlugIn::hasCorrectDestination(CFlightPlanData fpd, std::vector<std::string> destinationAirports) {
     return destinationAirports.size() == 0 ? 
         true : std::find(destinationAirports.begin(), destinationAirports.end(), fpd.GetDestination()) != destinationAirports.end();
@@ -100,7 +553,11 @@ int AmanPlugIn::getFirstViaFixIndex(CFlightPlanExtractedRoute extractedRoute, st
     return -1;
 }
 
-std::vector<RouteFix> AmanPlugIn::findExtractedRoutePoints(CRadarTarget radarTarget) {
+// Routes only change on a flight plan amendment or a direct-to. The points are read again only
+// when the fingerprint of the extracted route (point count, assigned direct and point names)
+// changed; otherwise just the passed flags move along.
+void AmanPlugIn::updateRoute(CRadarTarget radarTarget, AmanAircraft& ac) {
+    TraceSpan span("extractRoute");
     auto extractedRoute = radarTarget.GetCorrelatedFlightPlan().GetExtractedRoute();
     int closestFixIndex = extractedRoute.GetPointsCalculatedIndex();
     int assignedDirectFixIndex = extractedRoute.GetPointsAssignedIndex();
@@ -108,279 +565,426 @@ std::vector<RouteFix> AmanPlugIn::findExtractedRoutePoints(CRadarTarget radarTar
 
     int nextFixIndex = assignedDirectFixIndex > -1 ? assignedDirectFixIndex : closestFixIndex;
 
-    std::vector<RouteFix> route;
-
-    // Ignore waypoints prior to nextFixIndex
+    // FNV-1a
+    uint64_t fingerprint = 14695981039346656037ull;
+    auto mix = [&fingerprint](const char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            fingerprint = (fingerprint ^ (uint8_t)data[i]) * 1099511628211ull;
+        }
+    };
+    mix((const char*)&routeLength, sizeof(routeLength));
+    mix((const char*)&assignedDirectFixIndex, sizeof(assignedDirectFixIndex));
     for (int i = 0; i < routeLength; i++) {
-        RouteFix fix;
-        auto airwayName = extractedRoute.GetPointAirwayName(i);
-        fix.name = extractedRoute.GetPointName(i);
-        fix.latitude = extractedRoute.GetPointPosition(i).m_Latitude;
-        fix.longitude = extractedRoute.GetPointPosition(i).m_Longitude;
-        fix.isPassed = i < nextFixIndex;
-        route.push_back(fix);
+        const char* name = extractedRoute.GetPointName(i);
+        mix(name, strlen(name) + 1);
     }
-    return route;
-}
 
-std::vector<std::string> AmanPlugIn::splitString(const std::string& string, const char delim) {
-    std::vector<std::string> output;
-    size_t startServer;
-    size_t end = 0;
-    while ((startServer = string.find_first_not_of(delim, end)) != std::string::npos) {
-        end = string.find(delim, startServer);
-        output.push_back(string.substr(startServer, end - startServer));
+    if (ac.routeVersion == 0 || fingerprint != ac.routeFingerprint) {
+        ac.remainingRoute.resize(routeLength);
+        for (int i = 0; i < routeLength; i++) {
+            RouteFix& fix = ac.remainingRoute[i];
+            CPosition position = extractedRoute.GetPointPosition(i);
+            fix.name = extractedRoute.GetPointName(i);
+            fix.latitude = position.m_Latitude;
+            fix.longitude = position.m_Longitude;
+        }
+        ac.routeFingerprint = fingerprint;
+        ac.routeVersion++;
+    }
+
+    ac.nextFixIndex = nextFixIndex;
+    for (int i = 0; i < routeLength; i++) {
+        ac.remainingRoute[i].isPassed = i < nextFixIndex;
     }
-    return output;
 }
 
 void AmanPlugIn::sendUpdatedRunwayStatuses() {
-    for each(auto& airportIcao in airportsSubscribedTo) {
-        auto runwayStatuses = collectRunwayStatuses(airportIcao);
-        auto runwaysJson = jsonSerializer.getJsonOfRunwayStatuses(runwayStatuses);
-        enqueueMessage(runwaysJson);
+    PublishBatch batch(*this);
+    std::vector<std::string> airportsSubscribedTo;
+    getSubscribedAirports(airportsSubscribedTo);
+    for (auto& airportIcao : airportsSubscribedTo) {
+        // Clients already have the configuration of airports whose runways did not change, so
+        // this one must reach them even if their queue is full
+        if (runwayIndex.getChangedStatuses(airportIcao, runwayStatuses)) {
+            jsonSerializer.writeRunwayStatuses(runwayStatuses, messageBuffer);
+            publishToSubscribers(airportIcao, "runwayStatuses", messageBuffer, std::string(), Audience(), RetainAlways);
+        }
     }
 }
 
-void AmanPlugIn::onClientConnected() {
+void AmanPlugIn::onClientConnected(ClientId clientId) {
     // Send plugin version to the client immediately upon connection
-    auto versionMessage = jsonSerializer.getJsonOfPluginVersion(MY_PLUGIN_VERSION);
-    enqueueMessage(versionMessage);
+    std::string versionMessage;
+    jsonSerializer.writePluginVersion(MY_PLUGIN_VERSION, versionMessage);
+    sendToClient(clientId, std::move(versionMessage));
 }
 
-void AmanPlugIn::onRegisterAirport(const std::string& icao) {
-    airportsSubscribedTo.insert(icao);
-    sendUpdatedRunwayStatuses();
+void AmanPlugIn::onSelectCodec(ClientId clientId, const std::string& codecName) {
+    // An unknown codec leaves the client on JSON; the reply tells it which one it got
+    WireCodec codec = CodecJson;
+    parseWireCodec(codecName, codec);
+    std::string reply;
+    jsonSerializer.writeCodecSelected(wireCodecName(codec), reply);
+    switchCodec(clientId, codec, std::move(reply));
 }
 
-void AmanPlugIn::onUnregisterAirport(const std::string& icao) {
-    airportsSubscribedTo.erase(icao);
-}
-
-void AmanPlugIn::onRequestAssignRunway(const std::string& callsign, const std::string& runway) {
-    CRadarTarget rt = RadarTargetSelect(callsign.c_str());
-    if (rt.IsValid()) {
-        CFlightPlan fp = rt.GetCorrelatedFlightPlan();
-        if (fp.IsValid()) {
-            CFlightPlanData fpd = fp.GetFlightPlanData();
-            auto originalRoute = fpd.GetRoute();
-            auto arrivalAirport = fpd.GetDestination();
-            auto newRoute = addAssignedArrivalRunwayToRoute(originalRoute, arrivalAirport, runway);
-            fpd.SetRoute(newRoute.c_str());
-            fpd.AmendFlightPlan();
-        }
-    }
+void AmanPlugIn::onRegisterAirport(ClientId clientId, const std::string& icao, const SubscriptionOptions& options) {
+    subscribe(clientId, icao, options);
 
+    // Only the newly subscribed client needs the current runway configuration
+    PluginCommand command;
+    command.type = PluginCommand::SendRunwayStatuses;
+    command.clientId = clientId;
+    command.airportIcao = icao;
+    commandQueue.push(std::move(command));
 }
 
-void AmanPlugIn::onSetCtot(const std::string& callSign, long ctot) {
-    CRadarTarget rt = RadarTargetSelect(callSign.c_str());
-    if (rt.IsValid()) {
-        CFlightPlan fp = rt.GetCorrelatedFlightPlan();
-        if (fp.IsValid()) {
-            // Format ctot (unix ts) to HH:MM
-            time_t ctotTime = ctot;
-            struct tm* ctotTm = gmtime(&ctotTime);
-            char ctotStr[6];
-            strftime(ctotStr, sizeof(ctotStr), "%H:%M", ctotTm);
-            fp.GetFlightPlanData().SetEstimatedDepartureTime(ctotStr);
-        }
-    }
+void AmanPlugIn::onUnregisterAirport(ClientId clientId, const std::string& icao) {
+    unsubscribe(clientId, icao);
 }
 
-void AmanPlugIn::onClientDisconnected() {
-    // Remove all subscriptions when the client disconnects
-    airportsSubscribedTo.clear();
+void AmanPlugIn::onRequestAssignRunway(ClientId clientId, const std::string& requestId, const std::string& callsign, const std::string& runway) {
+    PluginCommand command;
+    command.type = PluginCommand::AssignRunway;
+    command.clientId = clientId;
+    command.requestId = requestId;
+    command.callsign = callsign;
+    command.runway = runway;
+    commandQueue.push(std::move(command));
 }
 
-void AmanPlugIn::onErrorProcessingMessage(const std::string& errorMessage) {
-    // Display an error message to the user
-    DISPLAY_WARNING(errorMessage.c_str());
+void AmanPlugIn::onSetCtot(ClientId clientId, const std::string& requestId, const std::string& callSign, long ctot) {
+    PluginCommand command;
+    command.type = PluginCommand::SetCtot;
+    command.clientId = clientId;
+    command.requestId = requestId;
+    command.callsign = callSign;
+    command.ctot = ctot;
+    commandQueue.push(std::move(command));
 }
 
-std::vector<AmanAircraft> AmanPlugIn::getInboundsForAirport(const std::string& airportIcao) {
-    long int timeNow = static_cast<long int>(std::time(nullptr)); // Current UNIX-timestamp in seconds
-    int transAlt = this->GetTransitionAltitude();
+void AmanPlugIn::runQueuedCommands() {
+    TraceSpan span("runQueuedCommands");
+    std::vector<PluginCommand> commands;
+    commandQueue.drain(commands);
+    if (commands.empty()) {
+        return;
+    }
 
-    CRadarTarget asel = RadarTargetSelectASEL();
-    CRadarTarget rt;
-    std::vector<AmanAircraft> aircraftList;
-    for (rt = RadarTargetSelectFirst(); rt.IsValid(); rt = RadarTargetSelectNext(rt)) {
-        float groundSpeed = rt.GetPosition().GetReportedGS();
-        if (groundSpeed < 60) {
-            continue;
+    // Last command per key wins, e.g. when a runway change re-runways the same aircraft twice
+    std::unordered_map<std::string, size_t> latestByKey;
+    for (size_t i = 0; i < commands.size(); i++) {
+        auto key = commands[i].collapseKey();
+        if (!key.empty()) {
+            latestByKey[key] = i;
         }
+    }
+
+    for (size_t i = 0; i < commands.size(); i++) {
+        auto& command = commands[i];
+        auto key = command.collapseKey();
+        bool superseded = !key.empty() && latestByKey[key] != i;
 
-        CFlightPlanData fpd = rt.GetCorrelatedFlightPlan().GetFlightPlanData();
-        if (fpd.GetDestination() != airportIcao) {
+        CommandResult result;
+        result.requestId = command.requestId;
+        result.callsign = command.callsign;
+
+        switch (command.type) {
+        case PluginCommand::AssignRunway:
+            result.command = "assignRunway";
+            if (!superseded) {
+                result.status = assignArrivalRunway(command.callsign, command.runway, result.error) ? "applied" : "failed";
+            }
+            break;
+        case PluginCommand::SetCtot:
+            result.command = "setCtot";
+            if (!superseded) {
+                result.status = setCtot(command.callsign, command.ctot, result.error) ? "applied" : "failed";
+            }
+            break;
+        case PluginCommand::SendRunwayStatuses:
+            if (!superseded) {
+                if (!runwayIndex.isBuilt()) {
+                    runwayIndex.rebuild(*this);
+                }
+                runwayIndex.getStatuses(command.airportIcao, runwayStatuses);
+                std::string runwaysJson;
+                jsonSerializer.writeRunwayStatuses(runwayStatuses, runwaysJson);
+                sendToClient(command.clientId, std::move(runwaysJson));
+            }
+            continue;
+        case PluginCommand::DisplayError:
+            DISPLAY_WARNING(command.message.c_str());
             continue;
         }
 
-        CFlightPlanExtractedRoute route = rt.GetCorrelatedFlightPlan().GetExtractedRoute();
-        bool isSelectedAircraft = asel.IsValid() && rt.GetCallsign() == asel.GetCallsign();
-        auto assignedStarName = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetStarName();
+        if (superseded) {
+            result.status = "superseded";
+        }
+        if (!command.requestId.empty()) {
+            std::string resultJson;
+            jsonSerializer.writeCommandResult(result, resultJson);
+            sendToClient(command.clientId, std::move(resultJson));
+        }
+    }
+}
 
-        AmanAircraft ac;
-        ac.callsign = rt.GetCallsign();
-        ac.arrivalRunway = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetArrivalRwy();
-        ac.assignedStar = assignedStarName;
-        ac.icaoType = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetAircraftFPType();
-        ac.assignedDirectRouting = rt.GetCorrelatedFlightPlan().GetControllerAssignedData().GetDirectToPointName();
-        ac.trackingController = rt.GetCorrelatedFlightPlan().GetTrackingControllerId();
-        ac.isSelected = isSelectedAircraft;
-        ac.scratchPad = rt.GetCorrelatedFlightPlan().GetControllerAssignedData().GetScratchPadString();
-        ac.groundSpeed = rt.GetPosition().GetReportedGS();
-        ac.pressureAltitude = rt.GetPosition().GetPressureAltitude();
-        ac.flightLevel = rt.GetPosition().GetFlightLevel();
-        ac.track = rt.GetTrackHeading();
-        ac.remainingRoute = findExtractedRoutePoints(rt);
-        ac.arrivalAirportIcao = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetDestination();
-        ac.latitude = rt.GetPosition().GetPosition().m_Latitude;
-        ac.longitude = rt.GetPosition().GetPosition().m_Longitude;
-        ac.flightPlanTas = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetTrueAirspeed();
-        aircraftList.push_back(ac);
+bool AmanPlugIn::assignArrivalRunway(const std::string& callsign, const std::string& runway, std::string& error) {
+    CRadarTarget rt = RadarTargetSelect(callsign.c_str());
+    if (!rt.IsValid()) {
+        error = "Unknown radar target";
+        return false;
+    }
+    CFlightPlan fp = rt.GetCorrelatedFlightPlan();
+    if (!fp.IsValid()) {
+        error = "No correlated flight plan";
+        return false;
     }
 
-    return aircraftList;
+    CFlightPlanData fpd = fp.GetFlightPlanData();
+    auto originalRoute = fpd.GetRoute();
+    auto arrivalAirport = fpd.GetDestination();
+    auto newRoute = withArrivalRunway(originalRoute, arrivalAirport, runway);
+    if (!fpd.SetRoute(newRoute.c_str()) || !fpd.AmendFlightPlan()) {
+        error = "Flight plan could not be amended";
+        return false;
+    }
+    return true;
 }
 
-std::vector<DmanAircraft> AmanPlugIn::getOutboundsFromAirport(const std::string& airport) {
-
-    auto departures = std::vector<DmanAircraft>();
+bool AmanPlugIn::setCtot(const std::string& callsign, long ctot, std::string& error) {
+    CRadarTarget rt = RadarTargetSelect(callsign.c_str());
+    if (!rt.IsValid()) {
+        error = "Unknown radar target";
+        return false;
+    }
+    CFlightPlan fp = rt.GetCorrelatedFlightPlan();
+    if (!fp.IsValid()) {
+        error = "No correlated flight plan";
+        return false;
+    }
 
-    // Get every flight plan
-    for (CFlightPlan fp = FlightPlanSelectFirst(); fp.IsValid(); fp = FlightPlanSelectNext(fp)) {
+    // Format ctot (unix ts) to HH:MM
+    time_t ctotTime = ctot;
+    struct tm* ctotTm = gmtime(&ctotTime);
+    char ctotStr[6];
+    strftime(ctotStr, sizeof(ctotStr), "%H:%M", ctotTm);
+    if (!fp.GetFlightPlanData().SetEstimatedDepartureTime(ctotStr)) {
+        error = "Estimated departure time could not be set";
+        return false;
+    }
+    return true;
+}
 
-        auto fpd = fp.GetFlightPlanData();
+void AmanPlugIn::onErrorProcessingMessage(const std::string& errorMessage) {
+    // Display an error message to the user, from the EuroScope thread
+    PluginCommand command;
+    command.type = PluginCommand::DisplayError;
+    command.clientId = -1;
+    command.message = errorMessage;
+    commandQueue.push(std::move(command));
+}
 
-        // Check if the flight plan is a departure
-        if (fp.GetFlightPlanData().GetOrigin() == airport) {
-            DmanAircraft ac;
-            ac.callsign = fp.GetCallsign();
-            ac.sid = fpd.GetSidName();
-            ac.runway = fpd.GetDepartureRwy();
-            const char* departureTime = fpd.GetEstimatedDepartureTime();
-            ac.estimatedDepartureTime = processDepartureTime(departureTime);
-            ac.icaoType = fpd.GetAircraftFPType();
-            ac.wakeCategory = fpd.GetAircraftWtc();
-            ac.departureAirportIcao = airport;
+void AmanPlugIn::indexSnapshotAirports(const TrafficSnapshot& snapshot) {
+    // Subscriptions rarely change, so the index is only rebuilt on the tick they did
+    bool current = snapshotAirportIndex.size() == snapshot.airportCount;
+    for (size_t a = 0; current && a < snapshot.airportCount; a++) {
+        auto slot = snapshotAirportIndex.find(snapshot.airports[a].icao);
+        current = slot != snapshotAirportIndex.end() && slot->second == a;
+    }
+    if (current) {
+        return;
+    }
 
-            departures.push_back(ac);
-        }
+    snapshotAirportIndex.clear();
+    for (size_t a = 0; a < snapshot.airportCount; a++) {
+        snapshotAirportIndex.emplace(snapshot.airports[a].icao, a);
     }
+}
 
-    return departures;
+TrafficSnapshot::Airport* AmanPlugIn::findSnapshotAirport(TrafficSnapshot& snapshot, const std::string& airportIcao) {
+    auto slot = snapshotAirportIndex.find(airportIcao);
+    return slot != snapshotAirportIndex.end() ? &snapshot.airports[slot->second] : nullptr;
 }
 
-std::vector<RunwayStatus> AmanPlugIn::collectRunwayStatuses(const std::string& airportIcao) {
-    std::vector<RunwayStatus> activeRunways;
+void AmanPlugIn::collectInbounds(TrafficSnapshot& snapshot) {
+    TraceSpan span("collectInbounds");
+    static MetricCounter& deferredUpdates = Metrics::counter("aman_arrival_updates_deferred_total",
+        "Changed arrivals left for the next tick to keep OnTimer short");
+    CRadarTarget asel = RadarTargetSelectASEL();
+    auto& records = aircraftStates.getRecords();
+    int updates = 0;
+
+    // Updates are capped in the map's iteration order, which does not change from tick to tick.
+    // After a tick that hit the cap, records before the one it stopped at wait, so the ones it
+    // deferred are read first; they are next after a tick that did not hit the cap.
+    bool reachedResumePoint = arrivalUpdatesResumeAt.empty() || records.count(arrivalUpdatesResumeAt) == 0;
+    std::string resumeAt;
+    std::swap(resumeAt, arrivalUpdatesResumeAt);
+
+    for (auto it = records.begin(); it != records.end();) {
+        auto& callsign = it->first;
+        auto& record = it->second;
+        if (!reachedResumePoint && callsign == resumeAt) {
+            reachedResumePoint = true;
+        }
 
-    for (auto airport = this->SectorFileElementSelectFirst(EuroScopePlugIn::SECTOR_ELEMENT_AIRPORT);
-         airport.IsValid();
-         airport = this->SectorFileElementSelectNext(airport, EuroScopePlugIn::SECTOR_ELEMENT_AIRPORT)) {
+        if (record.dirty & AircraftStateCache::AirportsDirty) {
+            CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+            if (!fp.IsValid()) {
+                it = records.erase(it);
+                continue;
+            }
+            auto fpd = fp.GetFlightPlanData();
+            // A new origin is a new departure, even for an aircraft that already flew today
+            if (record.origin != fpd.GetOrigin()) {
+                record.origin = fpd.GetOrigin();
+                record.departed = false;
+            }
+            record.destination = fpd.GetDestination();
+            record.dirty &= ~AircraftStateCache::AirportsDirty;
+        }
 
-        std::string currentIcao = airport.GetName();
-        if (currentIcao != airportIcao)
+        // Aircraft for airports nobody subscribed to stay dirty until someone does
+        auto airport = findSnapshotAirport(snapshot, record.destination);
+        if (airport == nullptr) {
+            it++;
             continue;
+        }
 
-        for (auto runway = this->SectorFileElementSelectFirst(EuroScopePlugIn::SECTOR_ELEMENT_RUNWAY);
-                runway.IsValid();
-                runway = this->SectorFileElementSelectNext(runway, EuroScopePlugIn::SECTOR_ELEMENT_RUNWAY)) {
-
-            auto runwayAirportName = trimString(std::string(runway.GetAirportName()));
-            if (runwayAirportName == airportIcao) {
-                for (int runwayDirection = 0; runwayDirection < 2; runwayDirection++) {
-                    if (runwayAirportName == airportIcao) {
-                        auto runwayName = trimString(std::string(runway.GetRunwayName(runwayDirection)));
-                        activeRunways.push_back({ 
-                            airportIcao,
-                            runwayName,
-                            runway.IsElementActive(true, runwayDirection), // Departures
-                            runway.IsElementActive(false, runwayDirection) // Arrivals
-                        });
-                    }
-                }
+        // Only aircraft EuroScope reported changes for are read back, and no more of them per
+        // tick than MAX_ARRIVAL_UPDATES_PER_TICK; the rest are sent as they were for now
+        bool canUpdate = reachedResumePoint && updates < MAX_ARRIVAL_UPDATES_PER_TICK;
+        if ((record.dirty & AircraftStateCache::DataDirty) && canUpdate) {
+            TraceSpan updateSpan("updateArrival", callsign);
+            CRadarTarget rt = RadarTargetSelect(callsign.c_str());
+            if (!rt.IsValid()) {
+                // Not flying yet, but the record stays for the departure its flight plan may be
+                record.revision = 0;
+                record.dirty &= ~AircraftStateCache::DataDirty;
+                it++;
+                continue;
             }
+            buildArrival(rt, asel, record.arrival);
+            record.revision = ++lastArrivalRevision;
+            record.dirty &= ~AircraftStateCache::DataDirty;
+            updates++;
+        } else if (record.dirty & AircraftStateCache::DataDirty) {
+            if (reachedResumePoint && arrivalUpdatesResumeAt.empty()) {
+                arrivalUpdatesResumeAt = callsign;
+            }
+            deferredUpdates.add();
         }
-        break; // ICAO found, no need to continue
-    }
 
-    return activeRunways;
+        if (record.revision != 0 && record.arrival.groundSpeed >= AIRBORNE_GROUND_SPEED) {
+            // Recycled slots that still hold this revision from two ticks ago need no copy
+            auto& inbound = recycleNext(airport->inbounds, airport->inboundCount);
+            if (inbound.revision != record.revision) {
+                inbound.aircraft = record.arrival;
+                inbound.revision = record.revision;
+            }
+        }
+        it++;
+    }
 }
 
-inline std::string AmanPlugIn::trimString(const std::string& value) {
-    return std::regex_replace(value, std::regex("^ +| +$|( ) +"), "$1");
+void AmanPlugIn::buildArrival(CRadarTarget rt, CRadarTarget asel, AmanAircraft& ac) {
+    bool isSelectedAircraft = asel.IsValid() && rt.GetCallsign() == asel.GetCallsign();
+    auto assignedStarName = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetStarName();
+
+    ac.callsign = rt.GetCallsign();
+    ac.arrivalRunway = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetArrivalRwy();
+    ac.assignedStar = assignedStarName;
+    ac.icaoType = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetAircraftFPType();
+    ac.assignedDirectRouting = rt.GetCorrelatedFlightPlan().GetControllerAssignedData().GetDirectToPointName();
+    ac.trackingController = rt.GetCorrelatedFlightPlan().GetTrackingControllerId();
+    ac.isSelected = isSelectedAircraft;
+    ac.scratchPad = rt.GetCorrelatedFlightPlan().GetControllerAssignedData().GetScratchPadString();
+    ac.groundSpeed = rt.GetPosition().GetReportedGS();
+    ac.pressureAltitude = rt.GetPosition().GetPressureAltitude();
+    ac.flightLevel = rt.GetPosition().GetFlightLevel();
+    ac.track = rt.GetTrackHeading();
+    updateRoute(rt, ac);
+    ac.arrivalAirportIcao = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetDestination();
+    ac.latitude = rt.GetPosition().GetPosition().m_Latitude;
+    ac.longitude = rt.GetPosition().GetPosition().m_Longitude;
+    ac.flightPlanTas = rt.GetCorrelatedFlightPlan().GetFlightPlanData().GetTrueAirspeed();
 }
 
+// Departures come from the cached flight plans whose origin is subscribed. Only the dirty ones
+// are read back; the lifecycle window is applied to the rest from what was read before.
+void AmanPlugIn::collectOutbounds(TrafficSnapshot& snapshot) {
+    TraceSpan span("collectOutbounds");
+    // Flight plans give HHMM only; which day that falls on is worked out once for the whole tick
+    time_t now = time(nullptr);
+    time_t dayStart = now - now % SECONDS_PER_DAY;
+    time_t earliest = now - departuresMinutesPast * 60;
+    time_t latest = now + departuresMinutesAhead * 60;
+
+    for (auto& entry : aircraftStates.getRecords()) {
+        auto& record = entry.second;
+        // Aircraft from airports nobody subscribed to stay dirty until someone does
+        auto airport = findSnapshotAirport(snapshot, record.origin);
+        if (airport == nullptr) {
+            continue;
+        }
+        if (record.dirty & AircraftStateCache::DepartureDirty) {
+            readDeparture(entry.first, record);
+        }
+        if (!record.departureRead || record.departed) {
+            continue;
+        }
 
-std::string AmanPlugIn::addAssignedArrivalRunwayToRoute(const std::string& originalRoute, const std::string& arrivalAirport, const std::string& assignedRunway) {
-    std::stringstream ss(originalRoute);
-    std::vector<std::string> tokens;
-    std::string token;
-
-    while (ss >> token) {
-        tokens.push_back(token);
-    }
-
-    if (tokens.empty())
-        return arrivalAirport + "/" + assignedRunway; // fallback
-
-    std::string& last = tokens.back();
-    size_t slashPos = last.find('/');
-
-    if (slashPos != std::string::npos) {
-        // Replace everything after "/" with the new runway
-        last = last.substr(0, slashPos + 1) + assignedRunway;
-    } else {
-        // Append new arrival
-        last = last; // unchanged
-        tokens.push_back(arrivalAirport + "/" + assignedRunway);
-    }
+        long departureTime = -1;
+        if (record.departureMinute >= 0) {
+            // The closest day to now: 2350 read at 0010 was yesterday's, 0010 read at 2350 is tomorrow's
+            time_t departure = dayStart + record.departureMinute * 60;
+            if (departure - now > SECONDS_PER_DAY / 2) {
+                departure -= SECONDS_PER_DAY;
+            } else if (now - departure > SECONDS_PER_DAY / 2) {
+                departure += SECONDS_PER_DAY;
+            }
+            departureTime = static_cast<long>(departure);
+        }
+        // A connected aircraft on the ground is listed whatever its flight plan says; a flight plan
+        // alone only when it is due to depart within the window
+        bool inWindow = departureTime >= earliest && departureTime <= latest;
+        if (!record.hasRadarTarget && !inWindow) {
+            continue;
+        }
 
-    // Rebuild route
-    std::ostringstream out;
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        if (i > 0) out << " ";
-        out << tokens[i];
+        DmanAircraft& ac = recycleNext(airport->outbounds, airport->outboundCount);
+        ac = record.departure;
+        ac.estimatedDepartureTime = departureTime;
     }
-    return out.str();
 }
 
-// HHMM to epoch time
-long AmanPlugIn::processDepartureTime(const std::string& departureTime) {
-    // Validate length (should be exactly 4 characters)
-    if (departureTime.length() != 4) {
-        std::cerr << "Invalid departure time format: " << departureTime << std::endl;
-        return -1;
+void AmanPlugIn::readDeparture(const std::string& callsign, AircraftStateCache::Record& record) {
+    TraceSpan span("readDeparture", callsign);
+    record.dirty &= ~AircraftStateCache::DepartureDirty;
+    CRadarTarget rt = RadarTargetSelect(callsign.c_str());
+    record.hasRadarTarget = rt.IsValid();
+    if (record.hasRadarTarget && rt.GetPosition().GetReportedGS() >= AIRBORNE_GROUND_SPEED) {
+        // Stays off the list after landing, until the flight plan gets another origin
+        record.departed = true;
+    }
+    if (record.departed) {
+        return;
     }
 
-    try {
-        // Parse hour and minute
-        int hour = std::stoi(departureTime.substr(0, 2));
-        int minute = std::stoi(departureTime.substr(2, 2));
-
-        // Validate hour and minute range
-        if (hour < 0 || hour > 23 || minute < 0 || minute > 59) {
-            throw std::out_of_range("Hour or minute out of range");
-        }
-
-        // Get current UTC date
-        struct tm tm {};
-        time_t now;
-        time(&now);
-        gmtime_s(&tm, &now);  // Use UTC time
-
-        // Set parsed values (keeping the same date)
-        tm.tm_hour = hour;
-        tm.tm_min = minute;
-        tm.tm_sec = 0;
-
-        // Convert to epoch time (UTC)
-        time_t t = _mkgmtime(&tm); // Windows-specific function for UTC conversion
-
-        return static_cast<long>(t);
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing departure time: " << e.what() << std::endl;
-        return -1;
+    CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+    if (!fp.IsValid()) {
+        record.departureRead = false;
+        return;
     }
-}
\ No newline at end of file
+    auto fpd = fp.GetFlightPlanData();
+    auto& ac = record.departure;
+    ac.callsign = callsign;
+    ac.departureAirportIcao = record.origin;
+    ac.sid = fpd.GetSidName();
+    ac.runway = fpd.GetDepartureRwy();
+    ac.icaoType = fpd.GetAircraftFPType();
+    ac.wakeCategory = fpd.GetAircraftWtc();
+    record.departureMinute = parseDepartureMinute(fpd.GetEstimatedDepartureTime());
+    record.departureRead = true;
+}
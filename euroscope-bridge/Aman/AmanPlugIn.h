@@ -3,11 +3,19 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <set>
 #include "EuroScopePlugIn.h"
+#include "AircraftStateCache.h"
 #include "AmanServer.h"
+#include "ArrivalsDelta.h"
+#include "CommandQueue.h"
+#include "DeparturesDelta.h"
+#include "FixDictionary.h"
 #include "JsonMessageHelper.h"
-#include <set>
+#include "MetricsEndpoint.h"
+#include "PublishPipeline.h"
+#include "RunwayIndex.h"
+#include <map>
+#include <unordered_map>
 
 using namespace EuroScopePlugIn;
 
@@ -22,8 +30,46 @@ public:
 
 private:
     JsonMessageHelper jsonSerializer;
+    std::string messageBuffer;          // Reused by sendUpdatedRunwayStatuses() on the EuroScope thread
+    AircraftStateCache aircraftStates;  // Fed by the EuroScope update callbacks
+    uint64_t lastArrivalRevision = 0;
+    std::string arrivalUpdatesResumeAt; // Callsign the last tick ran out of arrival updates at, if it did
+    std::unordered_map<std::string, size_t> snapshotAirportIndex;    // ICAO to position in TrafficSnapshot::airports
+    CommandQueue commandQueue;          // Filled by the server thread, drained on the EuroScope thread
+    RunwayIndex runwayIndex;
+    std::vector<RunwayStatus> runwayStatuses;
+    bool flightPlansSeeded = false;     // Whether the flight plans known at load have been marked dirty
+    // Flight plans without an aircraft on the ground are departures this long before and after their time
+    int departuresMinutesPast = 30;
+    int departuresMinutesAhead = 120;
+
+    // OnTimer only reads EuroScope into a TrafficSnapshot; the publisher thread serializes it.
+    // Everything below up to the pipeline belongs to the publisher thread.
+    struct SerializedArrival {
+        uint64_t revision = 0;          // Of the aircraft serialized
+        uint64_t lastPublished = 0;     // publishCount when it was last in a snapshot
+        std::string json;               // Element of "inbounds"
+        std::string cbor;               // The same in CBOR, encoded when a CBOR client first needs it
+        std::vector<uint32_t> routeFixIds;
+    };
+    std::unordered_map<std::string, SerializedArrival> serializedArrivals;   // By callsign
+    uint64_t publishCount = 0;
+    std::map<std::string, ArrivalsDeltaTracker> arrivalsDeltaTrackers;   // Airports with arrivalsDelta subscribers
+    FixDictionary fixDictionary;        // Route points of the delta streams
+    std::string publishBuffer;
+    // Kept so that their capacity is reused and publishing allocates little more than its frames
+    std::vector<SerializedArrival*> airportArrivals;
+    std::vector<const std::string*> inboundsJson;
+    std::vector<const AmanAircraft*> inboundAircraft;  // Of the airport being published
+    std::vector<uint32_t> arrivalFieldSets;             // Distinct SubscriptionOptions::arrivalFields due this tick
+    ArrivalsDelta arrivalsDelta;
+    std::map<std::string, DeparturesDeltaTracker> departuresDeltaTrackers;   // Airports with departuresDelta subscribers
+    DeparturesDelta departuresDelta;
+    std::map<std::pair<std::string, std::string>, LatencyHistogram*> serializeLatencies;  // By airport and message type
+    PublishPipeline pipeline;
+
+    MetricsEndpoint metricsEndpoint;
 
-    std::set<std::string> airportsSubscribedTo;
     std::string pluginDirectory;
 
     bool hasCorrectDestination(CFlightPlanData fpd, std::vector<std::string> destinationAirports);
@@ -31,31 +77,54 @@ private:
     int getFirstViaFixIndex(CFlightPlanExtractedRoute extractedRoute, std::vector<std::string> viaFixes);
     std::string getFacilityString(int facilityType);
     
-    std::vector<RouteFix> findExtractedRoutePoints(CRadarTarget radarTarget);
+    void updateRoute(CRadarTarget radarTarget, AmanAircraft& ac);
 
-    std::vector<AmanAircraft> getInboundsForAirport(const std::string& fixName);
-    std::vector<DmanAircraft> getOutboundsFromAirport(const std::string& airport);
-    std::vector<RunwayStatus> collectRunwayStatuses(const std::string& airportIcao);
+    // EuroScope thread: fill the snapshot's subscribed airports in a single pass each
+    void indexSnapshotAirports(const TrafficSnapshot& snapshot);
+    TrafficSnapshot::Airport* findSnapshotAirport(TrafficSnapshot& snapshot, const std::string& airportIcao);
+    void collectInbounds(TrafficSnapshot& snapshot);
+    void collectOutbounds(TrafficSnapshot& snapshot);
+    // Flight plan and ground state of a departure candidate
+    void readDeparture(const std::string& callsign, AircraftStateCache::Record& record);
+    void buildArrival(CRadarTarget rt, CRadarTarget asel, AmanAircraft& ac);
+    LatencyHistogram& serializeLatency(const std::string& airportIcao, const char* messageType);
 
-    std::string trimString(const std::string& value);
-    std::string addAssignedArrivalRunwayToRoute(const std::string& originalRoute, const std::string& departureAirport, const std::string& assignedRunway);
+    // A file in the plugin directory, named by the current UTC time through strftime()
+    std::string getTimestampedPath(const char* nameFormat);
+    std::string getPluginFilePath(const std::string& fileName);
 
-    long processDepartureTime(const std::string& departureTime);
-    
-    static std::vector<std::string> splitString(const std::string& string, const char delim);
 
     void sendUpdatedRunwayStatuses();
+    void runQueuedCommands();
+    bool assignArrivalRunway(const std::string& callsign, const std::string& runway, std::string& error);
+    bool setCtot(const std::string& callsign, long ctot, std::string& error);
+
+    // Publisher thread
+    void publishSnapshot(TrafficSnapshot& snapshot);
+    // Brings serializedArrivals up to date with the airport's inbounds and lists them in airportArrivals
+    void serializeArrivals(TrafficSnapshot::Airport& airport);
+    // CBOR frame of an arrivals message built from airportArrivals; `envelopeJson` is the message without aircraft
+    std::string encodeArrivalsCbor(const std::string& envelopeJson, const TrafficSnapshot::Airport& airport);
+    // Diffs inboundAircraft against what the airport's delta subscribers were sent before
+    void publishArrivalsDelta(const TrafficSnapshot::Airport& airport, bool snapshotPending);
+    // Diffs the airport's outbounds against what its departuresDelta subscribers were sent before
+    void publishDeparturesDelta(const TrafficSnapshot::Airport& airport, bool snapshotPending);
 
     // Server methods
-    void onClientConnected() override;
-    void onRegisterAirport(const std::string& airportIcao) override;
-    void onUnregisterAirport(const std::string& icao) override;
-    void onRequestAssignRunway(const std::string& callsign, const std::string& runway) override;
-    void onSetCtot(const std::string& callSign, long ctot) override;
-    void onClientDisconnected() override;
+    void onClientConnected(ClientId clientId) override;
+    void onSelectCodec(ClientId clientId, const std::string& codec) override;
+    void onRegisterAirport(ClientId clientId, const std::string& airportIcao, const SubscriptionOptions& options) override;
+    void onUnregisterAirport(ClientId clientId, const std::string& icao) override;
+    void onRequestAssignRunway(ClientId clientId, const std::string& requestId, const std::string& callsign, const std::string& runway) override;
+    void onSetCtot(ClientId clientId, const std::string& requestId, const std::string& callSign, long ctot) override;
     void onErrorProcessingMessage(const std::string& errorMessage) override;
 
     // EuroScope API
     virtual void OnTimer(int Counter);
     virtual void OnAirportRunwayActivityChanged(void);
+    virtual void OnRadarTargetPositionUpdate(CRadarTarget RadarTarget);
+    virtual void OnFlightPlanFlightPlanDataUpdate(CFlightPlan FlightPlan);
+    virtual void OnFlightPlanControllerAssignedDataUpdate(CFlightPlan FlightPlan, int DataType);
+    virtual void OnFlightPlanDisconnect(CFlightPlan FlightPlan);
+    virtual bool OnCompileCommand(const char* sCommandLine);
 };
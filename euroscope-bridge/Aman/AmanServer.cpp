@@ -1,339 +1,782 @@
 #include "stdafx.h"
 #include "AmanServer.h"
-#include <iostream>
+#include "Logger.h"
+#include "Metrics.h"
+#include "Tracing.h"
 #include <chrono>
 #include <thread>
 #include <atomic>
-#include <winsock2.h>
-#include <queue>
 #include <mutex>
-#include <condition_variable>
 #include <string>
-#include <windows.h>
 
-#pragma comment(lib, "ws2_32.lib")  // Link with the Winsock library
+// A client whose socket has not accepted a single byte for this long is considered dead.
+// Merely slow clients are kept; their queue coalesces snapshots instead of growing.
+static const int DEAD_CLIENT_TIMEOUT_MS = 60000;
+// How often the I/O thread wakes up to look for dead clients while data is pending
+static const int STALL_CHECK_INTERVAL_MS = 1000;
+// Minimum free space offered to each recv() call
+static const size_t RECV_CHUNK_BYTES = 4096;
+// Client commands are tiny; anything this large without a newline is a broken peer
+static const size_t MAX_INBOUND_MESSAGE_BYTES = 1024 * 1024;
+
+namespace {
+
+// Looked up once; the registry keeps them for the life of the process
+struct ServerMetrics {
+    MetricGauge& clients = Metrics::gauge("aman_clients", "Connected clients");
+    MetricCounter& connections = Metrics::counter("aman_client_connections_total", "Clients accepted");
+    MetricCounter& sendStalls = Metrics::counter("aman_send_stalls_total", "Writes that found the socket buffer full");
+    LatencyHistogram& sendLatency = Metrics::histogram("aman_send_latency_micros", "Time from publishing a frame until its last byte was written");
+    MetricGauge& queuedFrames = Metrics::gauge("aman_send_queue_frames", "Frames waiting in the send queues");
+    MetricGauge& queuedBytes = Metrics::gauge("aman_send_queue_bytes", "Bytes waiting in the send queues");
+    MetricCounter& framesCoalesced = Metrics::counter("aman_frames_coalesced_total", "Unsent snapshots replaced by a newer one");
+    MetricCounter& framesDropped = Metrics::counter("aman_frames_dropped_total", "Frames discarded to stay under the per-client byte cap");
+};
+
+ServerMetrics& serverMetrics() {
+    static ServerMetrics metrics;
+    return metrics;
+}
+
 
-// Helper function for debug logging in DLLs
-void DebugOut(const std::string& message) {
-    std::string logMsg = "[AmanServer] " + message + "\n";
-    OutputDebugStringA(logMsg.c_str());
 }
 
-AmanServer::AmanServer() : isRunning(false), clientConnected(false), listenSocket(INVALID_SOCKET), clientSocket(INVALID_SOCKET) {
+AmanServer::AmanServer()
+    : isRunning(false), listenSocket(INVALID_SOCKET), nextClientId(1), cborClients(0), openPublishBatches(0), wakeDeferred(false) {
     startServer();
 }
 
 AmanServer::~AmanServer() {
     stop();
-    WSACleanup();  // Clean up Winsock
+    capture.stop();
+    socketCleanup();  // Clean up Winsock
 }
 
 void AmanServer::startServer() {
     // Initialize Winsock
-    WSADATA wsaData;
-    int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (result != 0) {
-        DebugOut("WSAStartup failed: " + std::to_string(result));
+    if (!socketStartup()) {
+        LOG_ERROR("Socket startup failed: ", socketLastError());
+        return;
+    }
+
+    if (!poller.open()) {
+        LOG_ERROR("Failed to create socket poller: ", socketLastError());
         return;
     }
 
     // Start the server thread
     isRunning = true;
     serverThread = std::thread(&AmanServer::serverLoop, this);
-    senderThread = std::thread(&AmanServer::senderThreadLoop, this);
 }
 
 void AmanServer::stop() {
     if (isRunning) {
         isRunning = false;
-        clientConnected = false;
-        
-        // Close the listen socket first to unblock accept()
-        if (listenSocket != INVALID_SOCKET) {
-            closesocket(listenSocket);
-            listenSocket = INVALID_SOCKET;
-        }
-        
-        // Close the client socket
-        if (clientSocket != INVALID_SOCKET) {
-            closesocket(clientSocket);
-            clientSocket = INVALID_SOCKET;
-        }
-        
-        // Notify condition variable to unblock any waiting threads
-        queueCondition.notify_all();
-        
-        // Wait for threads to finish
+
+        // Wake the I/O thread out of its poller
+        poller.wake();
+
+        // Wait for thread to finish
         if (serverThread.joinable()) {
             serverThread.join();
         }
-        if (senderThread.joinable()) {
-            senderThread.join();
+
+        // Nothing uses the sockets any more, safe to close them
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (auto& entry : clients) {
+            closeSocket(entry.second->socket);
         }
+        clients.clear();
+        clientsBySocket.clear();
+
+        if (listenSocket != INVALID_SOCKET) {
+            closeSocket(listenSocket);
+            listenSocket = INVALID_SOCKET;
+        }
+    }
+}
+
+bool AmanServer::openListenSocket() {
+    listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == INVALID_SOCKET) {
+        LOG_ERROR("Error creating socket");
+        return false;
+    }
+
+#ifndef _WIN32
+    // Allow an immediate re-bind when EuroScope reloads the plugin
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+    sockaddr_in serverAddr{};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = INADDR_ANY;
+    serverAddr.sin_port = htons(12345);
+
+    if (bind(listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+        LOG_ERROR("Bind failed with error: ", socketLastError());
+        closeSocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+        return false;
+    }
+
+    if (listen(listenSocket, SOMAXCONN) == SOCKET_ERROR || !setSocketNonBlocking(listenSocket)) {
+        LOG_ERROR("Listen failed with error: ", socketLastError());
+        closeSocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+        return false;
     }
+
+    poller.add(listenSocket, SocketPoller::Readable);
+    return true;
 }
 
 void AmanServer::serverLoop() {
+    Tracing::setThreadName("AmanServer I/O");
+    if (!openListenSocket()) {
+        return;
+    }
+
+    LOG_INFO("Waiting for clients to connect...");
+
+    std::vector<SocketPoller::Event> events;
+    std::vector<ClientId> connectedClients;
+    std::vector<ClientId> disconnectedClients;
+
+    // Sessions are only added and removed on this thread, so it may walk `clients` without
+    // clientsMutex; it only takes it to change the map and for what the lock guards in a session.
     while (isRunning) {
-        listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-        if (listenSocket == INVALID_SOCKET) {
-            DebugOut("Error creating socket");
-            return;
+        // Only wake up periodically while some client has data waiting, to spot stalled connections
+        int timeoutMs = -1;
+        for (auto& entry : clients) {
+            std::lock_guard<std::mutex> sendLock(entry.second->sendMutex);
+            if (!entry.second->sendQueue.empty()) {
+                timeoutMs = STALL_CHECK_INTERVAL_MS;
+                break;
+            }
         }
 
-        sockaddr_in serverAddr{};
-        serverAddr.sin_family = AF_INET;
-        serverAddr.sin_addr.s_addr = INADDR_ANY;
-        serverAddr.sin_port = htons(12345);
-        
-        if (bind(listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-            DebugOut("Bind failed with error: " + std::to_string(WSAGetLastError()));
-            closesocket(listenSocket);
-            listenSocket = INVALID_SOCKET;
-            return;
+        if (poller.wait(events, timeoutMs) < 0) {
+            LOG_ERROR("Waiting for socket events failed with error: ", socketLastError());
+            break;
+        }
+        if (!isRunning) {
+            break;
         }
 
-        if (listen(listenSocket, 1) == SOCKET_ERROR) {
-            DebugOut("Listen failed with error: " + std::to_string(WSAGetLastError()));
-            closesocket(listenSocket);
-            listenSocket = INVALID_SOCKET;
-            return;        }
+        disconnectedClients.clear();
 
-        DebugOut("Waiting for a client to connect...");
+        // Callbacks run without a lock held; they queue replies through sendToClient()/subscribe()
+        for (auto& event : events) {
+            if (event.socket == listenSocket) {
+                connectedClients.clear();
+                {
+                    std::lock_guard<std::mutex> lock(clientsMutex);
+                    acceptClients(connectedClients);
+                }
+                for (ClientId clientId : connectedClients) {
+                    if (capture.isActive()) {
+                        capture.recordConnected(clientId);
+                    }
+                    // Notify derived class that client connected (for version handshake)
+                    onClientConnected(clientId);
+                }
+                continue;
+            }
 
-        clientSocket = accept(listenSocket, nullptr, nullptr);
+            auto session = clientsBySocket.find(event.socket);
+            if (session != clientsBySocket.end() && !session->second->closing && (event.events & SocketPoller::Readable)) {
+                readFromClient(*session->second);
+            }
+        }
 
-        // accept() will return SOCKET_ERROR if listenSocket is closed
-        if (clientSocket == INVALID_SOCKET) {
-            if (isRunning) { // real error
-                DebugOut("Accept failed with error: " + std::to_string(WSAGetLastError()));
+        // Write whatever was published since the last wake-up. Publishing to the other clients
+        // goes on meanwhile; only this client's queue is locked while its socket is written.
+        auto now = std::chrono::steady_clock::now();
+        for (auto& entry : clients) {
+            ClientSession& client = *entry.second;
+            std::lock_guard<std::mutex> sendLock(client.sendMutex);
+            if (!client.closing && !client.sendQueue.empty()) {
+                flushClient(client);
             }
-            if (listenSocket != INVALID_SOCKET) {
-                closesocket(listenSocket);
-                listenSocket = INVALID_SOCKET;
+
+            if (!client.closing && !client.sendQueue.empty()
+                && now - client.lastSendProgress > std::chrono::milliseconds(DEAD_CLIENT_TIMEOUT_MS)) {
+                LOG_WARNING("Client ", client.id, " stopped reading, disconnecting it");
+                disconnectClient(client, "stalled");
             }
-            continue;
-        }        // Client connected - close listen socket and handle communication
-        if (listenSocket != INVALID_SOCKET) {
-            closesocket(listenSocket);
-            listenSocket = INVALID_SOCKET;
         }
-        
-        // Set client socket to non-blocking mode to prevent blocking on large sends
-        u_long nonBlocking = 1;
-        if (ioctlsocket(clientSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
-            DebugOut("Failed to set client socket to non-blocking mode: " + std::to_string(WSAGetLastError()));
-        } else {
-            DebugOut("Client socket set to non-blocking mode");
+
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+
+            // Queue statistics for the metrics, including clients that have disconnected
+            SendQueueStats queueTotals = retiredQueueStats;
+            queueTotals.queuedFrames = 0;
+            queueTotals.queuedBytes = 0;
+            for (auto it = clients.begin(); it != clients.end();) {
+                ClientSession& client = *it->second;
+                std::unique_lock<std::mutex> sendLock(client.sendMutex);
+
+                if (client.closing) {
+                    accumulateStats(retiredQueueStats, client.sendQueue.getStats());
+                    if (client.codec == CodecCbor) {
+                        cborClients--;
+                    }
+                    disconnectedClients.push_back(client.id);
+                    clientsBySocket.erase(client.socket);
+                    closeClient(client);
+                    sendLock.unlock();
+                    it = clients.erase(it);
+                } else {
+                    accumulateStats(queueTotals, client.sendQueue.getStats());
+                    it++;
+                }
+            }
+
+            ServerMetrics& metrics = serverMetrics();
+            metrics.clients.set((int64_t)clients.size());
+            metrics.queuedFrames.set((int64_t)queueTotals.queuedFrames);
+            metrics.queuedBytes.set((int64_t)queueTotals.queuedBytes);
+            metrics.framesCoalesced.set(queueTotals.framesCoalesced);
+            metrics.framesDropped.set(queueTotals.framesDropped);
+        }
+
+        for (ClientId clientId : disconnectedClients) {
+            if (capture.isActive()) {
+                capture.recordDisconnected(clientId);
+            }
+            subscriptions.removeClient(clientId);
+        }
+    }
+}
+
+void AmanServer::acceptClients(std::vector<ClientId>& acceptedClients) {
+    while (true) {
+        SOCKET clientSocket = accept(listenSocket, nullptr, nullptr);
+        if (clientSocket == INVALID_SOCKET) {
+            int error = socketLastError();
+            if (!socketWouldBlock(error)) {
+                LOG_WARNING("Accept failed with error: ", error);
+            }
+            return;
         }
 
-        clientConnected = true;
-        DebugOut("Client connected successfully");
-          // Notify sender thread that client is connected
-        queueCondition.notify_all();
-        
-        // Notify derived class that client connected (for version handshake)
-        onClientConnected();
-        
-        handleClientConnection();
-        
-        // Client disconnected
-        DebugOut("Cleaning up client connection...");
-        clientConnected = false;
-        
-        // Notify sender thread that client disconnected
-        queueCondition.notify_all();
-        if (clientSocket != INVALID_SOCKET) {
-            closesocket(clientSocket);
-            clientSocket = INVALID_SOCKET;
+        // Set client socket to non-blocking mode; readiness is reported by the poller
+        if (!setSocketNonBlocking(clientSocket) || !poller.add(clientSocket, SocketPoller::Readable)) {
+            LOG_WARNING("Failed to set up client socket: ", socketLastError());
+            closeSocket(clientSocket);
+            continue;
         }
+
+        serverMetrics().connections.add();
+        auto client = std::unique_ptr<ClientSession>(new ClientSession());
+        client->id = nextClientId++;
+        client->socket = clientSocket;
+        LOG_INFO("Client ", client->id, " connected, ", clients.size() + 1, " client(s) in total");
+        acceptedClients.push_back(client->id);
+        clientsBySocket[clientSocket] = client.get();
+        clients[client->id] = std::move(client);
     }
 }
 
-void AmanServer::handleClientConnection() {
-    char buffer[4096];
-    std::string receivedData;
-    
-    DebugOut("Starting client communication loop...");
-    
-    while (isRunning && clientConnected && clientSocket != INVALID_SOCKET) {
-        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+void AmanServer::readFromClient(ClientSession& client) {
+    std::string_view message;
+
+    // Drain everything the socket has buffered before waiting again
+    while (true) {
+        char* writePointer = client.receiveBuffer.writePointer(RECV_CHUNK_BYTES);
+        int bytesReceived = recv(client.socket, writePointer, (int)client.receiveBuffer.writableBytes(), 0);
         if (bytesReceived > 0) {
-            buffer[bytesReceived] = '\0';
-            receivedData += buffer;
-            DebugOut("Received " + std::to_string(bytesReceived) + " bytes from client");
-            
-            // Process complete messages (assuming newline-delimited)
-            size_t pos = 0;
-            while ((pos = receivedData.find('\n')) != std::string::npos) {
-                std::string message = receivedData.substr(0, pos);
-                receivedData = receivedData.substr(pos + 1);
-                
-                if (!message.empty()) {
-                    DebugOut("Processing message: " + message);
-                    try {
-                        processMessage(message);
-                    } catch (const std::exception& e) {
-                        DebugOut("Error processing message: " + std::string(e.what()));
-                    }
+            client.receiveBuffer.commitWrite(bytesReceived);
+
+            // Process complete messages (newline-delimited) straight out of the receive buffer
+            while (client.receiveBuffer.nextFrame(message)) {
+                if (message.empty()) {
+                    continue;
+                }
+                LOG_DEBUG("Processing message from client ", client.id, ": ", message);
+                if (capture.isActive()) {
+                    capture.recordInbound(client.id, message);
                 }
+                try {
+                    TraceSpan span("processMessage", client.id);
+                    processMessage(client.id, message);
+                } catch (const std::exception& e) {
+                    LOG_WARNING("Error processing message: ", e.what());
+                    countInboundError("exception");
+                }
+            }
+            client.receiveBuffer.compact();
+
+            if (client.receiveBuffer.pendingBytes() > MAX_INBOUND_MESSAGE_BYTES) {
+                LOG_WARNING("Client ", client.id, " sent an oversized message, disconnecting it");
+                disconnectClient(client, "oversized");
+                return;
             }
         } else if (bytesReceived == 0) {
-            DebugOut("Client disconnected gracefully (recv returned 0)");
-            onClientDisconnected();
-            break;
+            LOG_INFO("Client ", client.id, " disconnected gracefully (recv returned 0)");
+            disconnectClient(client, "closed");
+            return;
         } else {
-            int error = WSAGetLastError();
-            
-            // WSAEWOULDBLOCK is expected for non-blocking sockets when no data is available
-            if (error == WSAEWOULDBLOCK) {
-                // No data available right now, sleep briefly and continue
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            }
-            
-            if (isRunning && clientConnected) {
-                DebugOut("Recv failed with error: " + std::to_string(error) + " (WSAECONNRESET=" + std::to_string(WSAECONNRESET) + ")");
+            int error = socketLastError();
+
+            // Nothing more buffered, go back to waiting for readiness
+            if (socketWouldBlock(error)) {
+                return;
             }
-            
-            // Check if it's a connection reset or client disconnect
-            if (error == WSAECONNRESET || error == WSAECONNABORTED) {
-                DebugOut("Client connection was reset/aborted");
-                onClientDisconnected();
+
+            if (socketConnectionLost(error)) {
+                LOG_INFO("Client ", client.id, " connection was reset/aborted");
+                disconnectClient(client, "reset");
+            } else {
+                LOG_WARNING("Recv failed with error: ", error);
+                disconnectClient(client, "recvError");
             }
-            break;
-        }    }
-    
-    DebugOut("Client communication loop ended");
+            return;
+        }
+    }
 }
 
-bool AmanServer::sendMessageSafely(const std::string& message) {
-    if (clientSocket == INVALID_SOCKET || !clientConnected) {
-        return false;
-    }
-    
-    const char* data = message.c_str();
-    int totalBytes = (int)message.length();
-    int bytesSent = 0;
-    int attempts = 0;
-    const int maxAttempts = 100; // Prevent infinite loops
-    
-    DebugOut("Starting to send message safely: " + std::to_string(totalBytes) + " bytes");
-    
-    while (bytesSent < totalBytes && clientConnected && attempts < maxAttempts) {
-        int result = send(clientSocket, data + bytesSent, totalBytes - bytesSent, 0);
-        
+void AmanServer::flushClient(ClientSession& client) {
+    SendSlice slices[MAX_SEND_SLICES];
+
+    while (!client.sendQueue.empty()) {
+        // Everything pending goes out in one gather-write, straight from the shared frames
+        size_t bytesGathered = 0;
+        size_t sliceCount = client.sendQueue.gather(slices, MAX_SEND_SLICES, bytesGathered);
+        int result;
+        {
+            TraceSpan span("send", client.id);
+            result = sendVectored(client.socket, slices, sliceCount);
+        }
+
         if (result > 0) {
-            bytesSent += result;
-            DebugOut("Sent " + std::to_string(result) + " bytes, total: " + std::to_string(bytesSent) + "/" + std::to_string(totalBytes));
-        } else if (result == SOCKET_ERROR) {
-            int error = WSAGetLastError();
-            if (error == WSAEWOULDBLOCK) {
-                // Socket buffer is full, wait a bit and retry
-                attempts++;
-                DebugOut("Socket would block, attempt " + std::to_string(attempts) + ", waiting...");
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            } else {
-                DebugOut("Send failed with error: " + std::to_string(error));
-                return false;
+            client.lastSendProgress = std::chrono::steady_clock::now();
+            client.sendQueue.consume(result, &writtenFrames);
+            recordWrittenFrames(client);
+            if ((size_t)result < bytesGathered) {
+                // Short write means the socket buffer is full; don't spend a syscall finding out
+                serverMetrics().sendStalls.add();
+                waitForWritable(client);
+                return;
             }
+        } else if (result == SOCKET_ERROR && socketWouldBlock(socketLastError())) {
+            // Socket buffer is full, let the poller tell us when the client has drained some of it
+            serverMetrics().sendStalls.add();
+            waitForWritable(client);
+            return;
         } else {
-            DebugOut("Send returned 0, connection closed");
+            LOG_WARNING("Send to client ", client.id, " failed with error: ", socketLastError());
+            disconnectClient(client, "sendError");
+            return;
+        }
+    }
+
+    if (client.waitingForWritable) {
+        poller.modify(client.socket, SocketPoller::Readable);
+        client.waitingForWritable = false;
+    }
+}
+
+void AmanServer::recordWrittenFrames(ClientSession& client) {
+    auto now = std::chrono::steady_clock::now();
+    ServerMetrics& metrics = serverMetrics();
+    for (auto& written : writtenFrames) {
+        if (capture.isActive()) {
+            capture.recordSent(client.id, written.frame);
+        }
+
+        auto type = frameMessageType(*written.frame);
+        auto sent = sentFrameMetrics.find(type);
+        if (sent == sentFrameMetrics.end()) {
+            MetricLabels labels = { { "type", type } };
+            sent = sentFrameMetrics.emplace(type, std::make_pair(
+                &Metrics::counter("aman_frames_sent_total", "Frames written to clients", labels),
+                &Metrics::counter("aman_bytes_sent_total", "Bytes written to clients, delimiters included", labels))).first;
+        }
+        sent->second.first->add();
+        sent->second.second->add(frameWireSize(*written.frame));
+        metrics.sendLatency.record(now - written.queuedAt);
+
+        // From publish to the last byte handed to the socket, per frame
+        Tracing::recordAsyncSpan("queueWait", written.coalesceKey.empty() ? "reply" : written.coalesceKey.c_str(), written.queuedAt, now);
+    }
+    writtenFrames.clear();
+}
+
+void AmanServer::disconnectClient(ClientSession& client, const char* reason) {
+    client.closing = true;
+    Metrics::counter("aman_client_disconnects_total", "Clients disconnected, by reason", { { "reason", reason } }).add();
+}
+
+void AmanServer::waitForWritable(ClientSession& client) {
+    if (!client.waitingForWritable) {
+        poller.modify(client.socket, SocketPoller::Readable | SocketPoller::Writable);
+        client.waitingForWritable = true;
+    }
+}
+
+void AmanServer::closeClient(ClientSession& client) {
+    LOG_DEBUG("Cleaning up connection of client ", client.id, "...");
+    poller.remove(client.socket);
+    closeSocket(client.socket);
+    client.socket = INVALID_SOCKET;
+}
+
+AmanServer::EncodedMessage AmanServer::encodeMessage(std::string json, std::string cborFrame) {
+    EncodedMessage message;
+    if (!cborFrame.empty()) {
+        message.frames[CodecCbor] = std::make_shared<const std::string>(std::move(cborFrame));
+    } else if (cborClients > 0) {
+        TraceSpan span("encodeCbor");
+        std::string cbor;
+        if (encodeCborFrame(json, cbor)) {
+            message.frames[CodecCbor] = std::make_shared<const std::string>(std::move(cbor));
+        }
+    }
+    // The newline delimiter is added as a separate slice when the frame is written
+    message.frames[CodecJson] = std::make_shared<const std::string>(std::move(json));
+    return message;
+}
+
+bool AmanServer::enqueueFrame(ClientSession& client, EncodedMessage& message, const std::string& coalesceKey, FrameRetention retention) {
+    if (client.closing) {
+        return false;
+    }
+
+    SharedFrame& frame = message.frames[client.codec];
+    if (!frame) {
+        std::string cbor;
+        if (!encodeCborFrame(*message.frames[CodecJson], cbor)) {
+            LOG_WARNING("Cannot encode message for client ", client.id, " as CBOR");
             return false;
         }
+        frame = std::make_shared<const std::string>(std::move(cbor));
     }
-    
-    if (bytesSent == totalBytes) {
-        DebugOut("Message sent successfully: " + std::to_string(bytesSent) + " bytes");
-        return true;
-    } else {
-        DebugOut("Failed to send complete message: " + std::to_string(bytesSent) + "/" + std::to_string(totalBytes) + " bytes");
+
+    std::lock_guard<std::mutex> sendLock(client.sendMutex);
+    if (client.sendQueue.empty()) {
+        client.lastSendProgress = std::chrono::steady_clock::now();
+    }
+    bool queued = client.sendQueue.push(frame, coalesceKey, retention);
+    if (!queued && frame->size() > MAX_QUEUED_BYTES_PER_CLIENT) {
+        LOG_WARNING("Dropped a ", frame->size(), " byte frame for client ", client.id, ": larger than its send queue");
+    }
+
+    // Part of a delta stream is gone; start every stream over, dictionary included
+    if (client.sendQueue.takeStreamLoss()) {
+        client.syncedStreams.clear();
+        client.dictionaryEntries = 0;
+    }
+
+    // What is left must not be dropped, so the client cannot be kept in sync any more
+    if (client.sendQueue.isOverCap()) {
+        LOG_WARNING("Client ", client.id, " has ", client.sendQueue.getStats().queuedBytes, " bytes queued that cannot be evicted, disconnecting");
+        disconnectClient(client, "overflow");
         return false;
     }
+    return queued;
 }
 
-void AmanServer::senderThreadLoop() {
-    DebugOut("Sender thread started");
-    
-    while (isRunning) {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        DebugOut("Sender thread waiting for client connection or messages...");
-        
-        // Wait for either a client to connect AND have messages, or for shutdown
-        queueCondition.wait(lock, [this] { 
-            return (!messageQueue.empty() && clientConnected) || !isRunning;        });
-        
-        if (!isRunning) {
-            DebugOut("Sender thread stopping - isRunning false");
-            break;
+void AmanServer::wakeIoThread() {
+    if (openPublishBatches > 0) {
+        wakeDeferred = true;
+    } else {
+        poller.wake();
+    }
+}
+
+AmanServer::PublishBatch::PublishBatch(AmanServer& server) : server(server) {
+    std::lock_guard<std::mutex> lock(server.clientsMutex);
+    server.openPublishBatches++;
+}
+
+AmanServer::PublishBatch::~PublishBatch() {
+    std::lock_guard<std::mutex> lock(server.clientsMutex);
+    if (--server.openPublishBatches == 0 && server.wakeDeferred) {
+        server.wakeDeferred = false;
+        server.poller.wake();
+    }
+}
+
+void AmanServer::accumulateStats(SendQueueStats& total, const SendQueueStats& stats) {
+    total.framesQueued += stats.framesQueued;
+    total.framesCoalesced += stats.framesCoalesced;
+    total.framesDropped += stats.framesDropped;
+    total.queuedFrames += stats.queuedFrames;
+    total.queuedBytes += stats.queuedBytes;
+}
+
+void AmanServer::sendToClient(ClientId clientId, std::string data) {
+    if (!isRunning) {
+        return;
+    }
+
+    auto message = encodeMessage(std::move(data));
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientId);
+    if (it != clients.end()) {
+        enqueueFrame(*it->second, message, std::string(), RetainAlways);
+        wakeIoThread();
+    }
+}
+
+void AmanServer::publishToSubscribers(const std::string& airportIcao, const std::string& messageType, std::string data, std::string cborFrame,
+    const Audience& audience, FrameRetention retention) {
+    if (!isRunning) {
+        return;
+    }
+
+    const std::string coalesceKey = messageType + "/" + airportIcao;
+    TraceSpan span("enqueue", coalesceKey);
+    auto message = encodeMessage(std::move(data), std::move(cborFrame));
+    bool queued = false;
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    SubscriptionRegistry::Reader current(subscriptions);
+    auto airport = current->find(airportIcao);
+    if (airport == nullptr) {
+        return;
+    }
+    for (auto& subscriber : airport->subscribers) {
+        if (subscriber.options.usesDelta(messageType) || !audience.includes(subscriber.options)) {
+            continue;
         }
-        
-        if (!clientConnected) {
-            DebugOut("Sender thread: No client connected, continuing to wait...");
+        auto client = clients.find(subscriber.clientId);
+        if (client == clients.end()) {
             continue;
         }
-        
-        DebugOut("Sender thread woke up, queue size: " + std::to_string(messageQueue.size()));
-        
-        // Process all queued messages        while (!messageQueue.empty() && clientConnected && clientSocket != INVALID_SOCKET && isRunning) {
-            std::string message = messageQueue.front();
-            messageQueue.pop();
-            lock.unlock();
-            
-            DebugOut("Sending message to client (length: " + std::to_string(message.length()) + "): " + message.substr(0, 50) + "...");
-            
-            // Send message to client using safe method for large messages
-            message += "\n"; // Add newline delimiter
-            bool success = sendMessageSafely(message);
-            
-            if (!success) {
-                DebugOut("CRITICAL: Failed to send message, marking client as disconnected");
-                clientConnected = false;
-                // Don't break here - let the loop condition handle it            }
-            
-            lock.lock();
+        enqueueFrame(*client->second, message, coalesceKey, retention);
+        queued = true;
+    }
+
+    if (queued) {
+        wakeIoThread();
+    }
+}
+
+void AmanServer::publishDelta(const std::string& airportIcao, const std::string& messageType, std::string delta, std::string snapshot,
+    std::string cborSnapshotFrame, const DeltaDictionary* dictionary) {
+    if (!isRunning) {
+        return;
+    }
+
+    TraceSpan span("enqueueDelta", airportIcao);
+    bool hasDelta = !delta.empty();
+    bool hasSnapshot = !snapshot.empty();
+    EncodedMessage deltaMessage;
+    EncodedMessage snapshotMessage;
+    if (hasDelta) {
+        deltaMessage = encodeMessage(std::move(delta));
+    }
+    if (hasSnapshot) {
+        snapshotMessage = encodeMessage(std::move(snapshot), std::move(cborSnapshotFrame));
+    }
+    // Dictionary updates by the first entry the client is missing. Only built under the lock while
+    // the dictionary is still growing, for the few clients that are behind. Returns whether the
+    // client has every entry queued; if not, it must not be sent frames that refer to them.
+    std::map<uint32_t, EncodedMessage> dictionaryMessages;
+    auto sendDictionary = [&](ClientSession& client) {
+        if (dictionary == nullptr || client.dictionaryEntries >= dictionary->size) {
+            return true;
+        }
+        auto message = dictionaryMessages.find(client.dictionaryEntries);
+        if (message == dictionaryMessages.end()) {
+            message = dictionaryMessages.emplace(client.dictionaryEntries, encodeMessage(dictionary->serializeFrom(client.dictionaryEntries))).first;
+        }
+        // An evicted dictionary frame resets dictionaryEntries (see enqueueFrame), so it is only
+        // advanced for a frame that made it into the queue
+        if (!enqueueFrame(client, message->second, std::string(), RetainStream)) {
+            return false;
+        }
+        client.dictionaryEntries = dictionary->size;
+        return true;
+    };
+
+    bool queued = false;
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    SubscriptionRegistry::Reader current(subscriptions);
+    auto airport = current->find(airportIcao);
+    if (airport == nullptr) {
+        return;
+    }
+    for (auto& subscriber : airport->subscribers) {
+        auto it = clients.find(subscriber.clientId);
+        if (!subscriber.options.usesDelta(messageType) || it == clients.end()) {
+            continue;
         }
-        
-        if (!clientConnected) {
-            DebugOut("Sender thread: Client disconnected, clearing message queue");
-            // Clear remaining messages since client is gone
-            while (!messageQueue.empty()) {
-                messageQueue.pop();
+        ClientSession& client = *it->second;
+
+        // Deltas and snapshots stay in order (no coalesce key); evicting one resyncs the client
+        auto& syncedStreams = client.syncedStreams[airportIcao];
+        if (syncedStreams.count(messageType) > 0) {
+            if (!hasDelta || !sendDictionary(client)) {
+                continue;
+            }
+            enqueueFrame(client, deltaMessage, std::string(), RetainStream);
+            queued = true;
+        } else if (hasSnapshot) {
+            if (!sendDictionary(client)) {
+                continue;
             }
+            // The client stays pending if the snapshot did not fit
+            if (enqueueFrame(client, snapshotMessage, std::string(), RetainStream)) {
+                syncedStreams.insert(messageType);
+            }
+            queued = true;
         }
     }
-    
-    DebugOut("Sender thread exiting");
-}
-
-
-void AmanServer::enqueueMessage(const std::string& data) {
-    static int messageCount = 0;
-    messageCount++;
-    
-    // Only log every 10th message to reduce spam
-    bool shouldLog = (messageCount % 10 == 1);
-    
-    if (shouldLog) {
-        DebugOut("enqueueMessage called (#" + std::to_string(messageCount) + "), isRunning: " + 
-                 std::to_string(isRunning) + ", clientConnected: " + std::to_string(clientConnected));
-    }
-    
-    if (!isRunning || !clientConnected) {
-        if (shouldLog) DebugOut("Message not queued - server not running or client not connected");
-        return; // Don't queue messages if not running or no client
-    }
-    
-    try {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        messageQueue.push(data);
-        if (shouldLog) {
-            DebugOut("Message queued successfully, queue size: " + std::to_string(messageQueue.size()));
+
+    if (queued) {
+        wakeIoThread();
+    }
+}
+
+void AmanServer::broadcast(const std::string& messageType, std::string data) {
+    if (!isRunning) {
+        return;
+    }
+
+    auto message = encodeMessage(std::move(data));
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    if (clients.empty()) {
+        return;
+    }
+
+    for (auto& entry : clients) {
+        enqueueFrame(*entry.second, message, messageType, RetainLatest);
+    }
+    wakeIoThread();
+}
+
+void AmanServer::publishBridgeStats(std::string data) {
+    if (!isRunning) {
+        return;
+    }
+
+    auto message = encodeMessage(std::move(data));
+    bool queued = false;
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto& entry : clients) {
+        if (entry.second->bridgeStats) {
+            enqueueFrame(*entry.second, message, "bridgeStats", RetainLatest);
+            queued = true;
         }
-        queueCondition.notify_one();
-    } catch (const std::exception& e) {
-        DebugOut("Error enqueueing message: " + std::string(e.what()));
+    }
+
+    if (queued) {
+        wakeIoThread();
     }
 }
 
+bool AmanServer::hasBridgeStatsSubscribers() {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto& entry : clients) {
+        if (entry.second->bridgeStats) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AmanServer::onSubscribeBridgeStats(ClientId clientId, bool subscribe) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientId);
+    if (it != clients.end()) {
+        it->second->bridgeStats = subscribe;
+    }
+}
+
+void AmanServer::switchCodec(ClientId clientId, WireCodec codec, std::string reply) {
+    auto message = encodeMessage(std::move(reply));
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+
+    ClientSession& client = *it->second;
+    enqueueFrame(client, message, std::string(), RetainAlways);
+    if (client.codec != codec) {
+        cborClients += codec == CodecCbor ? 1 : -1;
+        client.codec = codec;
+    }
+    wakeIoThread();
+}
+
+void AmanServer::subscribe(ClientId clientId, const std::string& airportIcao, const SubscriptionOptions& options) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+    // Registering again replaces the options and starts any delta streams over. Both happen under
+    // the lock, so publishing never sees the new options with the old streams.
+    it->second->syncedStreams.erase(airportIcao);
+    subscriptions.subscribe(clientId, airportIcao, options);
+}
+
+void AmanServer::unsubscribe(ClientId clientId, const std::string& airportIcao) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientId);
+    if (it != clients.end()) {
+        it->second->syncedStreams.erase(airportIcao);
+    }
+    subscriptions.unsubscribe(clientId, airportIcao);
+}
+
+void AmanServer::getSubscribedAirports(std::vector<std::string>& airports) {
+    airports.clear();
+    SubscriptionRegistry::Reader current(subscriptions);
+    for (auto& airport : current->airports) {
+        airports.push_back(airport.icao);
+    }
+}
+
+bool AmanServer::isSnapshotPending(const std::string& airportIcao, const std::string& messageType) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    SubscriptionRegistry::Reader current(subscriptions);
+    auto airport = current->find(airportIcao);
+    if (airport == nullptr) {
+        return false;
+    }
+    for (auto& subscriber : airport->subscribers) {
+        auto it = clients.find(subscriber.clientId);
+        if (!subscriber.options.usesDelta(messageType) || it == clients.end()) {
+            continue;
+        }
+        auto synced = it->second->syncedStreams.find(airportIcao);
+        if (synced == it->second->syncedStreams.end() || synced->second.count(messageType) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AmanServer::onRequestResync(ClientId clientId, const std::string& airportIcao) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+    SubscriptionRegistry::Reader current(subscriptions);
+    if (current->find(airportIcao, clientId) != nullptr) {
+        it->second->syncedStreams.erase(airportIcao);
+        // What was lost may have included dictionary entries; the snapshot comes with all of them
+        it->second->dictionaryEntries = 0;
+    }
+}
+
+SendQueueStats AmanServer::getSendQueueStats() {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    SendQueueStats total = retiredQueueStats;
+    // Frames still queued for disconnected clients were released with them
+    total.queuedFrames = 0;
+    total.queuedBytes = 0;
+    for (auto& entry : clients) {
+        std::lock_guard<std::mutex> sendLock(entry.second->sendMutex);
+        accumulateStats(total, entry.second->sendQueue.getStats());
+    }
+    return total;
+}
@@ -1,16 +1,24 @@
 #pragma once
 
-#include <queue>
 #include <thread>
 #include <mutex>
 #include <atomic>
-#include <condition_variable>
-#include <string>
 #include <functional>
-#include <winsock2.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "ClientSession.h"
+#include "Metrics.h"
 #include "ServerEventsHandler.h"
+#include "SessionCapture.h"
+#include "SocketLayer.h"
+#include "SubscriptionRegistry.h"
 
+// Accepts any number of AMAN/DMAN clients and serves them all from one I/O thread.
+// Each client has its own airport subscriptions and send queue.
 class AmanServer : public ServerEventsHandler {
 public:
     AmanServer();
@@ -19,24 +27,128 @@ public:
 protected:
     void startServer();
     void stop();
-    void enqueueMessage(const std::string& data);
+
+    // Messages are taken by value and moved into the shared frame, so callers can hand over
+    // large snapshots without a copy. Clients using CBOR get the message re-encoded once, unless
+    // the caller passes a CBOR frame it built more cheaply itself.
+
+    // Queue a message for one client (handshake, command replies)
+    void sendToClient(ClientId clientId, std::string data);
+
+    // Narrows publishToSubscribers() down to the subscriptions a message was produced for
+    struct Audience {
+        int tick;                       // Due on this tick (SubscriptionOptions::isDue), or -1 for all
+        uint32_t arrivalFields;         // Asking for exactly these arrival fields, or 0 for any
+
+        Audience(int tick = -1, uint32_t arrivalFields = 0) : tick(tick), arrivalFields(arrivalFields) {}
+        bool includes(const SubscriptionOptions& options) const {
+            return (tick < 0 || options.isDue(tick)) && (arrivalFields == 0 || options.arrivalFields == arrivalFields);
+        }
+    };
+
+    // Serialize-once fan-out to every client subscribed to the airport, except those receiving
+    // this message type as a delta stream. Unsent older snapshots of the same type and airport
+    // are replaced by this one. Messages only sent on change pass RetainAlways, so a full queue
+    // cannot lose them.
+    void publishToSubscribers(const std::string& airportIcao, const std::string& messageType, std::string data, std::string cborFrame = std::string(),
+        const Audience& audience = Audience(), FrameRetention retention = RetainLatest);
+    // Append-only table that delta streams refer to by index. Before a client is sent a delta or
+    // snapshot it gets the entries it does not have yet, as serialized by serializeFrom(firstIndex).
+    struct DeltaDictionary {
+        uint32_t size = 0;
+        std::function<std::string(uint32_t firstIndex)> serializeFrom;
+    };
+
+    // Next step of a delta stream for the clients that opted into it. Clients holding a baseline get
+    // `delta`; the others get `snapshot`, or stay pending if it is empty. Delta frames are never coalesced.
+    void publishDelta(const std::string& airportIcao, const std::string& messageType, std::string delta, std::string snapshot,
+        std::string cborSnapshotFrame = std::string(), const DeltaDictionary* dictionary = nullptr);
+    // Latest-value message for every connected client, coalesced by type
+    void broadcast(const std::string& messageType, std::string data);
+    // bridgeStats for the clients that subscribed to it
+    void publishBridgeStats(std::string data);
+    bool hasBridgeStatsSubscribers();
+
+    // While a batch is open the I/O thread is not woken per message; everything queued
+    // during the batch is written with a single gather-write per client when it closes.
+    class PublishBatch {
+    public:
+        explicit PublishBatch(AmanServer& server);
+        ~PublishBatch();
+
+    private:
+        AmanServer& server;
+    };
+
+    void subscribe(ClientId clientId, const std::string& airportIcao, const SubscriptionOptions& options);
+    void unsubscribe(ClientId clientId, const std::string& airportIcao);
+    // Who wants what, for any thread and without taking clientsMutex (see SubscriptionRegistry)
+    const SubscriptionRegistry& getSubscriptions() const { return subscriptions; }
+    // Union of all clients' subscriptions, sorted, replacing the contents of `airports`
+    void getSubscribedAirports(std::vector<std::string>& airports);
+    // Whether a delta subscriber of the stream is waiting for its snapshot
+    bool isSnapshotPending(const std::string& airportIcao, const std::string& messageType);
+
+    // Delta subscribers for the airport get a new snapshot, and the whole dictionary, on the next publishDelta()
+    void onRequestResync(ClientId clientId, const std::string& airportIcao) override;
+    void onSubscribeBridgeStats(ClientId clientId, bool subscribe) override;
+    // Queues `reply` in the client's current codec, then switches it to `codec`
+    void switchCodec(ClientId clientId, WireCodec codec, std::string reply);
+    bool hasCborClients() const { return cborClients > 0; }
+
+    // Send queue counters summed over all clients, including ones that have disconnected
+    SendQueueStats getSendQueueStats();
+
+    // Records connects, inbound messages and every frame as it is fully written, from now on
+    bool startCapture(const std::string& path) { return capture.start(path); }
+    void stopCapture() { capture.stop(); }
+    bool isCapturing() const { return capture.isActive(); }
 
 private:
     void serverLoop();
-    void handleClientConnection();
-    void senderThreadLoop();
-    bool sendMessageSafely(const std::string& message);
+    bool openListenSocket();
+    void acceptClients(std::vector<ClientId>& acceptedClients);
+    void readFromClient(ClientSession& client);
+    // Called with the client's sendMutex held, but not clientsMutex
+    void flushClient(ClientSession& client);
+    void waitForWritable(ClientSession& client);
+    void closeClient(ClientSession& client);
+    // Marks the client for closing and counts why
+    void disconnectClient(ClientSession& client, const char* reason);
+    void recordWrittenFrames(ClientSession& client);
+
+    // One message in each codec that connected clients use. Encoded before clientsMutex is taken;
+    // a codec a client switched to in the meantime is encoded on first use.
+    struct EncodedMessage {
+        SharedFrame frames[WIRE_CODEC_COUNT];
+    };
+    EncodedMessage encodeMessage(std::string json, std::string cborFrame = std::string());
+    // Called with clientsMutex held. Returns whether the frame is queued. Evicted stream frames resync
+    // the client's delta streams; frames that cannot be evicted and do not fit disconnect it.
+    bool enqueueFrame(ClientSession& client, EncodedMessage& message, const std::string& coalesceKey, FrameRetention retention);
+    // Called with clientsMutex held once something was queued
+    void wakeIoThread();
+    static void accumulateStats(SendQueueStats& total, const SendQueueStats& stats);
 
     std::thread serverThread;
-    std::thread senderThread;
     std::atomic<bool> isRunning;
-    std::atomic<bool> clientConnected;
     SOCKET listenSocket;
-    SOCKET clientSocket;
+    SocketPoller poller;
 
-    std::queue<std::string> messageQueue;
-    std::mutex queueMutex;
-    std::condition_variable queueCondition;
+    ClientId nextClientId;
+    std::map<ClientId, std::unique_ptr<ClientSession>> clients;
+    std::unordered_map<SOCKET, ClientSession*> clientsBySocket;    // I/O thread only, for poller events
+    // The only record of who subscribed to what. Written under clientsMutex, so that the sessions'
+    // stream state changes together with it; read by the publishing paths with the lock held.
+    SubscriptionRegistry subscriptions;
+    std::mutex clientsMutex;
+    SendQueueStats retiredQueueStats;
+    SessionCapture capture;
+    std::vector<CompletedFrame> writtenFrames;  // I/O thread only, for the capture, tracing and metrics
+    // I/O thread only: frames and bytes sent, by message type
+    std::map<std::string, std::pair<MetricCounter*, MetricCounter*>> sentFrameMetrics;
 
+    std::atomic<int> cborClients;   // Connected clients using CodecCbor
+    int openPublishBatches;     // Guarded by clientsMutex
+    bool wakeDeferred;          // Guarded by clientsMutex
 };
-
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+#include "ArrivalsDelta.h"
+
+#include <cstring>
+
+uint32_t arrivalFieldByName(const char* name) {
+    static const struct {
+        const char* name;
+        uint32_t field;
+    } fields[] = {
+        { "icaoType", ArrivalIcaoType },
+        { "latitude", ArrivalPosition },
+        { "longitude", ArrivalPosition },
+        { "flightLevel", ArrivalFlightLevel },
+        { "pressureAltitude", ArrivalPressureAltitude },
+        { "track", ArrivalTrack },
+        { "groundSpeed", ArrivalGroundSpeed },
+        { "arrivalAirportIcao", ArrivalAirportIcao },
+        { "scratchPad", ArrivalScratchPad },
+        { "assignedStar", ArrivalAssignedStar },
+        { "assignedDirect", ArrivalAssignedDirect },
+        { "assignedRunway", ArrivalAssignedRunway },
+        { "trackingController", ArrivalTrackingController },
+        { "flightPlanTas", ArrivalFlightPlanTas },
+        { "route", ArrivalRoute },
+    };
+    for (auto& entry : fields) {
+        if (strcmp(entry.name, name) == 0) {
+            return entry.field;
+        }
+    }
+    return 0;
+}
+
+uint32_t ArrivalsDeltaTracker::diff(const AmanAircraft& previous, const AmanAircraft& current) {
+    uint32_t changed = 0;
+    if (previous.icaoType != current.icaoType) changed |= ArrivalIcaoType;
+    if (previous.latitude != current.latitude || previous.longitude != current.longitude) changed |= ArrivalPosition;
+    if (previous.flightLevel != current.flightLevel) changed |= ArrivalFlightLevel;
+    if (previous.pressureAltitude != current.pressureAltitude) changed |= ArrivalPressureAltitude;
+    if (previous.track != current.track) changed |= ArrivalTrack;
+    if (previous.groundSpeed != current.groundSpeed) changed |= ArrivalGroundSpeed;
+    if (previous.arrivalAirportIcao != current.arrivalAirportIcao) changed |= ArrivalAirportIcao;
+    if (previous.scratchPad != current.scratchPad) changed |= ArrivalScratchPad;
+    if (previous.assignedStar != current.assignedStar) changed |= ArrivalAssignedStar;
+    if (previous.assignedDirectRouting != current.assignedDirectRouting) changed |= ArrivalAssignedDirect;
+    if (previous.arrivalRunway != current.arrivalRunway) changed |= ArrivalAssignedRunway;
+    if (previous.trackingController != current.trackingController) changed |= ArrivalTrackingController;
+    if (previous.flightPlanTas != current.flightPlanTas) changed |= ArrivalFlightPlanTas;
+    // Points are compared by the fingerprint they were read under, not one by one
+    if (previous.routeVersion != current.routeVersion || previous.routeFingerprint != current.routeFingerprint) changed |= ArrivalRoute | ArrivalRouteVersion;
+    if (previous.nextFixIndex != current.nextFixIndex) changed |= ArrivalNextFix;
+    return changed;
+}
+
+void ArrivalsDeltaTracker::update(const std::vector<const AmanAircraft*>& current, ArrivalsDelta& delta) {
+    delta.added.clear();
+    delta.updated.clear();
+    delta.removed.clear();
+
+    // Aircraft not stamped with this update's count are gone
+    updateCount++;
+    for (auto aircraft : current) {
+        auto previous = lastSent.find(aircraft->callsign);
+        if (previous == lastSent.end()) {
+            delta.added.push_back(aircraft);
+            lastSent.emplace(aircraft->callsign, SentArrival{ *aircraft, updateCount });
+            continue;
+        }
+
+        previous->second.lastSeen = updateCount;
+        uint32_t changedFields = diff(previous->second.aircraft, *aircraft);
+        if (changedFields != 0) {
+            delta.updated.push_back({ aircraft, changedFields });
+            previous->second.aircraft = *aircraft;
+        }
+    }
+
+    for (auto it = lastSent.begin(); it != lastSent.end();) {
+        if (it->second.lastSeen != updateCount) {
+            delta.removed.push_back(it->first);
+            it = lastSent.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    if (!delta.empty()) {
+        sequence++;
+    }
+    delta.sequence = sequence;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AmanDataTypes.h"
+
+// Fields of an arrival that can change between ticks; used as a mask in arrivalsDelta updates
+enum ArrivalField : uint32_t {
+    ArrivalIcaoType = 1 << 0,
+    ArrivalPosition = 1 << 1,             // latitude + longitude
+    ArrivalFlightLevel = 1 << 2,
+    ArrivalPressureAltitude = 1 << 3,
+    ArrivalTrack = 1 << 4,
+    ArrivalGroundSpeed = 1 << 5,
+    ArrivalAirportIcao = 1 << 6,
+    ArrivalScratchPad = 1 << 7,
+    ArrivalAssignedStar = 1 << 8,
+    ArrivalAssignedDirect = 1 << 9,
+    ArrivalAssignedRunway = 1 << 10,
+    ArrivalTrackingController = 1 << 11,
+    ArrivalFlightPlanTas = 1 << 12,
+    ArrivalRoute = 1 << 13,               // Only when the route points changed, not when one was passed
+
+    // Everything a full arrival object carries
+    ArrivalAllFields = (1 << 14) - 1,
+
+    // Delta updates only: routeVersion next to a changed route, and nextFixIndex when the
+    // aircraft passed a point of a route the client already has
+    ArrivalRouteVersion = 1 << 14,
+    ArrivalNextFix = 1 << 15
+};
+
+// The ArrivalField a member of the arrival object belongs to ("latitude" and "longitude" both
+// give ArrivalPosition), or 0 for a name that is not one of them
+uint32_t arrivalFieldByName(const char* name);
+
+struct ArrivalUpdate {
+    const AmanAircraft* aircraft;
+    uint32_t changedFields;
+};
+
+// Difference between two consecutive arrivals lists of one airport
+struct ArrivalsDelta {
+    uint64_t sequence = 0;
+    std::vector<const AmanAircraft*> added;
+    std::vector<ArrivalUpdate> updated;
+    std::vector<std::string> removed;
+
+    bool empty() const { return added.empty() && updated.empty() && removed.empty(); }
+};
+
+// Remembers the arrivals last published for one airport and diffs each new list against them.
+// The sequence number goes up by one for every non-empty delta, so clients can spot a missed one.
+class ArrivalsDeltaTracker {
+public:
+    // Pointers in `delta` are taken from `current`
+    void update(const std::vector<const AmanAircraft*>& current, ArrivalsDelta& delta);
+    uint64_t getSequence() const { return sequence; }
+
+private:
+    static uint32_t diff(const AmanAircraft& previous, const AmanAircraft& current);
+
+    struct SentArrival {
+        AmanAircraft aircraft;
+        uint64_t lastSeen;      // updateCount of the last update() that listed it
+    };
+
+    std::unordered_map<std::string, SentArrival> lastSent;
+    uint64_t sequence = 0;
+    uint64_t updateCount = 0;
+};
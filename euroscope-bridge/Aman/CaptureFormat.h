@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Layout of a session capture (.amancap), written by SessionCapture and read by tools/aman-replay.
+// Integers are unsigned LEB128 varints.
+//
+//   header:   "AMANCAP1", capture start in microseconds since the Unix epoch
+//   record:   type byte, microseconds since the previous record (or the start), then per type:
+//     CaptureClientConnected, CaptureClientDisconnected:   clientId
+//     CaptureInbound:      clientId, payload               one message received from the client
+//     CaptureFrameSent:    clientId, frameId, payload      a frame fully written to the client
+//     CaptureFrameRepeat:  clientId, frameId               the same frame as an earlier CaptureFrameSent
+//     CaptureGap:          number of records dropped because the writer fell behind
+//   payload:  raw length, stored length, stored bytes; LZ4 block compressed unless the lengths are equal
+//
+// Frame ids count up from 0. A repeat only refers to one of the last CAPTURE_FRAME_WINDOW ids, so a
+// reader needs to keep no more than that many frames in memory.
+
+const char CAPTURE_MAGIC[] = "AMANCAP1";
+const size_t CAPTURE_MAGIC_LENGTH = 8;
+const uint64_t CAPTURE_FRAME_WINDOW = 256;
+
+enum CaptureRecordType : uint8_t {
+    CaptureClientConnected = 1,
+    CaptureClientDisconnected = 2,
+    CaptureInbound = 3,
+    CaptureFrameSent = 4,
+    CaptureFrameRepeat = 5,
+    CaptureGap = 6
+};
+
+inline void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "CoalescingSendQueue.h"
+#include "ReceiveBuffer.h"
+#include "ServerEventsHandler.h"
+#include "SocketLayer.h"
+#include "WireCodec.h"
+
+// Upper bound on what a slow client can make us buffer; older snapshots are coalesced or evicted first
+const size_t MAX_QUEUED_BYTES_PER_CLIENT = 16 * 1024 * 1024;
+
+// Per-connection state owned by AmanServer. The send queue is guarded by sendMutex, so that the I/O
+// thread can write to one client while the others are published to; the stream state below it is
+// guarded by AmanServer::clientsMutex. The socket and receive buffer are only touched by the I/O
+// thread. What the client subscribed to is kept in AmanServer's SubscriptionRegistry, not here.
+struct ClientSession {
+    ClientId id;
+    SOCKET socket;
+
+    ReceiveBuffer receiveBuffer;
+
+    std::mutex sendMutex;                  // Taken after AmanServer::clientsMutex when both are needed
+    CoalescingSendQueue sendQueue{ MAX_QUEUED_BYTES_PER_CLIENT };
+    std::chrono::steady_clock::time_point lastSendProgress;
+    bool waitingForWritable = false;       // I/O thread only: writable interest registered with the poller
+
+    // Delta streams the client holds a baseline snapshot for, by airport ICAO; anything else gets a snapshot first
+    std::map<std::string, std::set<std::string>> syncedStreams;
+    bool bridgeStats = false;                               // Subscribed to bridgeStats
+    WireCodec codec = CodecJson;                            // Of the messages queued from now on
+    uint32_t dictionaryEntries = 0;                         // Of the delta streams' dictionary, already queued
+    std::atomic<bool> closing{ false };
+};
@@ -0,0 +1,129 @@
+#include "stdafx.h"
+#include "CoalescingSendQueue.h"
+
+static const char FRAME_DELIMITER[] = "\n";
+
+CoalescingSendQueue::CoalescingSendQueue(size_t maxBytes) : frontOffset(0), maxBytes(maxBytes), streamLost(false) {}
+
+bool CoalescingSendQueue::push(const SharedFrame& frame, const std::string& coalesceKey, FrameRetention retention) {
+    stats.framesQueued++;
+    auto now = std::chrono::steady_clock::now();
+
+    if (!coalesceKey.empty()) {
+        // The head frame may be half written, so only entries behind it can be replaced
+        for (size_t i = firstMutableIndex(); i < entries.size(); i++) {
+            if (entries[i].coalesceKey == coalesceKey && isCborFrame(*entries[i].frame) == isCborFrame(*frame)) {
+                stats.queuedBytes -= wireSize(entries[i].frame);
+                stats.queuedBytes += wireSize(frame);
+                entries[i].frame = frame;
+                entries[i].retention = retention;
+                entries[i].queuedAt = now;
+                stats.framesCoalesced++;
+                return evictToFit(i);
+            }
+        }
+    }
+
+    entries.push_back({ frame, coalesceKey, retention, now });
+    stats.queuedBytes += wireSize(frame);
+    stats.queuedFrames = entries.size();
+    return evictToFit(entries.size() - 1);
+}
+
+bool CoalescingSendQueue::takeStreamLoss() {
+    bool lost = streamLost;
+    streamLost = false;
+    return lost;
+}
+
+bool CoalescingSendQueue::evictToFit(size_t pushedIndex) {
+    bool pushedKept = true;
+
+    // Oldest snapshots go first: the next tick brings a fresher copy anyway
+    for (size_t i = firstMutableIndex(); i < entries.size() && isOverCap();) {
+        if (entries[i].retention != RetainLatest) {
+            i++;
+            continue;
+        }
+        if (i == pushedIndex) {
+            pushedKept = false;
+        } else if (i < pushedIndex) {
+            pushedIndex--;
+        }
+        evict(i);
+    }
+
+    // Then stream frames from the tail, so what remains of each stream is still a valid prefix
+    for (size_t i = entries.size(); i > firstMutableIndex() && isOverCap();) {
+        i--;
+        if (entries[i].retention != RetainStream) {
+            continue;
+        }
+        if (i == pushedIndex) {
+            pushedKept = false;
+        } else if (i < pushedIndex) {
+            pushedIndex--;
+        }
+        evict(i);
+        streamLost = true;
+    }
+
+    stats.queuedFrames = entries.size();
+    return pushedKept;
+}
+
+void CoalescingSendQueue::evict(size_t index) {
+    stats.queuedBytes -= wireSize(entries[index].frame);
+    entries.erase(entries.begin() + index);
+    stats.framesDropped++;
+}
+
+size_t CoalescingSendQueue::gather(SendSlice* slices, size_t maxSlices, size_t& bytes) const {
+    size_t count = 0;
+    bytes = 0;
+
+    for (size_t i = 0; i < entries.size() && count + 2 <= maxSlices; i++) {
+        const std::string& payload = *entries[i].frame;
+        size_t offset = i == 0 ? frontOffset : 0;
+
+        // Only the delimiter is left if the payload itself went out in an earlier write
+        if (offset < payload.size()) {
+            slices[count++] = { payload.data() + offset, payload.size() - offset };
+            bytes += payload.size() - offset;
+        }
+        // CBOR frames carry their length instead
+        if (!isCborFrame(payload)) {
+            slices[count++] = { FRAME_DELIMITER, 1 };
+            bytes += 1;
+        }
+    }
+    return count;
+}
+
+void CoalescingSendQueue::consume(size_t bytes, std::vector<CompletedFrame>* completedFrames) {
+    while (bytes > 0 && !entries.empty()) {
+        size_t remaining = wireSize(entries.front().frame) - frontOffset;
+        if (bytes < remaining) {
+            frontOffset += bytes;
+            return;
+        }
+
+        bytes -= remaining;
+        stats.queuedBytes -= wireSize(entries.front().frame);
+        if (completedFrames) {
+            Entry& entry = entries.front();
+            completedFrames->push_back({ entry.frame, entry.coalesceKey, entry.queuedAt });
+        }
+        entries.pop_front();
+        frontOffset = 0;
+        stats.queuedFrames = entries.size();
+    }
+}
+
+void CoalescingSendQueue::clear() {
+    entries.clear();
+    frontOffset = 0;
+    streamLost = false;
+    stats.queuedBytes = 0;
+    stats.queuedFrames = 0;
+}
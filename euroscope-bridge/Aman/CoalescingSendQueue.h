@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SocketLayer.h"
+#include "WireCodec.h"
+
+// One complete message: JSON without its newline delimiter, or a length-prefixed CBOR message.
+// Snapshots are encoded once per codec and the same frame is shared by every client subscribed
+// to the airport.
+typedef std::shared_ptr<const std::string> SharedFrame;
+
+struct SendQueueStats {
+    uint64_t framesQueued = 0;
+    uint64_t framesCoalesced = 0;   // Unsent snapshots replaced by a newer one
+    uint64_t framesDropped = 0;     // Frames discarded to stay under the byte cap
+    size_t queuedFrames = 0;
+    size_t queuedBytes = 0;         // Including delimiters
+};
+
+// What the queue may discard to stay under its byte cap
+enum FrameRetention {
+    RetainLatest,       // Periodic snapshot; evicted first, the next tick brings a fresher copy
+    RetainStream,       // Delta stream or dictionary frame; evicted from the tail, after which the stream is lost
+    RetainAlways        // One-off reply or change-only message; never evicted
+};
+
+// A frame that has been written in full, as reported by CoalescingSendQueue::consume()
+struct CompletedFrame {
+    SharedFrame frame;
+    std::string coalesceKey;
+    std::chrono::steady_clock::time_point queuedAt;     // When this frame (not one it replaced) was pushed
+};
+
+// Per-client outbound queue. Frames pushed with a coalesce key (e.g. "arrivals/ENGM") are
+// latest-value: a newer frame with the same key replaces the unsent older one in place.
+// Frames without a key (command replies, pluginVersion) keep strict FIFO order. Frames of different
+// codecs never replace each other, so a codec switch takes effect at a frame boundary.
+// Over maxBytes, the oldest snapshots are evicted first, then stream frames from the tail. Frames
+// that must be kept are never evicted, so the queue can stay over the cap (see isOverCap()).
+class CoalescingSendQueue {
+public:
+    explicit CoalescingSendQueue(size_t maxBytes);
+
+    // Returns whether the frame is still queued once the queue has been brought back under the cap
+    bool push(const SharedFrame& frame, const std::string& coalesceKey, FrameRetention retention);
+    // Whether stream frames were evicted since the last call; the client then needs a resync
+    bool takeStreamLoss();
+    // Only frames that must be kept are left, and they do not fit
+    bool isOverCap() const { return stats.queuedBytes > maxBytes; }
+
+    bool empty() const { return entries.empty(); }
+    // Points `slices` at the unsent data, each JSON frame followed by a separate newline slice,
+    // without copying anything. Returns the number of slices filled and their total length in `bytes`.
+    size_t gather(SendSlice* slices, size_t maxSlices, size_t& bytes) const;
+    // Mark bytes as written, popping every frame that is now complete. Those frames are also
+    // appended to `completedFrames` if given.
+    void consume(size_t bytes, std::vector<CompletedFrame>* completedFrames = nullptr);
+    void clear();
+
+    const SendQueueStats& getStats() const { return stats; }
+
+private:
+    struct Entry {
+        SharedFrame frame;
+        std::string coalesceKey;
+        FrameRetention retention;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    // Bytes a frame occupies on the wire, delimiter included
+    static size_t wireSize(const SharedFrame& frame) { return frameWireSize(*frame); }
+    // Index of the first entry that may still be replaced or evicted
+    size_t firstMutableIndex() const { return frontOffset > 0 ? 1 : 0; }
+    // Returns whether the entry at `pushedIndex` survived
+    bool evictToFit(size_t pushedIndex);
+    void evict(size_t index);
+
+    std::deque<Entry> entries;
+    size_t frontOffset;             // Bytes of entries.front(), delimiter included, already written
+    size_t maxBytes;
+    bool streamLost;
+    SendQueueStats stats;
+};
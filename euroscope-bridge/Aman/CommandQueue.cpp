@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "CommandQueue.h"
+
+std::string PluginCommand::collapseKey() const {
+    switch (type) {
+    case AssignRunway:
+        return "assignRunway/" + callsign;
+    case SetCtot:
+        return "setCtot/" + callsign;
+    case SendRunwayStatuses:
+        return "runwayStatuses/" + std::to_string(clientId) + "/" + airportIcao;
+    case DisplayError:
+        break;
+    }
+    return std::string();
+}
+
+CommandQueue::CommandQueue() : head(nullptr) {}
+
+CommandQueue::~CommandQueue() {
+    Node* node = head.exchange(nullptr);
+    while (node != nullptr) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+void CommandQueue::push(PluginCommand command) {
+    Node* node = new Node{ std::move(command), head.load(std::memory_order_relaxed) };
+    while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+void CommandQueue::drain(std::vector<PluginCommand>& commands) {
+    Node* node = head.exchange(nullptr, std::memory_order_acquire);
+
+    // Reverse into arrival order
+    Node* oldest = nullptr;
+    while (node != nullptr) {
+        Node* next = node->next;
+        node->next = oldest;
+        oldest = node;
+        node = next;
+    }
+
+    while (oldest != nullptr) {
+        Node* next = oldest->next;
+        commands.push_back(std::move(oldest->command));
+        delete oldest;
+        oldest = next;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "ServerEventsHandler.h"
+
+// A client request that touches the EuroScope API and therefore has to run on the EuroScope thread
+struct PluginCommand {
+    enum Type {
+        AssignRunway,
+        SetCtot,
+        SendRunwayStatuses,     // Current runway configuration for a newly registered airport
+        DisplayError            // Never collapsed
+    };
+
+    Type type;
+    ClientId clientId;
+    std::string requestId;      // Echoed in the commandResult reply; no reply when empty
+    std::string callsign;
+    std::string runway;
+    std::string airportIcao;
+    std::string message;
+    long ctot = 0;
+
+    // Commands with the same non-empty key replace each other when they are drained in the same batch
+    std::string collapseKey() const;
+};
+
+// Lock-free multi-producer, single-consumer queue. Any thread may push; the EuroScope thread
+// takes everything queued so far with one drain() per tick.
+class CommandQueue {
+public:
+    CommandQueue();
+    ~CommandQueue();
+
+    void push(PluginCommand command);
+    // Appends all queued commands to `commands`, oldest first
+    void drain(std::vector<PluginCommand>& commands);
+
+private:
+    struct Node {
+        PluginCommand command;
+        Node* next;
+    };
+
+    // Pushed nodes form a stack (newest first); drain() detaches it whole and reverses it
+    std::atomic<Node*> head;
+};
@@ -0,0 +1,49 @@
+#include "stdafx.h"
+#include "DeparturesDelta.h"
+
+bool DeparturesDeltaTracker::same(const DmanAircraft& previous, const DmanAircraft& current) {
+    return previous.departureAirportIcao == current.departureAirportIcao
+        && previous.sid == current.sid
+        && previous.runway == current.runway
+        && previous.icaoType == current.icaoType
+        && previous.wakeCategory == current.wakeCategory
+        && previous.estimatedDepartureTime == current.estimatedDepartureTime;
+}
+
+void DeparturesDeltaTracker::update(const std::vector<DmanAircraft>& current, size_t count, DeparturesDelta& delta) {
+    delta.added.clear();
+    delta.updated.clear();
+    delta.removed.clear();
+
+    // Departures not stamped with this update's count are gone
+    updateCount++;
+    for (size_t i = 0; i < count; i++) {
+        auto& aircraft = current[i];
+        auto previous = lastSent.find(aircraft.callsign);
+        if (previous == lastSent.end()) {
+            delta.added.push_back(&aircraft);
+            lastSent.emplace(aircraft.callsign, SentDeparture{ aircraft, updateCount });
+            continue;
+        }
+
+        previous->second.lastSeen = updateCount;
+        if (!same(previous->second.aircraft, aircraft)) {
+            delta.updated.push_back(&aircraft);
+            previous->second.aircraft = aircraft;
+        }
+    }
+
+    for (auto it = lastSent.begin(); it != lastSent.end();) {
+        if (it->second.lastSeen != updateCount) {
+            delta.removed.push_back(it->first);
+            it = lastSent.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    if (!delta.empty()) {
+        sequence++;
+    }
+    delta.sequence = sequence;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AmanDataTypes.h"
+
+// Difference between two consecutive departures lists of one airport. Departures are small, so
+// an updated one is sent whole rather than by field.
+struct DeparturesDelta {
+    uint64_t sequence = 0;
+    std::vector<const DmanAircraft*> added;
+    std::vector<const DmanAircraft*> updated;
+    std::vector<std::string> removed;
+
+    bool empty() const { return added.empty() && updated.empty() && removed.empty(); }
+};
+
+// Remembers the departures last published for one airport and diffs each new list against them,
+// numbering non-empty deltas like ArrivalsDeltaTracker does.
+class DeparturesDeltaTracker {
+public:
+    // Pointers in `delta` are taken from the first `count` of `current`
+    void update(const std::vector<DmanAircraft>& current, size_t count, DeparturesDelta& delta);
+    uint64_t getSequence() const { return sequence; }
+
+private:
+    static bool same(const DmanAircraft& previous, const DmanAircraft& current);
+
+    struct SentDeparture {
+        DmanAircraft aircraft;
+        uint64_t lastSeen;      // updateCount of the last update() that listed it
+    };
+
+    std::unordered_map<std::string, SentDeparture> lastSent;
+    uint64_t sequence = 0;
+    uint64_t updateCount = 0;
+};
@@ -0,0 +1,71 @@
+#include "stdafx.h"
+#include "FixDictionary.h"
+
+#include <cstring>
+
+namespace {
+
+const size_t INITIAL_SLOTS = 1024;
+
+// Coordinates are matched by their bits, as they are hashed, so that a NaN finds its own entry
+// again instead of adding a new one on every lookup
+bool sameBits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+}
+
+FixDictionary::FixDictionary() : slots(INITIAL_SLOTS, 0) {
+}
+
+uint64_t FixDictionary::hash(const char* name, size_t nameLength, double latitude, double longitude) {
+    // FNV-1a over the name and the bits of both coordinates
+    uint64_t value = 14695981039346656037ull;
+    auto mix = [&value](const void* data, size_t length) {
+        auto bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < length; i++) {
+            value = (value ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    mix(name, nameLength);
+    mix(&latitude, sizeof(latitude));
+    mix(&longitude, sizeof(longitude));
+    return value;
+}
+
+uint32_t FixDictionary::intern(const char* name, size_t nameLength, double latitude, double longitude) {
+    uint64_t entryHash = hash(name, nameLength, latitude, longitude);
+    size_t mask = slots.size() - 1;
+    size_t slot = (size_t)entryHash & mask;
+    while (slots[slot] != 0) {
+        uint32_t id = slots[slot] - 1;
+        const Entry& entry = entries[id];
+        if (entryHashes[id] == entryHash && sameBits(entry.latitude, latitude) && sameBits(entry.longitude, longitude)
+            && entry.name.size() == nameLength && memcmp(entry.name.data(), name, nameLength) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    uint32_t id = (uint32_t)entries.size();
+    entries.push_back({ std::string(name, nameLength), latitude, longitude });
+    entryHashes.push_back(entryHash);
+    slots[slot] = id + 1;
+    // Keep the load factor at or below one half
+    if (entries.size() * 2 > slots.size()) {
+        grow();
+    }
+    return id;
+}
+
+void FixDictionary::grow() {
+    slots.assign(slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (uint32_t id = 0; id < entries.size(); id++) {
+        size_t slot = (size_t)entryHashes[id] & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id + 1;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Every distinct route point (name and position) seen since the plugin was loaded, numbered in
+// the order they were first seen. Delta stream routes refer to points by this id; entries are
+// never removed or renumbered, so clients only ever need the ones added since they last heard.
+class FixDictionary {
+public:
+    struct Entry {
+        std::string name;
+        double latitude;
+        double longitude;
+    };
+
+    FixDictionary();
+
+    // Id of the point, added if it is new. Looking up a known point does not allocate.
+    uint32_t intern(const char* name, size_t nameLength, double latitude, double longitude);
+
+    uint32_t size() const { return (uint32_t)entries.size(); }
+    const Entry& at(uint32_t id) const { return entries[id]; }
+
+private:
+    static uint64_t hash(const char* name, size_t nameLength, double latitude, double longitude);
+    void grow();
+
+    std::vector<Entry> entries;
+    std::vector<uint64_t> entryHashes;      // Parallel to entries, for rehashing
+    // Open addressing with linear probing: entry id + 1, or 0 for an empty slot. The size is a power of two.
+    std::vector<uint32_t> slots;
+};
@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include "FrameCompression.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+// The format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+const size_t LAST_LITERALS = 5;
+const size_t MATCH_FIND_LIMIT = 12;
+const size_t MAX_OFFSET = 65535;
+const int HASH_BITS = 12;
+
+uint32_t read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hashSequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Lengths of 15 and more continue in extra bytes of 255, ended by a byte below 255
+void appendLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back((char)255);
+        length -= 255;
+    }
+    out.push_back((char)length);
+}
+
+void appendSequence(std::string& out, const char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength - MIN_MATCH;
+    out.push_back((char)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+    if (literalLength >= 15) {
+        appendLength(out, literalLength - 15);
+    }
+    out.append(literals, literalLength);
+    out.push_back((char)(offset & 0xFF));
+    out.push_back((char)(offset >> 8));
+    if (matchCode >= 15) {
+        appendLength(out, matchCode - 15);
+    }
+}
+
+void appendLastLiterals(std::string& out, const char* literals, size_t literalLength) {
+    out.push_back((char)((literalLength < 15 ? literalLength : 15) << 4));
+    if (literalLength >= 15) {
+        appendLength(out, literalLength - 15);
+    }
+    out.append(literals, literalLength);
+}
+
+bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if (in >= end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+}
+
+void compressBlock(const char* data, size_t size, std::string& out) {
+    out.clear();
+    out.reserve(size / 2 + 16);
+    if (size < MATCH_FIND_LIMIT + 1) {
+        appendLastLiterals(out, data, size);
+        return;
+    }
+
+    // Most recent position of each 4-byte sequence; thread_local so concurrent writers don't share it
+    thread_local std::vector<int32_t> table;
+    table.assign((size_t)1 << HASH_BITS, -1);
+
+    const size_t matchStartLimit = size - MATCH_FIND_LIMIT;
+    const size_t matchEndLimit = size - LAST_LITERALS;
+    size_t anchor = 0;
+    size_t pos = 0;
+    size_t misses = 0;
+
+    while (pos < matchStartLimit) {
+        uint32_t sequence = read32(data + pos);
+        uint32_t hash = hashSequence(sequence);
+        int32_t candidate = table[hash];
+        table[hash] = (int32_t)pos;
+
+        if (candidate < 0 || pos - candidate > MAX_OFFSET || read32(data + candidate) != sequence) {
+            // Skip ahead faster through data that doesn't compress
+            pos += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+
+        size_t matchLength = MIN_MATCH;
+        while (pos + matchLength < matchEndLimit && data[candidate + matchLength] == data[pos + matchLength]) {
+            matchLength++;
+        }
+        appendSequence(out, data + anchor, pos - anchor, pos - candidate, matchLength);
+        pos += matchLength;
+        anchor = pos;
+    }
+
+    appendLastLiterals(out, data + anchor, size - anchor);
+}
+
+bool decompressBlock(const char* data, size_t size, size_t rawSize, std::string& out) {
+    out.resize(rawSize);
+    char* output = &out[0];
+    size_t written = 0;
+    const unsigned char* in = (const unsigned char*)data;
+    const unsigned char* end = in + size;
+
+    while (in < end) {
+        unsigned char token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, end, literalLength)) {
+            return false;
+        }
+        if (literalLength > (size_t)(end - in) || literalLength > rawSize - written) {
+            return false;
+        }
+        memcpy(output + written, in, literalLength);
+        in += literalLength;
+        written += literalLength;
+
+        // The last sequence has no match
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(in, end, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > rawSize - written) {
+            return false;
+        }
+
+        // Byte by byte: the match may overlap the bytes it produces
+        const char* match = output + written - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            output[written + i] = match[i];
+        }
+        written += matchLength;
+    }
+
+    return written == rawSize;
+}
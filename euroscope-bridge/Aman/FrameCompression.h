@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// LZ4 block format (no frame header, no checksums), so captures can also be read with any LZ4
+// library given the raw length. JSON frames compress well with plain greedy matching; speed
+// matters more than ratio here, since it runs for every frame while a capture is on.
+
+// Replaces `out` with the compressed form of the input
+void compressBlock(const char* data, size_t size, std::string& out);
+// Replaces `out` with the `rawSize` bytes the block expands to; false if the block is damaged
+bool decompressBlock(const char* data, size_t size, size_t rawSize, std::string& out);
@@ -1,198 +1,565 @@
 #include "stdafx.h"
 
-#include <map>
+#include <algorithm>
 #include "JsonMessageHelper.h"
+#include "WireCodec.h"
 
-#define RAPIDJSON_HAS_STDSTRING 1
-
-#include "rapidjson/document.h"
-#include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
 using namespace rapidjson;
 
-const std::string JsonMessageHelper::getJsonOfPluginVersion(const std::string& version) {
-    Document document;
-    document.SetObject();
-    Document::AllocatorType& allocator = document.GetAllocator();
+namespace {
 
-    document.AddMember("type", "pluginVersion", allocator);
-    document.AddMember("version", Value(version.c_str(), allocator), allocator);
+// Lets rapidjson::Writer append directly to a caller-owned std::string
+class StringOutputStream {
+public:
+    typedef char Ch;
 
-    StringBuffer sb;
-    Writer<StringBuffer> writer(sb);
-    document.Accept(writer);
-    return sb.GetString();
-}
+    explicit StringOutputStream(std::string& out) : out(out) {
+        out.clear();
+    }
 
-const std::string JsonMessageHelper::getJsonOfArrivals(const std::vector<AmanAircraft>& aircraftList) {
-    Document document;
-    document.SetObject();
-    Value arrivalsArray(kArrayType);
+    void Put(char c) { out.push_back(c); }
+    void Flush() {}
 
-    Document::AllocatorType& allocator = document.GetAllocator();
+    // Already serialized JSON, appended in one go
+    void append(const std::string& json) { out.append(json); }
 
-    for (auto& inbound : aircraftList) {
-        Value arrivalObject(kObjectType);
+private:
+    std::string& out;
+};
 
-        arrivalObject.AddMember("callsign", inbound.callsign, allocator);
-        arrivalObject.AddMember("icaoType", inbound.icaoType, allocator);
-        arrivalObject.AddMember("latitude", inbound.latitude, allocator);
-        arrivalObject.AddMember("longitude", inbound.longitude, allocator);
-        arrivalObject.AddMember("flightLevel", inbound.flightLevel, allocator);
-        arrivalObject.AddMember("pressureAltitude", inbound.pressureAltitude, allocator);
-        arrivalObject.AddMember("track", inbound.track, allocator);
-        arrivalObject.AddMember("groundSpeed", inbound.groundSpeed, allocator);
-        arrivalObject.AddMember("arrivalAirportIcao", inbound.arrivalAirportIcao, allocator);
+// The writer's nesting stack, kept in the writer itself so that serializing a message does not allocate
+struct WriterStackStorage {
+    char buffer[1024];      // The default 32 levels plus the pool's chunk header
+    MemoryPoolAllocator<> allocator;
 
-        if (!inbound.scratchPad.empty())
-            arrivalObject.AddMember("scratchPad", inbound.scratchPad, allocator);
+    WriterStackStorage() : allocator(buffer, sizeof(buffer)) {}
+};
+
+class JsonWriter : private WriterStackStorage, public Writer<StringOutputStream, UTF8<>, UTF8<>, MemoryPoolAllocator<>> {
+public:
+    explicit JsonWriter(StringOutputStream& stream) : Writer(stream, &allocator) {}
+};
+
+// The templates take a JsonWriter or a CborWriter
+template <typename Writer>
+void writeString(Writer& writer, const std::string& value) {
+    writer.String(value.data(), (SizeType)value.size());
+}
 
-        if (!inbound.assignedStar.empty())
-            arrivalObject.AddMember("assignedStar", inbound.assignedStar, allocator);
+template <typename Writer>
+void writeStringMember(Writer& writer, const char* name, const std::string& value) {
+    writer.Key(name);
+    writeString(writer, value);
+}
 
-        if (!inbound.assignedDirectRouting.empty())
-            arrivalObject.AddMember("assignedDirect", inbound.assignedDirectRouting, allocator);
+// Full arrivals omit empty optional fields; delta updates write every changed field, even when it became empty.
+// The delta stream sends routes as FixDictionary ids, passed or not being given by nextFixIndex.
+template <typename Writer>
+void writeArrivalObject(Writer& writer, const AmanAircraft& inbound, uint32_t fields, bool omitEmpty, bool fixIds = false) {
+    writer.StartObject();
+
+    writeStringMember(writer, "callsign", inbound.callsign);
+    if (fields & ArrivalIcaoType)
+        writeStringMember(writer, "icaoType", inbound.icaoType);
+    if (fields & ArrivalPosition) {
+        writer.Key("latitude");
+        writer.Double(inbound.latitude);
+        writer.Key("longitude");
+        writer.Double(inbound.longitude);
+    }
+    if (fields & ArrivalFlightLevel) {
+        writer.Key("flightLevel");
+        writer.Int(inbound.flightLevel);
+    }
+    if (fields & ArrivalPressureAltitude) {
+        writer.Key("pressureAltitude");
+        writer.Int(inbound.pressureAltitude);
+    }
+    if (fields & ArrivalTrack) {
+        writer.Key("track");
+        writer.Int(inbound.track);
+    }
+    if (fields & ArrivalGroundSpeed) {
+        writer.Key("groundSpeed");
+        writer.Int(inbound.groundSpeed);
+    }
+    if (fields & ArrivalAirportIcao)
+        writeStringMember(writer, "arrivalAirportIcao", inbound.arrivalAirportIcao);
 
-        if (!inbound.arrivalRunway.empty())
-            arrivalObject.AddMember("assignedRunway", inbound.arrivalRunway, allocator);
+    if ((fields & ArrivalScratchPad) && !(omitEmpty && inbound.scratchPad.empty()))
+        writeStringMember(writer, "scratchPad", inbound.scratchPad);
 
-        if (!inbound.trackingController.empty())
-            arrivalObject.AddMember("trackingController", inbound.trackingController, allocator);
+    if ((fields & ArrivalAssignedStar) && !(omitEmpty && inbound.assignedStar.empty()))
+        writeStringMember(writer, "assignedStar", inbound.assignedStar);
 
-        if (inbound.flightPlanTas > 0)
-            arrivalObject.AddMember("flightPlanTas", inbound.flightPlanTas, allocator);
+    if ((fields & ArrivalAssignedDirect) && !(omitEmpty && inbound.assignedDirectRouting.empty()))
+        writeStringMember(writer, "assignedDirect", inbound.assignedDirectRouting);
 
-        Value routePoints(kArrayType);
+    if ((fields & ArrivalAssignedRunway) && !(omitEmpty && inbound.arrivalRunway.empty()))
+        writeStringMember(writer, "assignedRunway", inbound.arrivalRunway);
+
+    if ((fields & ArrivalTrackingController) && !(omitEmpty && inbound.trackingController.empty()))
+        writeStringMember(writer, "trackingController", inbound.trackingController);
+
+    if ((fields & ArrivalFlightPlanTas) && !(omitEmpty && inbound.flightPlanTas <= 0)) {
+        writer.Key("flightPlanTas");
+        writer.Int(inbound.flightPlanTas);
+    }
+
+    if (fields & ArrivalRouteVersion) {
+        writer.Key("routeVersion");
+        writer.Uint(inbound.routeVersion);
+    }
+    if (fields & ArrivalNextFix) {
+        writer.Key("nextFixIndex");
+        writer.Int(inbound.nextFixIndex);
+    }
+
+    if ((fields & ArrivalRoute) && fixIds) {
+        writer.Key("route");
+        writer.StartArray();
+        for (auto& point : inbound.remainingRoute) {
+            writer.Uint(point.fixId);
+        }
+        writer.EndArray();
+    } else if (fields & ArrivalRoute) {
+        writer.Key("route");
+        writer.StartArray();
         for (auto& point : inbound.remainingRoute) {
-            Value pointObject(kObjectType);
-            pointObject.AddMember("name", point.name, allocator);
-            pointObject.AddMember("latitude", point.latitude, allocator);
-            pointObject.AddMember("longitude", point.longitude, allocator);
-            pointObject.AddMember("isPassed", point.isPassed, allocator);
-            routePoints.PushBack(pointObject, allocator);
+            writer.StartObject();
+            writeStringMember(writer, "name", point.name);
+            writer.Key("latitude");
+            writer.Double(point.latitude);
+            writer.Key("longitude");
+            writer.Double(point.longitude);
+            writer.Key("isPassed");
+            writer.Bool(point.isPassed);
+            writer.EndObject();
         }
+        writer.EndArray();
+    }
+
+    writer.EndObject();
+}
 
-        arrivalObject.AddMember("route", routePoints, allocator);
+void writeDepartureObject(JsonWriter& writer, const DmanAircraft& outbound) {
+    writer.StartObject();
+    writeStringMember(writer, "departureAirportIcao", outbound.departureAirportIcao);
+    writeStringMember(writer, "callsign", outbound.callsign);
+    writeStringMember(writer, "sid", outbound.sid);
+    writeStringMember(writer, "runway", outbound.runway);
+    writer.Key("estimatedDepartureTime");
+    writer.Int64(outbound.estimatedDepartureTime);
+    writeStringMember(writer, "icaoType", outbound.icaoType);
+    // Sent as its character code, as it always has been
+    writer.Key("wakeCategory");
+    writer.Int(outbound.wakeCategory);
+    writer.EndObject();
+}
 
-        arrivalsArray.PushBack(arrivalObject, allocator);
+// Arrival objects are serialized once per change and copied in as they are. The writer is bypassed
+// for the elements; EndArray() only needs the array to have been opened through it.
+void writeInbounds(JsonWriter& writer, StringOutputStream& stream, const std::vector<const std::string*>& arrivalsJson) {
+    writer.Key("inbounds");
+    writer.StartArray();
+    for (size_t i = 0; i < arrivalsJson.size(); i++) {
+        if (i > 0) {
+            stream.Put(',');
+        }
+        stream.append(*arrivalsJson[i]);
     }
+    writer.EndArray();
+}
+
+// Arrivals in a snapshot or added by a delta: everything, plus what later updates are relative to
+const uint32_t DELTA_STREAM_FIELDS = ArrivalAllFields | ArrivalRouteVersion | ArrivalNextFix;
+
+MetricCounter* serializedBytes(const char* messageType) {
+    return &Metrics::counter("aman_serialized_bytes_total", "JSON produced by the serializer, by message type", { { "type", messageType } });
+}
+
+}
 
-    document.AddMember("type", "arrivals", allocator);
-    document.AddMember("inbounds", arrivalsArray, allocator);
+JsonMessageHelper::JsonMessageHelper()
+    : arrivalsBytes(serializedBytes("arrivals")),
+      arrivalsSnapshotBytes(serializedBytes("arrivalsSnapshot")),
+      arrivalsDeltaBytes(serializedBytes("arrivalsDelta")),
+      fixDictionaryBytes(serializedBytes("fixDictionary")),
+      departuresBytes(serializedBytes("departures")),
+      departuresSnapshotBytes(serializedBytes("departuresSnapshot")),
+      departuresDeltaBytes(serializedBytes("departuresDelta")),
+      otherBytes(serializedBytes("other")) {
+}
 
-    StringBuffer sb;
-    Writer<StringBuffer> writer(sb);
-    document.Accept(writer);
+void JsonMessageHelper::writePluginVersion(const std::string& version, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
 
-    return sb.GetString();
+    writer.StartObject();
+    writeStringMember(writer, "type", "pluginVersion");
+    writeStringMember(writer, "version", version);
+    writer.EndObject();
+    otherBytes->add(out.size());
 }
 
-const std::string JsonMessageHelper::getJsonOfRunwayStatuses(const std::vector<RunwayStatus>& runways) {
-    Document document;
-    document.SetObject();
-    Document::AllocatorType& allocator = document.GetAllocator();
+void JsonMessageHelper::writeCodecSelected(const std::string& codec, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
 
-    Value airportsObj(kObjectType);
+    writer.StartObject();
+    writeStringMember(writer, "type", "codecSelected");
+    writeStringMember(writer, "codec", codec);
+    writer.EndObject();
+    otherBytes->add(out.size());
+}
 
-    // Create nested map structure: airport ICAO -> runway ID -> arrivals/departures -> bool
-    std::map<std::string, std::map<std::string, std::map<std::string, bool>>> airportRunwayMap;
-    
+void JsonMessageHelper::writeArrival(const AmanAircraft& inbound, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+    writeArrivalObject(writer, inbound, ArrivalAllFields, true);
+}
+
+void JsonMessageHelper::writeArrivalCbor(const AmanAircraft& inbound, std::string& out) {
+    out.clear();
+    CborWriter writer(out);
+    writeArrivalObject(writer, inbound, ArrivalAllFields, true);
+}
+
+void JsonMessageHelper::writeArrivals(const std::vector<const std::string*>& arrivalsJson, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "arrivals");
+    writeInbounds(writer, stream, arrivalsJson);
+    writer.EndObject();
+    arrivalsBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeArrivals(const std::vector<const AmanAircraft*>& arrivals, uint32_t fields, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "arrivals");
+    writer.Key("inbounds");
+    writer.StartArray();
+    for (auto inbound : arrivals) {
+        writeArrivalObject(writer, *inbound, fields, true);
+    }
+    writer.EndArray();
+    writer.EndObject();
+    arrivalsBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeArrivalsSnapshot(const std::string& airportIcao, uint64_t sequence, const std::vector<const AmanAircraft*>& arrivals, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "arrivalsSnapshot");
+    writeStringMember(writer, "icao", airportIcao);
+    writer.Key("sequence");
+    writer.Uint64(sequence);
+    writer.Key("inbounds");
+    writer.StartArray();
+    for (auto inbound : arrivals) {
+        writeArrivalObject(writer, *inbound, DELTA_STREAM_FIELDS, true, true);
+    }
+    writer.EndArray();
+    writer.EndObject();
+    arrivalsSnapshotBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeArrivalsDelta(const std::string& airportIcao, const ArrivalsDelta& delta, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "arrivalsDelta");
+    writeStringMember(writer, "icao", airportIcao);
+    writer.Key("sequence");
+    writer.Uint64(delta.sequence);
+
+    writer.Key("added");
+    writer.StartArray();
+    for (auto inbound : delta.added) {
+        writeArrivalObject(writer, *inbound, DELTA_STREAM_FIELDS, true, true);
+    }
+    writer.EndArray();
+
+    // Callsign plus only the fields that changed since the previous sequence number
+    writer.Key("updated");
+    writer.StartArray();
+    for (auto& update : delta.updated) {
+        writeArrivalObject(writer, *update.aircraft, update.changedFields, false, true);
+    }
+    writer.EndArray();
+
+    writer.Key("removed");
+    writer.StartArray();
+    for (auto& callsign : delta.removed) {
+        writeString(writer, callsign);
+    }
+    writer.EndArray();
+
+    writer.EndObject();
+    arrivalsDeltaBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeFixDictionary(const FixDictionary& dictionary, uint32_t firstId, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "fixDictionary");
+    writer.Key("firstId");
+    writer.Uint(firstId);
+    writer.Key("fixes");
+    writer.StartArray();
+    for (uint32_t id = firstId; id < dictionary.size(); id++) {
+        auto& entry = dictionary.at(id);
+        writer.StartObject();
+        writeStringMember(writer, "name", entry.name);
+        writer.Key("latitude");
+        writer.Double(entry.latitude);
+        writer.Key("longitude");
+        writer.Double(entry.longitude);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    fixDictionaryBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeRunwayStatuses(const std::vector<RunwayStatus>& runways, std::string& out) {
+    // Group by airport ICAO, then runway ID, both in sorted order. A runway listed twice keeps its last status.
+    std::vector<const RunwayStatus*> sortedRunways;
+    sortedRunways.reserve(runways.size());
     for (const auto& rs : runways) {
-        airportRunwayMap[rs.airportIcao][rs.runway]["arrivals"] = rs.isActiveForArrivals;
-        airportRunwayMap[rs.airportIcao][rs.runway]["departures"] = rs.isActiveForDepartures;
-    }   
-
-    // Convert the nested map to RapidJSON structure
-    for (const auto& airportPair : airportRunwayMap) {
-        Value runwaysObj(kObjectType);
-        
-        for (const auto& runwayPair : airportPair.second) {
-            Value statusObj(kObjectType);
-            
-            for (const auto& statusPair : runwayPair.second) {
-                statusObj.AddMember(Value(statusPair.first, allocator).Move(), statusPair.second, allocator);
-            }
-            
-            runwaysObj.AddMember(Value(runwayPair.first, allocator).Move(), statusObj, allocator);
-        }
-        
-        airportsObj.AddMember(Value(airportPair.first, allocator).Move(), runwaysObj, allocator);
+        sortedRunways.push_back(&rs);
     }
+    std::stable_sort(sortedRunways.begin(), sortedRunways.end(), [](const RunwayStatus* a, const RunwayStatus* b) {
+        if (a->airportIcao != b->airportIcao) {
+            return a->airportIcao < b->airportIcao;
+        }
+        return a->runway < b->runway;
+    });
 
-    document.AddMember("type", "runwayStatuses", allocator);
-    document.AddMember("airports", airportsObj, allocator);
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
 
-    StringBuffer sb;
-    Writer<StringBuffer> writer(sb);
-    document.Accept(writer);
+    writer.StartObject();
+    writeStringMember(writer, "type", "runwayStatuses");
+    writer.Key("airports");
+    writer.StartObject();
+
+    for (size_t i = 0; i < sortedRunways.size(); i++) {
+        const RunwayStatus& rs = *sortedRunways[i];
+        bool firstOfAirport = i == 0 || sortedRunways[i - 1]->airportIcao != rs.airportIcao;
+        bool lastOfAirport = i + 1 == sortedRunways.size() || sortedRunways[i + 1]->airportIcao != rs.airportIcao;
+
+        if (firstOfAirport) {
+            writer.Key(rs.airportIcao.data(), (SizeType)rs.airportIcao.size());
+            writer.StartObject();
+        }
+
+        // Airport -> runway ID -> arrivals/departures -> bool
+        if (lastOfAirport || sortedRunways[i + 1]->runway != rs.runway) {
+            writer.Key(rs.runway.data(), (SizeType)rs.runway.size());
+            writer.StartObject();
+            writer.Key("arrivals");
+            writer.Bool(rs.isActiveForArrivals);
+            writer.Key("departures");
+            writer.Bool(rs.isActiveForDepartures);
+            writer.EndObject();
+        }
 
-    return sb.GetString();
+        if (lastOfAirport) {
+            writer.EndObject();
+        }
+    }
+
+    writer.EndObject();
+    writer.EndObject();
+    otherBytes->add(out.size());
 }
 
-const std::string JsonMessageHelper::getJsonOfControllerInfo(const ControllerInfo& controllerInfo) {
-    Document document;
-    document.SetObject();
-    Document::AllocatorType& allocator = document.GetAllocator();
+void JsonMessageHelper::writeControllerInfo(const ControllerInfo& controllerInfo, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
 
-    Value controllerInfoObject(kObjectType);
+    writer.StartObject();
+    writeStringMember(writer, "type", "controllerInfo");
+    writer.Key("me");
+    writer.StartObject();
 
     // callsign
+    writer.Key("callsign");
     if (!controllerInfo.callsign.empty()) {
-        controllerInfoObject.AddMember("callsign", Value(controllerInfo.callsign.c_str(), allocator), allocator);
+        writeString(writer, controllerInfo.callsign);
     } else {
-        controllerInfoObject.AddMember("callsign", Value(kNullType), allocator);
+        writer.Null();
     }
 
     // positionId
+    writer.Key("positionId");
     if (!controllerInfo.positionId.empty()) {
-        controllerInfoObject.AddMember("positionId", Value(controllerInfo.positionId.c_str(), allocator), allocator);
+        writeString(writer, controllerInfo.positionId);
     } else {
-        controllerInfoObject.AddMember("positionId", Value(kNullType), allocator);
+        writer.Null();
     }
 
     // facility
+    writer.Key("facilityType");
     if (controllerInfo.facilityType > 0) {
-        controllerInfoObject.AddMember("facilityType", controllerInfo.facilityType, allocator);
+        writer.Int(controllerInfo.facilityType);
     } else {
-        controllerInfoObject.AddMember("facilityType", Value(kNullType), allocator);
+        writer.Null();
     }
 
-    document.AddMember("type", "controllerInfo", allocator);
-    document.AddMember("me", controllerInfoObject, allocator);
+    writer.EndObject();
+    writer.EndObject();
+    otherBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeDepartures(const std::vector<DmanAircraft>& aircraftList, size_t count, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "departures");
+    writer.Key("outbounds");
+    writer.StartArray();
 
-    StringBuffer sb;
-    Writer<StringBuffer> writer(sb);
-    document.Accept(writer);
-    return sb.GetString();
+    for (size_t i = 0; i < count; i++) {
+        writeDepartureObject(writer, aircraftList[i]);
+    }
+
+    writer.EndArray();
+    writer.EndObject();
+    departuresBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeDeparturesSnapshot(const std::string& airportIcao, uint64_t sequence, const std::vector<DmanAircraft>& aircraftList, size_t count, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "departuresSnapshot");
+    writeStringMember(writer, "icao", airportIcao);
+    writer.Key("sequence");
+    writer.Uint64(sequence);
+    writer.Key("outbounds");
+    writer.StartArray();
+    for (size_t i = 0; i < count; i++) {
+        writeDepartureObject(writer, aircraftList[i]);
+    }
+    writer.EndArray();
+    writer.EndObject();
+    departuresSnapshotBytes->add(out.size());
 }
 
-const std::string JsonMessageHelper::getJsonOfDepartures(const std::vector<DmanAircraft>& aircraftList) {
-    Document document;
-    document.SetObject();
-    Value departuresArray(kArrayType);
+void JsonMessageHelper::writeDeparturesDelta(const std::string& airportIcao, const DeparturesDelta& delta, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
 
-    Document::AllocatorType& allocator = document.GetAllocator();
+    writer.StartObject();
+    writeStringMember(writer, "type", "departuresDelta");
+    writeStringMember(writer, "icao", airportIcao);
+    writer.Key("sequence");
+    writer.Uint64(delta.sequence);
 
-    for (auto& outbound : aircraftList) {
-        Value departureObject(kObjectType);
-        departureObject.AddMember("departureAirportIcao", outbound.departureAirportIcao, allocator);
-        departureObject.AddMember("callsign", outbound.callsign, allocator);
-        departureObject.AddMember("sid", outbound.sid, allocator);
-        departureObject.AddMember("runway", outbound.runway, allocator);
-        departureObject.AddMember("estimatedDepartureTime", outbound.estimatedDepartureTime, allocator);
-        departureObject.AddMember("icaoType", outbound.icaoType, allocator);
-        departureObject.AddMember("wakeCategory", outbound.wakeCategory, allocator);
+    writer.Key("added");
+    writer.StartArray();
+    for (auto outbound : delta.added) {
+        writeDepartureObject(writer, *outbound);
+    }
+    writer.EndArray();
+
+    writer.Key("updated");
+    writer.StartArray();
+    for (auto outbound : delta.updated) {
+        writeDepartureObject(writer, *outbound);
+    }
+    writer.EndArray();
 
-        departuresArray.PushBack(departureObject, allocator);
+    writer.Key("removed");
+    writer.StartArray();
+    for (auto& callsign : delta.removed) {
+        writeString(writer, callsign);
     }
+    writer.EndArray();
 
-    document.AddMember("type", "departures", allocator);
-    document.AddMember("outbounds", departuresArray, allocator);
+    writer.EndObject();
+    departuresDeltaBytes->add(out.size());
+}
 
-    StringBuffer sb;
-    Writer<StringBuffer> writer(sb);
-    document.Accept(writer);
+void JsonMessageHelper::writeCommandResult(const CommandResult& result, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "commandResult");
+    writeStringMember(writer, "requestId", result.requestId);
+    writeStringMember(writer, "command", result.command);
+    writeStringMember(writer, "callsign", result.callsign);
+    writeStringMember(writer, "status", result.status);
+    if (!result.error.empty()) {
+        writeStringMember(writer, "error", result.error);
+    }
+    writer.EndObject();
+    otherBytes->add(out.size());
+}
+
+void JsonMessageHelper::writeBridgeStats(const std::vector<Metrics::Sample>& samples, std::string& out) {
+    StringOutputStream stream(out);
+    JsonWriter writer(stream);
+
+    writer.StartObject();
+    writeStringMember(writer, "type", "bridgeStats");
+    writer.Key("metrics");
+    writer.StartArray();
+
+    for (auto& sample : samples) {
+        writer.StartObject();
+        writeStringMember(writer, "name", sample.name);
+        if (!sample.labels.empty()) {
+            writer.Key("labels");
+            writer.StartObject();
+            for (auto& label : sample.labels) {
+                writer.Key(label.first.data(), (SizeType)label.first.size());
+                writeString(writer, label.second);
+            }
+            writer.EndObject();
+        }
+        if (sample.kind == Metrics::Histogram) {
+            // Microseconds
+            const LatencyHistogram::Summary& summary = sample.summary;
+            writer.Key("count");
+            writer.Uint64(summary.count);
+            writer.Key("sum");
+            writer.Uint64(summary.sumMicros);
+            writer.Key("max");
+            writer.Uint64(summary.maxMicros);
+            writer.Key("p50");
+            writer.Uint64(summary.p50);
+            writer.Key("p90");
+            writer.Uint64(summary.p90);
+            writer.Key("p99");
+            writer.Uint64(summary.p99);
+            writer.Key("p999");
+            writer.Uint64(summary.p999);
+        } else {
+            writer.Key("value");
+            writer.Int64(sample.value);
+        }
+        writer.EndObject();
+    }
 
-    return sb.GetString();
+    writer.EndArray();
+    writer.EndObject();
+    otherBytes->add(out.size());
 }
@@ -4,13 +4,50 @@
 #include <vector>
 
 #include "AmanDataTypes.h"
+#include "ArrivalsDelta.h"
+#include "DeparturesDelta.h"
+#include "FixDictionary.h"
+#include "Metrics.h"
 
+// Serializes outgoing messages by streaming writer events straight from the data types,
+// without building a DOM first. Each message is written into `out`, replacing its contents;
+// callers keep one buffer around so its capacity is reused from tick to tick.
 class JsonMessageHelper {
 public:
-    const std::string getJsonOfPluginVersion(const std::string& version);
-    const std::string getJsonOfArrivals(const std::vector<AmanAircraft>& aircraftList);
-    const std::string getJsonOfDepartures(const std::vector<DmanAircraft>& aircraftList);
-    const std::string getJsonOfRunwayStatuses(const std::vector<RunwayStatus>& runways);
-    const std::string getJsonOfControllerInfo(const ControllerInfo& controllerInfo);
-};
+    JsonMessageHelper();
+
+    void writePluginVersion(const std::string& version, std::string& out);
+    void writeCodecSelected(const std::string& codec, std::string& out);
+    // One element of "inbounds"; arrivals lists are assembled from these without re-serializing them
+    void writeArrival(const AmanAircraft& inbound, std::string& out);
+    // The same element in CBOR, for the arrivals sent to clients using that codec (see WireCodec.h)
+    void writeArrivalCbor(const AmanAircraft& inbound, std::string& out);
+    void writeArrivals(const std::vector<const std::string*>& arrivalsJson, std::string& out);
+    // The same message with only some ArrivalField members, for subscriptions that asked for fewer
+    void writeArrivals(const std::vector<const AmanAircraft*>& arrivals, uint32_t fields, std::string& out);
+    // Baseline and increments of the opt-in arrivals delta stream, with routes as fix ids
+    void writeArrivalsSnapshot(const std::string& airportIcao, uint64_t sequence, const std::vector<const AmanAircraft*>& arrivals, std::string& out);
+    void writeArrivalsDelta(const std::string& airportIcao, const ArrivalsDelta& delta, std::string& out);
+    // Dictionary entries from `firstId` on, for clients that have the ones before it
+    void writeFixDictionary(const FixDictionary& dictionary, uint32_t firstId, std::string& out);
+    // The first `count` of the list
+    void writeDepartures(const std::vector<DmanAircraft>& aircraftList, size_t count, std::string& out);
+    // Baseline and increments of the opt-in departures delta stream
+    void writeDeparturesSnapshot(const std::string& airportIcao, uint64_t sequence, const std::vector<DmanAircraft>& aircraftList, size_t count, std::string& out);
+    void writeDeparturesDelta(const std::string& airportIcao, const DeparturesDelta& delta, std::string& out);
+    void writeRunwayStatuses(const std::vector<RunwayStatus>& runways, std::string& out);
+    void writeControllerInfo(const ControllerInfo& controllerInfo, std::string& out);
+    void writeCommandResult(const CommandResult& result, std::string& out);
+    void writeBridgeStats(const std::vector<Metrics::Sample>& samples, std::string& out);
 
+private:
+    // aman_serialized_bytes_total by message type, looked up once
+    MetricCounter* arrivalsBytes;
+    MetricCounter* arrivalsSnapshotBytes;
+    MetricCounter* arrivalsDeltaBytes;
+    MetricCounter* fixDictionaryBytes;
+    MetricCounter* departuresBytes;
+    MetricCounter* departuresSnapshotBytes;
+    MetricCounter* departuresDeltaBytes;
+    MetricCounter* otherBytes;
+};
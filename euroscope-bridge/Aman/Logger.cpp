@@ -0,0 +1,245 @@
+#include "stdafx.h"
+#include "Logger.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <iostream>
+#endif
+
+namespace {
+
+// Lines waiting for the writer thread; a power of two
+const size_t QUEUE_SLOTS = 4096;
+// How long the writer sleeps when the queue is empty; errors wake it right away
+const int WRITER_IDLE_MS = 50;
+const size_t MAX_FILE_BYTES = 5 * 1024 * 1024;
+const int KEPT_FILES = 3;
+
+struct Slot {
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    const char* sourceFile;
+    std::chrono::system_clock::time_point time;
+    LogLine line;
+};
+
+// Bounded multi-producer queue (Vyukov): a slot's sequence says whether it is free for the
+// producer claiming position `sequence` or filled for the consumer at `sequence - 1`
+class LogQueue {
+public:
+    LogQueue() : slots(QUEUE_SLOTS), enqueuePosition(0), dequeuePosition(0), dropped(0) {
+        for (size_t i = 0; i < QUEUE_SLOTS; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(LogLevel level, const char* sourceFile, const LogLine& line) {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position & (QUEUE_SLOTS - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->level = level;
+        slot->sourceFile = sourceFile;
+        slot->time = std::chrono::system_clock::now();
+        slot->line = line;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Single consumer
+    Slot* front() {
+        Slot* slot = &slots[dequeuePosition & (QUEUE_SLOTS - 1)];
+        return slot->sequence.load(std::memory_order_acquire) == dequeuePosition + 1 ? slot : nullptr;
+    }
+
+    void pop(Slot* slot) {
+        slot->sequence.store(dequeuePosition + QUEUE_SLOTS, std::memory_order_release);
+        dequeuePosition++;
+    }
+
+    uint64_t takeDropped() { return dropped.exchange(0, std::memory_order_relaxed); }
+
+private:
+    std::vector<Slot> slots;
+    std::atomic<size_t> enqueuePosition;
+    size_t dequeuePosition;
+    std::atomic<uint64_t> dropped;
+};
+
+LogQueue queue;
+
+std::mutex writerMutex;
+std::condition_variable writerWake;
+bool writerStopping = false;        // Guarded by writerMutex
+// An error was queued since the writer last woke; set under writerMutex so the wake is not lost
+std::atomic<bool> errorPending(false);
+std::thread writerThread;
+
+// Writer thread only
+std::ofstream file;
+std::string filePath;
+size_t fileBytes = 0;
+std::string text;
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+    case LogDebug: return "DEBUG";
+    case LogInfo: return "INFO ";
+    case LogWarning: return "WARN ";
+    default: return "ERROR";
+    }
+}
+
+// "C:\...\AmanServer.cpp" -> "AmanServer"
+void appendComponent(std::string& out, const char* sourceFile) {
+    const char* name = sourceFile;
+    for (const char* p = sourceFile; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            name = p + 1;
+        }
+    }
+    const char* extension = strrchr(name, '.');
+    out.append(name, extension ? (size_t)(extension - name) : strlen(name));
+}
+
+void appendTimestamp(std::string& out, std::chrono::system_clock::time_point time) {
+    time_t seconds = std::chrono::system_clock::to_time_t(time);
+    int millis = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() % 1000);
+    struct tm tm {};
+    gmtime_s(&tm, &seconds);
+    char buffer[40];
+    size_t length = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+    length += snprintf(buffer + length, sizeof(buffer) - length, ".%03d", millis);
+    out.append(buffer, length);
+}
+
+void rollFiles() {
+    file.close();
+    std::remove((filePath + "." + std::to_string(KEPT_FILES)).c_str());
+    for (int i = KEPT_FILES - 1; i >= 1; i--) {
+        std::rename((filePath + "." + std::to_string(i)).c_str(), (filePath + "." + std::to_string(i + 1)).c_str());
+    }
+    std::rename(filePath.c_str(), (filePath + ".1").c_str());
+    file.open(filePath, std::ios::binary | std::ios::trunc);
+    fileBytes = 0;
+}
+
+void writeText() {
+    if (text.empty()) {
+        return;
+    }
+#ifdef _WIN32
+    OutputDebugStringA(text.c_str());
+#else
+    std::cerr << text;
+#endif
+    if (file.is_open()) {
+        if (fileBytes + text.size() > MAX_FILE_BYTES) {
+            rollFiles();
+        }
+        file.write(text.data(), text.size());
+        file.flush();
+        fileBytes += text.size();
+    }
+    text.clear();
+}
+
+// Formats everything queued into `text`
+void drainQueue() {
+    uint64_t dropped = queue.takeDropped();
+    if (dropped > 0) {
+        appendTimestamp(text, std::chrono::system_clock::now());
+        text += " WARN  [Logger] " + std::to_string(dropped) + " log line(s) dropped, the queue was full\n";
+    }
+    while (Slot* slot = queue.front()) {
+        appendTimestamp(text, slot->time);
+        text += ' ';
+        text += levelName(slot->level);
+        text += " [";
+        appendComponent(text, slot->sourceFile);
+        text += "] ";
+        text.append(slot->line.data(), slot->line.size());
+        text += '\n';
+        queue.pop(slot);
+    }
+}
+
+void writerLoop() {
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(writerMutex);
+            writerWake.wait_for(lock, std::chrono::milliseconds(WRITER_IDLE_MS), [] { return writerStopping || errorPending; });
+            stopping = writerStopping;
+            errorPending = false;
+        }
+        drainQueue();
+        writeText();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+}
+
+std::atomic<int> Logger::minimumLevel(LogInfo);
+
+void Logger::start(const std::string& path) {
+    if (writerThread.joinable()) {
+        return;
+    }
+    filePath = path;
+    file.open(filePath, std::ios::binary | std::ios::app);
+    file.seekp(0, std::ios::end);
+    fileBytes = file.is_open() ? (size_t)file.tellp() : 0;
+    writerStopping = false;
+    writerThread = std::thread(writerLoop);
+}
+
+void Logger::stop() {
+    if (!writerThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerStopping = true;
+    }
+    writerWake.notify_one();
+    writerThread.join();
+    file.close();
+}
+
+void Logger::enqueue(LogLevel level, const char* sourceFile, const LogLine& line) {
+    queue.push(level, sourceFile, line);
+    if (level >= LogError) {
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            errorPending = true;
+        }
+        writerWake.notify_one();
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logging for the plugin. A log statement filters on its level, formats its arguments
+// into a fixed-size line without allocating and hands it to a lock-free queue; a background thread
+// writes the lines to a rolling file (and the debugger output / stderr). When the queue is full
+// lines are dropped and counted rather than blocking the caller.
+//
+//   LOG_INFO("Client ", clientId, " connected, ", count, " client(s) in total");
+//
+// Statements below AMAN_LOG_MIN_LEVEL are compiled out, arguments included. The others cost a
+// relaxed atomic load when below the runtime level. Each statement logs at most
+// LOG_LINES_PER_SECOND lines a second; the number it suppressed is added to its next line.
+
+enum LogLevel {
+    LogDebug = 0,
+    LogInfo = 1,
+    LogWarning = 2,
+    LogError = 3
+};
+
+#ifndef AMAN_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define AMAN_LOG_MIN_LEVEL LogInfo
+#else
+#define AMAN_LOG_MIN_LEVEL LogDebug
+#endif
+#endif
+
+const int LOG_LINES_PER_SECOND = 20;
+const size_t LOG_LINE_LENGTH = 240;
+
+// One formatted message, truncated to LOG_LINE_LENGTH
+class LogLine {
+public:
+    LogLine() : length(0) {}
+
+    void append(const char* value, size_t valueLength) {
+        size_t room = LOG_LINE_LENGTH - length;
+        if (valueLength > room) {
+            valueLength = room;
+        }
+        memcpy(text + length, value, valueLength);
+        length += valueLength;
+    }
+
+    void append(const char* value) { append(value, strlen(value)); }
+    void append(const std::string& value) { append(value.data(), value.size()); }
+    void append(std::string_view value) { append(value.data(), value.size()); }
+    void append(char value) { append(&value, 1); }
+    void append(bool value) { append(value ? "true" : "false"); }
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type append(T value) {
+        char number[32];
+        int numberLength;
+        if (std::is_floating_point<T>::value) {
+            numberLength = snprintf(number, sizeof(number), "%g", (double)value);
+        } else if (std::is_signed<T>::value) {
+            numberLength = snprintf(number, sizeof(number), "%lld", (long long)value);
+        } else {
+            numberLength = snprintf(number, sizeof(number), "%llu", (unsigned long long)value);
+        }
+        append(number, (size_t)numberLength);
+    }
+
+    const char* data() const { return text; }
+    size_t size() const { return length; }
+
+private:
+    char text[LOG_LINE_LENGTH];
+    size_t length;
+};
+
+// Per call site limit on lines per second
+class LogRateLimit {
+public:
+    constexpr LogRateLimit() : second(-1), count(0), suppressed(0) {}
+
+    // `suppressedBefore` is how many lines were dropped since the last one allowed
+    bool allow(int& suppressedBefore) {
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t current = second.load(std::memory_order_relaxed);
+        if (current != now && second.compare_exchange_strong(current, now, std::memory_order_relaxed)) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        if (count.fetch_add(1, std::memory_order_relaxed) >= LOG_LINES_PER_SECOND) {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressedBefore = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    std::atomic<int64_t> second;
+    std::atomic<int> count;
+    std::atomic<int> suppressed;
+};
+
+class Logger {
+public:
+    // Starts writing to `path`, including whatever was logged before. Older files are kept as
+    // path.1, path.2, ... once the file grows past its size limit.
+    static void start(const std::string& path);
+    // Writes out what is still queued and closes the file
+    static void stop();
+
+    static void setLevel(LogLevel level) { minimumLevel.store(level, std::memory_order_relaxed); }
+    static bool isEnabled(LogLevel level) { return level >= minimumLevel.load(std::memory_order_relaxed); }
+
+    template<typename... Args>
+    static void write(LogLevel level, const char* sourceFile, int suppressedBefore, const Args&... args) {
+        LogLine line;
+        int expand[] = { 0, (line.append(args), 0)... };
+        (void)expand;
+        if (suppressedBefore > 0) {
+            line.append(" (");
+            line.append(suppressedBefore);
+            line.append(" similar suppressed)");
+        }
+        enqueue(level, sourceFile, line);
+    }
+
+private:
+    static void enqueue(LogLevel level, const char* sourceFile, const LogLine& line);
+
+    static std::atomic<int> minimumLevel;
+};
+
+#define AMAN_LOG(level, ...)                                                                                           \
+    do {                                                                                                               \
+        if ((level) >= AMAN_LOG_MIN_LEVEL && Logger::isEnabled(level)) {                                               \
+            static LogRateLimit logRateLimit;                                                                          \
+            int logSuppressed = 0;                                                                                     \
+            if (logRateLimit.allow(logSuppressed)) {                                                                   \
+                Logger::write(level, __FILE__, logSuppressed, __VA_ARGS__);                                            \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+#define LOG_DEBUG(...) AMAN_LOG(LogDebug, __VA_ARGS__)
+#define LOG_INFO(...) AMAN_LOG(LogInfo, __VA_ARGS__)
+#define LOG_WARNING(...) AMAN_LOG(LogWarning, __VA_ARGS__)
+#define LOG_ERROR(...) AMAN_LOG(LogError, __VA_ARGS__)
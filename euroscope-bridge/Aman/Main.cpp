@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "AmanPlugIn.h"
+#include "Logger.h"
 
 AmanPlugIn* gpAmanPlugin = NULL;
 
@@ -13,4 +14,6 @@ void __declspec(dllexport) EuroScopePlugInInit(EuroScopePlugIn::CPlugIn** ppPlug
 
 void __declspec(dllexport) EuroScopePlugInExit(void) {
     delete gpAmanPlugin;
+    // After the plugin, so the server's shutdown is logged too
+    Logger::stop();
 }
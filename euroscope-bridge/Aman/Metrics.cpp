@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "Metrics.h"
+
+namespace {
+
+// name="value",other="value"
+std::string formatLabels(const MetricLabels& labels) {
+    std::string formatted;
+    for (auto& label : labels) {
+        if (!formatted.empty()) {
+            formatted += ',';
+        }
+        formatted += label.first;
+        formatted += "=\"";
+        for (char c : label.second) {
+            if (c == '\\' || c == '"') {
+                formatted += '\\';
+            } else if (c == '\n') {
+                formatted += "\\n";
+                continue;
+            }
+            formatted += c;
+        }
+        formatted += '"';
+    }
+    return formatted;
+}
+
+void appendSeriesName(std::string& out, const std::string& name, const std::string& labels, const char* extraLabel = nullptr) {
+    out += name;
+    if (!labels.empty() || extraLabel) {
+        out += '{';
+        out += labels;
+        if (extraLabel) {
+            if (!labels.empty()) {
+                out += ',';
+            }
+            out += extraLabel;
+        }
+        out += '}';
+    }
+    out += ' ';
+}
+
+}
+
+bool Metrics::hasStorage(const Series& series, Kind kind) {
+    return kind == Counter ? (bool)series.counter : kind == Gauge ? (bool)series.gauge : (bool)series.histogram;
+}
+
+std::mutex Metrics::mutex;
+std::map<std::string, Metrics::Family> Metrics::families;
+
+void LatencyHistogram::record(uint64_t micros) {
+    buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add(micros, std::memory_order_relaxed);
+    uint64_t currentMax = maxMicros.load(std::memory_order_relaxed);
+    while (micros > currentMax && !maxMicros.compare_exchange_weak(currentMax, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration duration) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    record(micros > 0 ? (uint64_t)micros : 0);
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t micros) {
+    // Values below two sub-bucket ranges get a bucket each
+    if (micros < 2 * SUB_BUCKETS) {
+        return (size_t)micros;
+    }
+    int highestBit = 63;
+    while ((micros >> highestBit) == 0) {
+        highestBit--;
+    }
+    if (highestBit > MAX_VALUE_BITS) {
+        return BUCKET_COUNT - 1;
+    }
+    int shift = highestBit - SUB_BUCKET_BITS;
+    return (size_t)(shift + 1) * SUB_BUCKETS + (size_t)((micros >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+    int shift = (int)(index / SUB_BUCKETS) - 1;
+    uint64_t subBucket = index % SUB_BUCKETS + SUB_BUCKETS;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+LatencyHistogram::Summary LatencyHistogram::summarize() const {
+    Summary summary;
+    uint64_t counts[BUCKET_COUNT];
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    summary.sumMicros = sumMicros.load(std::memory_order_relaxed);
+    summary.maxMicros = maxMicros.load(std::memory_order_relaxed);
+    if (summary.count == 0) {
+        return summary;
+    }
+
+    struct Quantile {
+        double fraction;
+        uint64_t* value;
+    };
+    Quantile quantiles[] = { { 0.5, &summary.p50 }, { 0.9, &summary.p90 }, { 0.99, &summary.p99 }, { 0.999, &summary.p999 } };
+    uint64_t seen = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < BUCKET_COUNT && next < 4; i++) {
+        seen += counts[i];
+        while (next < 4 && seen >= (uint64_t)(quantiles[next].fraction * summary.count + 0.5) && seen > 0) {
+            uint64_t bound = bucketUpperBound(i);
+            *quantiles[next].value = bound < summary.maxMicros ? bound : summary.maxMicros;
+            next++;
+        }
+    }
+    return summary;
+}
+
+Metrics::Series& Metrics::findSeries(const std::string& name, Kind kind, const char* help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto family = families.find(name);
+    if (family == families.end()) {
+        family = families.emplace(name, Family{ kind, help, {} }).first;
+    }
+
+    Series& series = family->second.series[formatLabels(labels)];
+    if (series.labels.empty()) {
+        series.labels = labels;
+    }
+    // Storage of the kind asked for, so a name reused with another kind still works
+    if (kind == Counter && !series.counter) {
+        series.counter.reset(new MetricCounter());
+    } else if (kind == Gauge && !series.gauge) {
+        series.gauge.reset(new MetricGauge());
+    } else if (kind == Histogram && !series.histogram) {
+        series.histogram.reset(new LatencyHistogram());
+    }
+    return series;
+}
+
+MetricCounter& Metrics::counter(const std::string& name, const char* help, const MetricLabels& labels) {
+    return *findSeries(name, Counter, help, labels).counter;
+}
+
+MetricGauge& Metrics::gauge(const std::string& name, const char* help, const MetricLabels& labels) {
+    return *findSeries(name, Gauge, help, labels).gauge;
+}
+
+LatencyHistogram& Metrics::histogram(const std::string& name, const char* help, const MetricLabels& labels) {
+    return *findSeries(name, Histogram, help, labels).histogram;
+}
+
+std::vector<Metrics::Sample> Metrics::sample() {
+    std::vector<Sample> samples;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& family : families) {
+        for (auto& entry : family.second.series) {
+            const Series& series = entry.second;
+            if (!hasStorage(series, family.second.kind)) {
+                continue;
+            }
+            Sample sample;
+            sample.name = family.first;
+            sample.labels = series.labels;
+            sample.kind = family.second.kind;
+            sample.value = 0;
+            if (sample.kind == Counter) {
+                sample.value = (int64_t)series.counter->get();
+            } else if (sample.kind == Gauge) {
+                sample.value = series.gauge->get();
+            } else {
+                sample.summary = series.histogram->summarize();
+            }
+            samples.push_back(sample);
+        }
+    }
+    return samples;
+}
+
+void Metrics::writePrometheus(std::string& out) {
+    out.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& family : families) {
+        const std::string& name = family.first;
+        Kind kind = family.second.kind;
+        out += "# HELP " + name + " " + family.second.help + "\n";
+        out += "# TYPE " + name + (kind == Counter ? " counter\n" : kind == Gauge ? " gauge\n" : " summary\n");
+
+        for (auto& entry : family.second.series) {
+            const std::string& labels = entry.first;
+            const Series& series = entry.second;
+            if (!hasStorage(series, kind)) {
+                continue;
+            }
+            if (kind == Counter) {
+                appendSeriesName(out, name, labels);
+                out += std::to_string(series.counter->get()) + "\n";
+            } else if (kind == Gauge) {
+                appendSeriesName(out, name, labels);
+                out += std::to_string(series.gauge->get()) + "\n";
+            } else {
+                auto summary = series.histogram->summarize();
+                std::pair<const char*, uint64_t> quantiles[] = {
+                    { "quantile=\"0.5\"", summary.p50 }, { "quantile=\"0.9\"", summary.p90 },
+                    { "quantile=\"0.99\"", summary.p99 }, { "quantile=\"0.999\"", summary.p999 }
+                };
+                for (auto& quantile : quantiles) {
+                    appendSeriesName(out, name, labels, quantile.first);
+                    out += std::to_string(quantile.second) + "\n";
+                }
+                appendSeriesName(out, name + "_sum", labels);
+                out += std::to_string(summary.sumMicros) + "\n";
+                appendSeriesName(out, name + "_count", labels);
+                out += std::to_string(summary.count) + "\n";
+            }
+        }
+    }
+}
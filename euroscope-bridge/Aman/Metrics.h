@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Numbers describing the bridge, updated from any thread with relaxed atomics and read by the
+// bridgeStats message and the Prometheus endpoint. Metrics are created on first use and live as
+// long as the process, so a reference to one can be kept where it is updated often.
+
+class MetricCounter {
+public:
+    void add(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    // For totals kept elsewhere, such as the send queue statistics
+    void set(uint64_t total) { value.store(total, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{ 0 };
+};
+
+class MetricGauge {
+public:
+    void set(int64_t current) { value.store(current, std::memory_order_relaxed); }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value{ 0 };
+};
+
+// Latencies in microseconds, in log-linear buckets like an HDR histogram: 16 buckets per power of
+// two, so quantiles are within about 6% of the recorded values, up to about 9 hours
+class LatencyHistogram {
+public:
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t sumMicros = 0;
+        uint64_t maxMicros = 0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+    };
+
+    void record(uint64_t micros);
+    void record(std::chrono::steady_clock::duration duration);
+    Summary summarize() const;
+
+private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_VALUE_BITS = 35;
+    static const size_t BUCKET_COUNT = (size_t)(MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    static size_t bucketIndex(uint64_t micros);
+    // Largest value that lands in the bucket
+    static uint64_t bucketUpperBound(size_t index);
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> sumMicros{ 0 };
+    std::atomic<uint64_t> maxMicros{ 0 };
+};
+
+// Times a scope into a histogram
+class ScopedLatency {
+public:
+    explicit ScopedLatency(LatencyHistogram& histogram) : histogram(histogram), startTime(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() { histogram.record(std::chrono::steady_clock::now() - startTime); }
+
+    ScopedLatency(const ScopedLatency&) = delete;
+    ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+private:
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+class Metrics {
+public:
+    enum Kind {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    // One series, as read for bridgeStats
+    struct Sample {
+        std::string name;
+        MetricLabels labels;
+        Kind kind;
+        int64_t value;                      // Counter, Gauge
+        LatencyHistogram::Summary summary;  // Histogram
+    };
+
+    // Series of a family are told apart by their labels. `help` is taken from the first call.
+    static MetricCounter& counter(const std::string& name, const char* help, const MetricLabels& labels = MetricLabels());
+    static MetricGauge& gauge(const std::string& name, const char* help, const MetricLabels& labels = MetricLabels());
+    static LatencyHistogram& histogram(const std::string& name, const char* help, const MetricLabels& labels = MetricLabels());
+
+    static std::vector<Sample> sample();
+    // Text exposition format 0.0.4; histograms are written as summaries with quantiles
+    static void writePrometheus(std::string& out);
+
+private:
+    struct Series {
+        MetricLabels labels;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<LatencyHistogram> histogram;
+    };
+
+    struct Family {
+        Kind kind;
+        std::string help;
+        std::map<std::string, Series> series;  // By formatted labels
+    };
+
+    static bool hasStorage(const Series& series, Kind kind);
+    static Series& findSeries(const std::string& name, Kind kind, const char* help, const MetricLabels& labels);
+
+    static std::mutex mutex;
+    static std::map<std::string, Family> families;
+};
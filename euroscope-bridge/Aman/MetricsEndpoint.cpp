@@ -0,0 +1,245 @@
+#include "stdafx.h"
+#include "MetricsEndpoint.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "Tracing.h"
+
+#include <cstring>
+
+namespace {
+
+// Scrapers send a short GET; anything bigger is not one of them
+const size_t MAX_REQUEST_BYTES = 8192;
+const size_t MAX_CONNECTIONS = 16;
+// A scraper sends its request right after connecting; connections that don't cannot be
+// allowed to hold one of the MAX_CONNECTIONS slots for good
+const int REQUEST_TIMEOUT_MS = 5000;
+
+}
+
+MetricsEndpoint::MetricsEndpoint() : running(false), port(0), listenSocket(INVALID_SOCKET) {
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+    stop();
+}
+
+bool MetricsEndpoint::start(int port) {
+    if (running) {
+        return false;
+    }
+    if (!socketStartup()) {
+        LOG_ERROR("Socket startup failed: ", socketLastError());
+        return false;
+    }
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == INVALID_SOCKET) {
+        LOG_ERROR("Error creating metrics socket");
+        socketCleanup();
+        return false;
+    }
+
+#ifndef _WIN32
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+    // Only reachable from this machine
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+
+    if (bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) == SOCKET_ERROR
+        || listen(listenSocket, SOMAXCONN) == SOCKET_ERROR
+        || !setSocketNonBlocking(listenSocket)
+        || !poller.open()) {
+        LOG_ERROR("Metrics endpoint cannot listen on port ", port, ": ", socketLastError());
+        closeSocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+        poller.close();
+        socketCleanup();
+        return false;
+    }
+    poller.add(listenSocket, SocketPoller::Readable);
+
+    this->port = port;
+    running = true;
+    thread = std::thread(&MetricsEndpoint::serveLoop, this);
+    LOG_INFO("Metrics endpoint listening on 127.0.0.1:", port);
+    return true;
+}
+
+void MetricsEndpoint::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    poller.wake();
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    for (auto& connection : connections) {
+        closeSocket(connection.socket);
+    }
+    connections.clear();
+    closeSocket(listenSocket);
+    listenSocket = INVALID_SOCKET;
+    poller.close();
+    socketCleanup();
+}
+
+void MetricsEndpoint::serveLoop() {
+    Tracing::setThreadName("MetricsEndpoint");
+    std::vector<SocketPoller::Event> events;
+
+    while (running) {
+        if (poller.wait(events, closeIdleConnections()) < 0) {
+            LOG_ERROR("Metrics endpoint poll failed with error: ", socketLastError());
+            break;
+        }
+        if (!running) {
+            break;
+        }
+
+        for (auto& event : events) {
+            if (event.socket == listenSocket) {
+                acceptConnections();
+                continue;
+            }
+
+            for (size_t i = 0; i < connections.size(); i++) {
+                Connection& connection = connections[i];
+                if (connection.socket != event.socket) {
+                    continue;
+                }
+                bool open = connection.response.empty() ? readRequest(connection) : writeResponse(connection);
+                if (!open) {
+                    closeConnection(i);
+                }
+                break;
+            }
+        }
+    }
+}
+
+int MetricsEndpoint::closeIdleConnections() {
+    auto now = std::chrono::steady_clock::now();
+    auto timeout = std::chrono::milliseconds(REQUEST_TIMEOUT_MS);
+    int waitMs = -1;
+    for (size_t i = 0; i < connections.size();) {
+        Connection& connection = connections[i];
+        // Responses are not timed out, they are being written
+        if (!connection.response.empty()) {
+            i++;
+            continue;
+        }
+        auto idle = now - connection.acceptedAt;
+        if (idle >= timeout) {
+            closeConnection(i);
+            continue;
+        }
+        // Rounded up, so the poller does not wake just before the deadline
+        int remainingMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(timeout - idle).count() + 1;
+        if (waitMs < 0 || remainingMs < waitMs) {
+            waitMs = remainingMs;
+        }
+        i++;
+    }
+    return waitMs;
+}
+
+void MetricsEndpoint::closeConnection(size_t index) {
+    poller.remove(connections[index].socket);
+    closeSocket(connections[index].socket);
+    connections.erase(connections.begin() + index);
+}
+
+void MetricsEndpoint::acceptConnections() {
+    for (;;) {
+        SOCKET clientSocket = accept(listenSocket, nullptr, nullptr);
+        if (clientSocket == INVALID_SOCKET) {
+            return;
+        }
+        if (connections.size() >= MAX_CONNECTIONS || !setSocketNonBlocking(clientSocket)) {
+            closeSocket(clientSocket);
+            continue;
+        }
+        Connection connection;
+        connection.socket = clientSocket;
+        connection.acceptedAt = std::chrono::steady_clock::now();
+        connections.push_back(std::move(connection));
+        poller.add(clientSocket, SocketPoller::Readable);
+    }
+}
+
+bool MetricsEndpoint::readRequest(Connection& connection) {
+    char buffer[1024];
+    for (;;) {
+        int received = recv(connection.socket, buffer, sizeof(buffer), 0);
+        if (received == 0) {
+            return false;
+        }
+        if (received < 0) {
+            if (!socketWouldBlock(socketLastError())) {
+                return false;
+            }
+            break;
+        }
+        connection.request.append(buffer, received);
+        if (connection.request.size() > MAX_REQUEST_BYTES) {
+            return false;
+        }
+    }
+
+    // The body of a GET is ignored, the headers are all that is needed
+    if (connection.request.find("\r\n\r\n") == std::string::npos) {
+        return true;
+    }
+    buildResponse(connection);
+    poller.modify(connection.socket, SocketPoller::Writable);
+    return writeResponse(connection);
+}
+
+bool MetricsEndpoint::writeResponse(Connection& connection) {
+    while (connection.sent < connection.response.size()) {
+        int sent = send(connection.socket, connection.response.data() + connection.sent,
+            (int)(connection.response.size() - connection.sent), SOCKET_SEND_FLAGS);
+        if (sent == SOCKET_ERROR) {
+            // Wait for the poller to report the socket writable again
+            return socketWouldBlock(socketLastError());
+        }
+        connection.sent += sent;
+    }
+    return false;
+}
+
+void MetricsEndpoint::buildResponse(Connection& connection) {
+    const std::string& request = connection.request;
+    bool isGet = request.compare(0, 4, "GET ") == 0;
+    size_t pathEnd = request.find(' ', 4);
+    std::string path = isGet && pathEnd != std::string::npos ? request.substr(4, pathEnd - 4) : "";
+
+    std::string status;
+    std::string body;
+    const char* contentType = "text/plain; charset=utf-8";
+    if (!isGet) {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported\n";
+    } else if (path == "/metrics" || path.compare(0, 9, "/metrics?") == 0) {
+        status = "200 OK";
+        contentType = "text/plain; version=0.0.4; charset=utf-8";
+        Metrics::writePrometheus(body);
+    } else {
+        status = "404 Not Found";
+        body = "Metrics are at /metrics\n";
+    }
+
+    connection.response = "HTTP/1.1 " + status + "\r\n"
+        + "Content-Type: " + contentType + "\r\n"
+        + "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        + "Connection: close\r\n\r\n"
+        + body;
+}
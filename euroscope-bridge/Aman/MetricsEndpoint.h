@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SocketLayer.h"
+
+// Serves Metrics::writePrometheus() at http://127.0.0.1:<port>/metrics for a local Prometheus or
+// curl. It runs on its own thread with its own poller, so a slow scrape never holds up the
+// client connections. Each request gets one response, then the connection is closed.
+class MetricsEndpoint {
+public:
+    static const int DEFAULT_PORT = 9464;
+
+    MetricsEndpoint();
+    ~MetricsEndpoint();
+
+    bool start(int port);
+    void stop();
+    bool isRunning() const { return running; }
+    int getPort() const { return port; }
+
+private:
+    struct Connection {
+        SOCKET socket;
+        std::chrono::steady_clock::time_point acceptedAt;
+        std::string request;
+        std::string response;
+        size_t sent = 0;
+    };
+
+    void serveLoop();
+    void acceptConnections();
+    // Closes connections that did not send a complete request in time; returns the poll timeout
+    // until the next one would expire, or -1 when no request is outstanding
+    int closeIdleConnections();
+    void closeConnection(size_t index);
+    // False once the connection is done with
+    bool readRequest(Connection& connection);
+    bool writeResponse(Connection& connection);
+    static void buildResponse(Connection& connection);
+
+    std::thread thread;
+    std::atomic<bool> running;
+    int port;
+    SOCKET listenSocket;
+    SocketPoller poller;
+    std::vector<Connection> connections;     // Endpoint thread only
+};
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "PublishPipeline.h"
+#include "Tracing.h"
+
+PublishPipeline::PublishPipeline()
+    : filling(-1), pending(-1), publishing(-1), running(false),
+      skipped(Metrics::counter("aman_snapshots_skipped_total", "Tick snapshots replaced by a newer one before they were published")),
+      publishLatency(Metrics::histogram("aman_publish_micros", "Serialization and enqueueing of a tick snapshot on the publisher thread")) {
+}
+
+PublishPipeline::~PublishPipeline() {
+    stop();
+}
+
+void PublishPipeline::start(Publisher publisher) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    this->publisher = std::move(publisher);
+    running = true;
+    thread = std::thread(&PublishPipeline::run, this);
+}
+
+void PublishPipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+TrafficSnapshot& PublishPipeline::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < 2; i++) {
+        if (i != publishing && i != pending) {
+            filling = i;
+            return buffers[i];
+        }
+    }
+    // One is being published and the other is still waiting: this tick replaces the waiting one
+    filling = pending;
+    pending = -1;
+    skipped.add();
+    return buffers[filling];
+}
+
+void PublishPipeline::submit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = filling;
+        filling = -1;
+    }
+    wake.notify_one();
+}
+
+void PublishPipeline::run() {
+    Tracing::setThreadName("Publisher");
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return !running || pending != -1; });
+        if (!running) {
+            break;
+        }
+        publishing = pending;
+        pending = -1;
+        lock.unlock();
+        {
+            ScopedLatency timer(publishLatency);
+            publisher(buffers[publishing]);
+        }
+        lock.lock();
+        publishing = -1;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Metrics.h"
+#include "TrafficSnapshot.h"
+
+// Hands each tick's TrafficSnapshot from the EuroScope thread to a publisher thread, which does the
+// serialization, diffing and enqueueing. There are two snapshot buffers, so the EuroScope thread
+// fills one while the other is being published and never waits. A publisher that falls a whole
+// tick behind gets the newest snapshot instead of the one it had not started; the older one is
+// counted as skipped.
+class PublishPipeline {
+public:
+    typedef std::function<void(TrafficSnapshot&)> Publisher;
+
+    PublishPipeline();
+    ~PublishPipeline();
+
+    void start(Publisher publisher);
+    void stop();
+
+    // EuroScope thread: the buffer to fill for this tick, still holding what it held before;
+    // submit() passes it on
+    TrafficSnapshot& acquire();
+    void submit();
+
+private:
+    void run();
+
+    TrafficSnapshot buffers[2];
+    std::mutex mutex;
+    std::condition_variable wake;
+    int filling;                // Buffer indexes, -1 for none
+    int pending;
+    int publishing;
+    bool running;
+    std::thread thread;
+    Publisher publisher;
+
+    MetricCounter& skipped;
+    LatencyHistogram& publishLatency;
+};
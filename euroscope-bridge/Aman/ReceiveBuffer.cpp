@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "ReceiveBuffer.h"
+
+#include <cstring>
+
+ReceiveBuffer::ReceiveBuffer(size_t initialCapacity)
+    : data(new char[initialCapacity]), capacity(initialCapacity), readPos(0), scanPos(0), writePos(0) {}
+
+char* ReceiveBuffer::writePointer(size_t minSpace) {
+    if (writableBytes() < minSpace) {
+        compact();
+    }
+    if (writableBytes() < minSpace) {
+        size_t newCapacity = capacity * 2;
+        while (newCapacity - writePos < minSpace) {
+            newCapacity *= 2;
+        }
+        std::unique_ptr<char[]> grown(new char[newCapacity]);
+        memcpy(grown.get(), data.get(), writePos);
+        data = std::move(grown);
+        capacity = newCapacity;
+    }
+    return data.get() + writePos;
+}
+
+void ReceiveBuffer::commitWrite(size_t bytes) {
+    writePos += bytes;
+}
+
+bool ReceiveBuffer::nextFrame(std::string_view& frame, char delimiter) {
+    // memchr is vectorized by the CRT, and scanPos makes sure no byte is searched twice
+    const char* found = (const char*)memchr(data.get() + scanPos, delimiter, writePos - scanPos);
+    if (found == nullptr) {
+        scanPos = writePos;
+        return false;
+    }
+
+    size_t end = found - data.get();
+    frame = std::string_view(data.get() + readPos, end - readPos);
+    readPos = end + 1;
+    scanPos = readPos;
+    return true;
+}
+
+void ReceiveBuffer::compact() {
+    if (readPos == 0) {
+        return;
+    }
+    size_t remaining = writePos - readPos;
+    if (remaining > 0) {
+        memmove(data.get(), data.get() + readPos, remaining);
+    }
+    scanPos -= readPos;
+    writePos = remaining;
+    readPos = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+// Growable byte buffer for a delimiter-framed inbound stream.
+// recv() writes straight into the free tail, complete frames are handed out as views into
+// the buffer, and the unconsumed remainder is moved to the front once per read.
+// Every byte is scanned for the delimiter exactly once, regardless of how frames are split.
+class ReceiveBuffer {
+public:
+    explicit ReceiveBuffer(size_t initialCapacity = 16 * 1024);
+
+    // Free space at the end of the buffer, grown to at least minSpace bytes
+    char* writePointer(size_t minSpace);
+    size_t writableBytes() const { return capacity - writePos; }
+    void commitWrite(size_t bytes);
+
+    // Next complete frame without its delimiter. The view is valid until the next
+    // writePointer() or compact() call.
+    bool nextFrame(std::string_view& frame, char delimiter = '\n');
+
+    // Drop consumed frames by moving the incomplete tail to the front
+    void compact();
+
+    // Bytes received but not yet returned as part of a frame
+    size_t pendingBytes() const { return writePos - readPos; }
+
+private:
+    std::unique_ptr<char[]> data;
+    size_t capacity;
+    size_t readPos;     // Start of the first unconsumed frame
+    size_t scanPos;     // Everything before this has been searched for a delimiter
+    size_t writePos;    // End of received data
+};
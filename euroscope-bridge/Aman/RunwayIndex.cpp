@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "RunwayIndex.h"
+#include "StringUtils.h"
+
+#include <unordered_set>
+
+using namespace EuroScopePlugIn;
+
+void RunwayIndex::rebuild(CPlugIn& plugIn) {
+    // Runways only count for airports the sector file declares as such
+    std::unordered_set<std::string> sectorAirports;
+    for (auto airport = plugIn.SectorFileElementSelectFirst(SECTOR_ELEMENT_AIRPORT);
+         airport.IsValid();
+         airport = plugIn.SectorFileElementSelectNext(airport, SECTOR_ELEMENT_AIRPORT)) {
+        sectorAirports.insert(airport.GetName());
+    }
+
+    std::unordered_map<std::string, Airport> rebuilt;
+    for (auto runway = plugIn.SectorFileElementSelectFirst(SECTOR_ELEMENT_RUNWAY);
+         runway.IsValid();
+         runway = plugIn.SectorFileElementSelectNext(runway, SECTOR_ELEMENT_RUNWAY)) {
+        std::string airportIcao = trimSpaces(runway.GetAirportName());
+        if (sectorAirports.count(airportIcao) == 0) {
+            continue;
+        }
+        Runway entry;
+        entry.element = runway;
+        entry.names[0] = trimSpaces(runway.GetRunwayName(0));
+        entry.names[1] = trimSpaces(runway.GetRunwayName(1));
+        rebuilt[airportIcao].runways.push_back(entry);
+    }
+
+    // What was published still counts for airports whose runways are the same as before
+    for (auto& entry : rebuilt) {
+        auto previous = airports.find(entry.first);
+        if (previous != airports.end() && sameRunways(previous->second.runways, entry.second.runways)) {
+            entry.second.published = std::move(previous->second.published);
+            entry.second.hasPublished = previous->second.hasPublished;
+        }
+    }
+    airports = std::move(rebuilt);
+    built = true;
+}
+
+void RunwayIndex::getStatuses(const std::string& airportIcao, std::vector<RunwayStatus>& statuses) {
+    statuses.clear();
+    auto airport = airports.find(airportIcao);
+    if (airport == airports.end()) {
+        return;
+    }
+    readActivity(airport->second, activity);
+    fillStatuses(airportIcao, airport->second, activity, statuses);
+}
+
+bool RunwayIndex::getChangedStatuses(const std::string& airportIcao, std::vector<RunwayStatus>& statuses) {
+    auto airport = airports.find(airportIcao);
+    if (airport == airports.end()) {
+        return false;
+    }
+    readActivity(airport->second, activity);
+    if (airport->second.hasPublished && activity == airport->second.published) {
+        return false;
+    }
+    airport->second.published = activity;
+    airport->second.hasPublished = true;
+    fillStatuses(airportIcao, airport->second, activity, statuses);
+    return true;
+}
+
+bool RunwayIndex::sameRunways(const std::vector<Runway>& a, const std::vector<Runway>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].names[0] != b[i].names[0] || a[i].names[1] != b[i].names[1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RunwayIndex::readActivity(Airport& airport, std::vector<bool>& activity) {
+    activity.clear();
+    for (auto& runway : airport.runways) {
+        for (int direction = 0; direction < 2; direction++) {
+            activity.push_back(runway.element.IsElementActive(true, direction));
+            activity.push_back(runway.element.IsElementActive(false, direction));
+        }
+    }
+}
+
+void RunwayIndex::fillStatuses(const std::string& airportIcao, const Airport& airport, const std::vector<bool>& activity, std::vector<RunwayStatus>& statuses) {
+    statuses.clear();
+    for (size_t i = 0; i < airport.runways.size(); i++) {
+        for (int direction = 0; direction < 2; direction++) {
+            size_t bit = (i * 2 + direction) * 2;
+            statuses.push_back({ airportIcao, airport.runways[i].names[direction], activity[bit], activity[bit + 1] });
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EuroScopePlugIn.h"
+#include "AmanDataTypes.h"
+
+// Runways of the sector file's airports, holding on to their sector elements so that the activity
+// of one airport is read without walking every runway in the file. Element handles only hold for
+// the sector file they came from. They are kept between runway activity changes, and the index is
+// rebuilt on every one of them, which EuroScope also reports after loading a sector file.
+class RunwayIndex {
+public:
+    void rebuild(EuroScopePlugIn::CPlugIn& plugIn);
+    bool isBuilt() const { return built; }
+
+    // Both directions of each of the airport's runways; nothing for an airport the sector file lacks
+    void getStatuses(const std::string& airportIcao, std::vector<RunwayStatus>& statuses);
+    // The same, but only when the airport's activity changed since the last call that returned it
+    bool getChangedStatuses(const std::string& airportIcao, std::vector<RunwayStatus>& statuses);
+
+private:
+    struct Runway {
+        EuroScopePlugIn::CSectorElement element;
+        std::string names[2];       // By direction
+    };
+
+    struct Airport {
+        std::vector<Runway> runways;
+        // Departure and arrival activity of each direction, as last returned by getChangedStatuses()
+        std::vector<bool> published;
+        bool hasPublished = false;
+    };
+
+    static bool sameRunways(const std::vector<Runway>& a, const std::vector<Runway>& b);
+    static void readActivity(Airport& airport, std::vector<bool>& activity);
+    static void fillStatuses(const std::string& airportIcao, const Airport& airport, const std::vector<bool>& activity, std::vector<RunwayStatus>& statuses);
+
+    std::unordered_map<std::string, Airport> airports;     // By ICAO
+    std::vector<bool> activity;                             // Scratch
+    bool built = false;
+};
@@ -1,38 +1,173 @@
 #include "stdafx.h"
 #include "ServerEventsHandler.h"
+#include "Metrics.h"
 
 #include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
 
+#include <climits>
+#include <cstring>
 #include <string>
+#include <utility>
+#include <vector>
 
-void ServerEventsHandler::processMessage(const std::string& message) {
-    // Parse the JSON using rapidjson
+// Message types processMessage() handles
+static const char* const KNOWN_MESSAGE_TYPES[] = {
+    "registerAirport", "unregisterAirport", "requestResync", "subscribeBridgeStats",
+    "unsubscribeBridgeStats", "selectCodec", "assignRunway", "setCtot"
+};
+
+// aman_inbound_messages_total of the type, looked up once per known type. The type comes from the
+// client, so anything else is counted as "unknown" rather than becoming a series of its own.
+static MetricCounter& inboundMessages(const char* messageType) {
+    static const std::vector<std::pair<const char*, MetricCounter*>> counters = [] {
+        std::vector<std::pair<const char*, MetricCounter*>> resolved;
+        for (auto type : KNOWN_MESSAGE_TYPES) {
+            resolved.emplace_back(type, &Metrics::counter("aman_inbound_messages_total", "Messages received from clients", { { "type", type } }));
+        }
+        return resolved;
+    }();
+    static MetricCounter& unknown = Metrics::counter("aman_inbound_messages_total", "Messages received from clients", { { "type", "unknown" } });
+
+    for (auto& entry : counters) {
+        if (strcmp(entry.first, messageType) == 0) {
+            return *entry.second;
+        }
+    }
+    return unknown;
+}
+
+static std::string getRequestId(const rapidjson::Document& document) {
+    if (document.HasMember("requestId") && document["requestId"].IsString()) {
+        return document["requestId"].GetString();
+    }
+    return std::string();
+}
+
+// A required string member of the message, or nullptr when it is missing or not a string
+static const char* requiredString(const rapidjson::Document& document, const char* name) {
+    auto member = document.FindMember(name);
+    if (member == document.MemberEnd() || !member->value.IsString()) {
+        return nullptr;
+    }
+    return member->value.GetString();
+}
+
+void ServerEventsHandler::processMessage(ClientId clientId, std::string_view message) {
+    // Parse the JSON using rapidjson, directly from the receive buffer
     rapidjson::Document document;
-    document.Parse(message.c_str());
+    document.Parse(message.data(), message.size());
 
 
     if (document.HasParseError()) {
-        onErrorProcessingMessage("Error parsing JSON message: " + message);
+        countInboundError("parse");
+        onErrorProcessingMessage("Error parsing JSON message: " + std::string(message));
         return;
     }
 
+    if (!document.IsObject() || !document.HasMember("type") || !document["type"].IsString()) {
+        inboundMessages("").add();
+        countInboundError("unknownType");
+        onErrorProcessingMessage("Message without a type: " + std::string(message));
+        return;
+    }
     const char* messageType = document["type"].GetString();
+    inboundMessages(messageType).add();
 
     // requestInboundsForFix
     if (strcmp(messageType, "registerAirport") == 0) {
-        auto airportIcao = document["icao"].GetString();
-        onRegisterAirport(airportIcao);
+        auto airportIcao = requiredString(document, "icao");
+        if (!airportIcao) {
+            rejectInvalidMember(messageType, "icao");
+            return;
+        }
+        SubscriptionOptions options;
+        if (document.HasMember("arrivalsDelta") && document["arrivalsDelta"].IsBool()) {
+            options.arrivalsDelta = document["arrivalsDelta"].GetBool();
+        }
+        if (document.HasMember("departuresDelta") && document["departuresDelta"].IsBool()) {
+            options.departuresDelta = document["departuresDelta"].GetBool();
+        }
+        if (document.HasMember("updateInterval") && document["updateInterval"].IsInt()) {
+            int interval = document["updateInterval"].GetInt();
+            options.updateInterval = interval > 1 ? interval : 1;
+        }
+        if (document.HasMember("arrivalFields") && document["arrivalFields"].IsArray()) {
+            options.arrivalFields = 0;
+            for (auto& name : document["arrivalFields"].GetArray()) {
+                uint32_t field = name.IsString() ? arrivalFieldByName(name.GetString()) : 0;
+                if (field == 0) {
+                    countInboundError("unknownField");
+                }
+                options.arrivalFields |= field;
+            }
+        }
+        onRegisterAirport(clientId, airportIcao, options);
     }
     else if (strcmp(messageType, "unregisterAirport") == 0) {
-        auto airportIcao = document["icao"].GetString();
-        onUnregisterAirport(airportIcao);
+        auto airportIcao = requiredString(document, "icao");
+        if (!airportIcao) {
+            rejectInvalidMember(messageType, "icao");
+            return;
+        }
+        onUnregisterAirport(clientId, airportIcao);
+    }
+    else if (strcmp(messageType, "requestResync") == 0) {
+        // Client missed a delta (sequence gap); it gets fresh snapshots on the next tick
+        auto airportIcao = requiredString(document, "icao");
+        if (!airportIcao) {
+            rejectInvalidMember(messageType, "icao");
+            return;
+        }
+        onRequestResync(clientId, airportIcao);
+    }
+    else if (strcmp(messageType, "subscribeBridgeStats") == 0 || strcmp(messageType, "unsubscribeBridgeStats") == 0) {
+        onSubscribeBridgeStats(clientId, messageType[0] == 's');
+    }
+    else if (strcmp(messageType, "selectCodec") == 0) {
+        auto codec = requiredString(document, "codec");
+        if (!codec) {
+            rejectInvalidMember(messageType, "codec");
+            return;
+        }
+        onSelectCodec(clientId, codec);
     }
     else if (strcmp(messageType, "assignRunway") == 0) {
-        onRequestAssignRunway(document["callsign"].GetString(), document["runway"].GetString());
+        auto callsign = requiredString(document, "callsign");
+        auto runway = requiredString(document, "runway");
+        if (!callsign || !runway) {
+            rejectInvalidMember(messageType, callsign ? "runway" : "callsign");
+            return;
+        }
+        onRequestAssignRunway(clientId, getRequestId(document), callsign, runway);
+    }
+    else if (strcmp(messageType, "setCtot") == 0) {
+        auto callsign = requiredString(document, "callsign");
+        if (!callsign) {
+            rejectInvalidMember(messageType, "callsign");
+            return;
+        }
+        // A unix timestamp; long is 32 bits on Windows, so anything outside its range is rejected rather than truncated
+        auto ctot = document.FindMember("ctot");
+        if (ctot == document.MemberEnd() || !ctot->value.IsInt64()
+            || ctot->value.GetInt64() < LONG_MIN || ctot->value.GetInt64() > LONG_MAX) {
+            rejectInvalidMember(messageType, "ctot");
+            return;
+        }
+        onSetCtot(clientId, getRequestId(document), callsign, static_cast<long>(ctot->value.GetInt64()));
     }
     else {
+        countInboundError("unknownType");
         onErrorProcessingMessage("Unknown message type: " + std::string(messageType));
     }
 
-}
\ No newline at end of file
+}
+
+void ServerEventsHandler::countInboundError(const char* reason) {
+    Metrics::counter("aman_inbound_errors_total", "Client messages that could not be handled, by reason", { { "reason", reason } }).add();
+}
+
+void ServerEventsHandler::rejectInvalidMember(const char* messageType, const char* member) {
+    countInboundError("invalidMember");
+    onErrorProcessingMessage(std::string(messageType) + " without a valid " + member);
+}
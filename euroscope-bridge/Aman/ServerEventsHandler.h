@@ -1,17 +1,54 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "ArrivalsDelta.h"
+
+// Identifies one connected AMAN/DMAN client for the lifetime of its connection
+typedef int ClientId;
+
+// Choices a client makes per airport when registering for it
+struct SubscriptionOptions {
+    // Receive arrivalsSnapshot once and arrivalsDelta afterwards instead of the full arrivals list every tick.
+    // Updates carry route points only when the route changed, and nextFixIndex when a point was passed.
+    bool arrivalsDelta = false;
+    // The same for departures: departuresSnapshot once, then departuresDelta with whole added and updated departures
+    bool departuresDelta = false;
+    // Full arrivals and departures only on every this many ticks (seconds). Delta streams are not throttled.
+    int updateInterval = 1;
+    // ArrivalField bits written for each aircraft of the full arrivals; the callsign is always there
+    uint32_t arrivalFields = ArrivalAllFields;
+
+    bool usesDelta(const std::string& messageType) const {
+        return (arrivalsDelta && messageType == "arrivals") || (departuresDelta && messageType == "departures");
+    }
+    bool isDue(int tick) const {
+        return tick % updateInterval == 0;
+    }
+};
+
 class ServerEventsHandler {
 public:
-    void processMessage(const std::string& message);
+    void processMessage(ClientId clientId, std::string_view message);
 protected:
-    virtual void onClientConnected() = 0;
-    virtual void onRegisterAirport(const std::string& icao) = 0;
-    virtual void onUnregisterAirport(const std::string& icao) = 0;
-    virtual void onRequestAssignRunway(const std::string& callsign, const std::string& runway) = 0;
-    virtual void onSetCtot(const std::string& callSign, long ctot) = 0;
-    virtual void onClientDisconnected() = 0;
+    virtual void onClientConnected(ClientId clientId) = 0;
+    virtual void onRegisterAirport(ClientId clientId, const std::string& icao, const SubscriptionOptions& options) = 0;
+    virtual void onUnregisterAirport(ClientId clientId, const std::string& icao) = 0;
+    virtual void onRequestResync(ClientId clientId, const std::string& icao) = 0;
+    // Opt-in periodic bridgeStats messages
+    virtual void onSubscribeBridgeStats(ClientId clientId, bool subscribe) = 0;
+    // Client asks for its messages in another wire codec (see WireCodec.h)
+    virtual void onSelectCodec(ClientId clientId, const std::string& codec) = 0;
+    // Commands carry an optional requestId; when present the client expects a commandResult reply
+    virtual void onRequestAssignRunway(ClientId clientId, const std::string& requestId, const std::string& callsign, const std::string& runway) = 0;
+    virtual void onSetCtot(ClientId clientId, const std::string& requestId, const std::string& callSign, long ctot) = 0;
     virtual void onErrorProcessingMessage(const std::string& errorMessage) = 0;
-};
 
+    // Counts a message that could not be handled, by reason
+    static void countInboundError(const char* reason);
+
+private:
+    // Drops a message whose required member is missing or of the wrong type
+    void rejectInvalidMember(const char* messageType, const char* member);
+};
@@ -0,0 +1,232 @@
+#include "stdafx.h"
+#include "SessionCapture.h"
+#include "FrameCompression.h"
+#include "Tracing.h"
+
+// Frames and messages waiting for the writer thread. If the disk can't keep up, records are
+// dropped (and counted in a CaptureGap record) rather than letting the capture grow the process.
+static const size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+// Small frames gain nothing from compression
+static const size_t MIN_COMPRESSED_BYTES = 64;
+
+SessionCapture::SessionCapture()
+    : active(false), pendingBytes(0), droppedRecords(0), stopping(false), nextFrameId(0) {
+}
+
+SessionCapture::~SessionCapture() {
+    stop();
+}
+
+bool SessionCapture::start(const std::string& path) {
+    if (active) {
+        return false;
+    }
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    auto startTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+    buffer.assign(CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH);
+    appendVarint(buffer, (uint64_t)startTime.count());
+    file.write(buffer.data(), buffer.size());
+    file.flush();
+
+    lastTime = std::chrono::steady_clock::now();
+    nextFrameId = 0;
+    writtenFrames.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.clear();
+        pendingBytes = 0;
+        droppedRecords = 0;
+        stopping = false;
+    }
+    writer = std::thread(&SessionCapture::writerLoop, this);
+    active = true;
+    return true;
+}
+
+void SessionCapture::stop() {
+    if (!active) {
+        return;
+    }
+    active = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    file.close();
+    writtenFrames.clear();
+}
+
+void SessionCapture::recordConnected(ClientId clientId) {
+    Record record;
+    record.type = CaptureClientConnected;
+    record.clientId = clientId;
+    enqueue(std::move(record));
+}
+
+void SessionCapture::recordDisconnected(ClientId clientId) {
+    Record record;
+    record.type = CaptureClientDisconnected;
+    record.clientId = clientId;
+    enqueue(std::move(record));
+}
+
+void SessionCapture::recordInbound(ClientId clientId, std::string_view message) {
+    Record record;
+    record.type = CaptureInbound;
+    record.clientId = clientId;
+    record.message.assign(message.data(), message.size());
+    enqueue(std::move(record));
+}
+
+void SessionCapture::recordSent(ClientId clientId, const SharedFrame& frame) {
+    Record record;
+    record.type = CaptureFrameSent;
+    record.clientId = clientId;
+    record.frame = frame;
+    enqueue(std::move(record));
+}
+
+void SessionCapture::enqueue(Record record) {
+    if (!active) {
+        return;
+    }
+    // A frame shared with other clients is only counted once it is written, but this keeps the bound simple
+    size_t bytes = record.message.size() + (record.frame ? record.frame->size() : 0);
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        if (pendingBytes + bytes > MAX_PENDING_BYTES) {
+            droppedRecords++;
+            return;
+        }
+        // Stamped under the lock so the queue is in time order
+        record.time = std::chrono::steady_clock::now();
+        wasEmpty = pending.empty();
+        pendingBytes += bytes;
+        pending.push_back(std::move(record));
+    }
+    if (wasEmpty) {
+        wake.notify_one();
+    }
+}
+
+void SessionCapture::writerLoop() {
+    Tracing::setThreadName("Session capture");
+    std::vector<Record> records;
+
+    while (true) {
+        uint64_t dropped;
+        bool finished;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !pending.empty(); });
+            records.swap(pending);
+            pendingBytes = 0;
+            dropped = droppedRecords;
+            droppedRecords = 0;
+            finished = stopping;
+        }
+
+        TraceSpan span("writeCapture", (int)records.size());
+        buffer.clear();
+        if (dropped > 0) {
+            buffer.push_back((char)CaptureGap);
+            appendTime(std::chrono::steady_clock::now());
+            appendVarint(buffer, dropped);
+        }
+        for (auto& record : records) {
+            writeRecord(record);
+        }
+        // Release the frames before waiting again
+        records.clear();
+
+        file.write(buffer.data(), buffer.size());
+        // Keep the file usable up to the last batch if the process dies
+        file.flush();
+
+        if (finished) {
+            return;
+        }
+    }
+}
+
+void SessionCapture::writeRecord(const Record& record) {
+    if (record.type != CaptureFrameSent) {
+        buffer.push_back((char)record.type);
+        appendTime(record.time);
+        appendVarint(buffer, (uint64_t)record.clientId);
+        if (record.type == CaptureInbound) {
+            appendPayload(record.message.data(), record.message.size());
+        }
+        return;
+    }
+
+    // Snapshots fanned out to several clients are the same frame object
+    auto written = writtenFrames.find(record.frame.get());
+    if (written != writtenFrames.end() && written->second.frame.lock() == record.frame
+        && nextFrameId - written->second.frameId <= CAPTURE_FRAME_WINDOW) {
+        buffer.push_back((char)CaptureFrameRepeat);
+        appendTime(record.time);
+        appendVarint(buffer, (uint64_t)record.clientId);
+        appendVarint(buffer, written->second.frameId);
+        return;
+    }
+
+    uint64_t frameId = nextFrameId++;
+    buffer.push_back((char)CaptureFrameSent);
+    appendTime(record.time);
+    appendVarint(buffer, (uint64_t)record.clientId);
+    appendVarint(buffer, frameId);
+    appendPayload(record.frame->data(), record.frame->size());
+
+    writtenFrames[record.frame.get()] = { record.frame, frameId };
+    if (writtenFrames.size() > 2 * CAPTURE_FRAME_WINDOW) {
+        forgetOldFrames();
+    }
+}
+
+void SessionCapture::appendPayload(const char* data, size_t size) {
+    appendVarint(buffer, size);
+    if (size >= MIN_COMPRESSED_BYTES) {
+        compressBlock(data, size, compressed);
+        if (compressed.size() < size) {
+            appendVarint(buffer, compressed.size());
+            buffer.append(compressed);
+            return;
+        }
+    }
+    appendVarint(buffer, size);
+    buffer.append(data, size);
+}
+
+void SessionCapture::appendTime(std::chrono::steady_clock::time_point time) {
+    // A gap is stamped when the writer notices it, after records that are written behind it
+    auto delta = std::chrono::duration_cast<std::chrono::microseconds>(time - lastTime).count();
+    if (delta < 0) {
+        delta = 0;
+    } else {
+        lastTime = time;
+    }
+    appendVarint(buffer, (uint64_t)delta);
+}
+
+void SessionCapture::forgetOldFrames() {
+    for (auto it = writtenFrames.begin(); it != writtenFrames.end();) {
+        if (it->second.frame.expired() || nextFrameId - it->second.frameId > CAPTURE_FRAME_WINDOW) {
+            it = writtenFrames.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "CaptureFormat.h"
+#include "CoalescingSendQueue.h"
+#include "ServerEventsHandler.h"
+
+// Optional recording of everything the server exchanges with its clients (see CaptureFormat.h),
+// for reproducing a session offline with aman-replay. The record* calls only timestamp the event
+// and queue a reference to the frame; compression and file writes happen on the capture's own
+// thread. A frame shared by several clients is compressed and stored once.
+class SessionCapture {
+public:
+    SessionCapture();
+    ~SessionCapture();
+
+    // Starts a new capture file, replacing an existing one at that path
+    bool start(const std::string& path);
+    // Writes out what is still queued and closes the file
+    void stop();
+    bool isActive() const { return active; }
+
+    void recordConnected(ClientId clientId);
+    void recordDisconnected(ClientId clientId);
+    void recordInbound(ClientId clientId, std::string_view message);
+    void recordSent(ClientId clientId, const SharedFrame& frame);
+
+private:
+    struct Record {
+        CaptureRecordType type;
+        std::chrono::steady_clock::time_point time;
+        ClientId clientId;
+        SharedFrame frame;          // CaptureFrameSent
+        std::string message;        // CaptureInbound
+    };
+
+    struct WrittenFrame {
+        std::weak_ptr<const std::string> frame;     // Tells a reused address from the same frame
+        uint64_t frameId;
+    };
+
+    void enqueue(Record record);
+    void writerLoop();
+    void writeRecord(const Record& record);
+    void appendPayload(const char* data, size_t size);
+    void appendTime(std::chrono::steady_clock::time_point time);
+    void forgetOldFrames();
+
+    std::atomic<bool> active;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Record> pending;        // Guarded by mutex
+    size_t pendingBytes;                // Guarded by mutex
+    uint64_t droppedRecords;            // Guarded by mutex
+    bool stopping;                      // Guarded by mutex
+    std::thread writer;
+
+    // Only used by the writer thread while a capture is running
+    std::ofstream file;
+    std::string buffer;
+    std::string compressed;
+    std::chrono::steady_clock::time_point lastTime;
+    uint64_t nextFrameId;
+    std::unordered_map<const std::string*, WrittenFrame> writtenFrames;
+};
@@ -0,0 +1,324 @@
+#include "stdafx.h"
+#include "SocketLayer.h"
+
+#ifdef _WIN32
+#pragma comment(lib, "ws2_32.lib")  // Link with the Winsock library
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#endif
+
+#include <cstdint>
+
+bool socketStartup() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+    return true;
+#endif
+}
+
+void socketCleanup() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void closeSocket(SOCKET socket) {
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    ::close(socket);
+#endif
+}
+
+bool setSocketNonBlocking(SOCKET socket) {
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    return ioctlsocket(socket, FIONBIO, &nonBlocking) != SOCKET_ERROR;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+}
+
+int socketLastError() {
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+bool socketWouldBlock(int error) {
+#ifdef _WIN32
+    return error == WSAEWOULDBLOCK;
+#else
+    return error == EWOULDBLOCK || error == EAGAIN || error == EINTR;
+#endif
+}
+
+bool socketConnectionLost(int error) {
+#ifdef _WIN32
+    return error == WSAECONNRESET || error == WSAECONNABORTED;
+#else
+    return error == ECONNRESET || error == ECONNABORTED || error == EPIPE;
+#endif
+}
+
+int sendVectored(SOCKET socket, const SendSlice* slices, size_t count) {
+    if (count > MAX_SEND_SLICES) {
+        count = MAX_SEND_SLICES;
+    }
+
+#ifdef _WIN32
+    WSABUF buffers[MAX_SEND_SLICES];
+    for (size_t i = 0; i < count; i++) {
+        buffers[i].buf = const_cast<char*>(slices[i].data);
+        buffers[i].len = (ULONG)slices[i].length;
+    }
+
+    DWORD bytesSent = 0;
+    if (WSASend(socket, buffers, (DWORD)count, &bytesSent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+        return SOCKET_ERROR;
+    }
+    return (int)bytesSent;
+#else
+    iovec buffers[MAX_SEND_SLICES];
+    for (size_t i = 0; i < count; i++) {
+        buffers[i].iov_base = const_cast<char*>(slices[i].data);
+        buffers[i].iov_len = slices[i].length;
+    }
+
+    // sendmsg rather than writev so MSG_NOSIGNAL applies
+    msghdr message{};
+    message.msg_iov = buffers;
+    message.msg_iovlen = count;
+    return (int)sendmsg(socket, &message, SOCKET_SEND_FLAGS);
+#endif
+}
+
+#ifdef _WIN32
+
+// WSAPoll can only wait on sockets, so wake-ups are delivered through a UDP socket connected to itself
+
+SocketPoller::SocketPoller() : wakeSocket(INVALID_SOCKET) {}
+
+SocketPoller::~SocketPoller() {
+    close();
+}
+
+bool SocketPoller::open() {
+    wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (wakeSocket == INVALID_SOCKET) {
+        return false;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    int addressLength = sizeof(address);
+
+    if (bind(wakeSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR
+        || getsockname(wakeSocket, (sockaddr*)&address, &addressLength) == SOCKET_ERROR
+        || connect(wakeSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR
+        || !setSocketNonBlocking(wakeSocket)) {
+        close();
+        return false;
+    }
+
+    pollFds.clear();
+    pollFds.push_back({ wakeSocket, POLLRDNORM, 0 });
+    return true;
+}
+
+void SocketPoller::close() {
+    if (wakeSocket != INVALID_SOCKET) {
+        closesocket(wakeSocket);
+        wakeSocket = INVALID_SOCKET;
+    }
+    pollFds.clear();
+}
+
+bool SocketPoller::add(SOCKET socket, int events) {
+    for (auto& pfd : pollFds) {
+        if (pfd.fd == socket) {
+            return false;
+        }
+    }
+    WSAPOLLFD pfd{};
+    pfd.fd = socket;
+    pfd.events = (events & Readable ? POLLRDNORM : 0) | (events & Writable ? POLLWRNORM : 0);
+    pollFds.push_back(pfd);
+    return true;
+}
+
+bool SocketPoller::modify(SOCKET socket, int events) {
+    for (auto& pfd : pollFds) {
+        if (pfd.fd == socket) {
+            pfd.events = (events & Readable ? POLLRDNORM : 0) | (events & Writable ? POLLWRNORM : 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SocketPoller::remove(SOCKET socket) {
+    // Index 0 is the wake socket and is never removed
+    for (size_t i = 1; i < pollFds.size(); i++) {
+        if (pollFds[i].fd == socket) {
+            pollFds.erase(pollFds.begin() + i);
+            return;
+        }
+    }
+}
+
+int SocketPoller::wait(std::vector<Event>& ready, int timeoutMs) {
+    ready.clear();
+
+    int count = WSAPoll(pollFds.data(), (ULONG)pollFds.size(), timeoutMs);
+    if (count == SOCKET_ERROR) {
+        return -1;
+    }
+
+    for (auto& pfd : pollFds) {
+        if (pfd.revents == 0) {
+            continue;
+        }
+        if (pfd.fd == wakeSocket) {
+            drainWakeSignal();
+            continue;
+        }
+
+        int events = 0;
+        if (pfd.revents & POLLRDNORM) events |= Readable;
+        if (pfd.revents & POLLWRNORM) events |= Writable;
+        // Report hangups as readable too so the owner finds out through recv()
+        if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) events |= Hangup | Readable;
+        ready.push_back({ pfd.fd, events });
+    }
+
+    return (int)ready.size();
+}
+
+void SocketPoller::wake() {
+    if (wakeSocket != INVALID_SOCKET) {
+        char signal = 1;
+        send(wakeSocket, &signal, 1, 0);
+    }
+}
+
+void SocketPoller::drainWakeSignal() {
+    char buffer[64];
+    while (recv(wakeSocket, buffer, sizeof(buffer), 0) > 0) {
+    }
+}
+
+#else
+
+SocketPoller::SocketPoller() : epollFd(-1), wakeFd(-1) {}
+
+SocketPoller::~SocketPoller() {
+    close();
+}
+
+bool SocketPoller::open() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd == -1 || wakeFd == -1) {
+        close();
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) == -1) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SocketPoller::close() {
+    if (wakeFd != -1) {
+        ::close(wakeFd);
+        wakeFd = -1;
+    }
+    if (epollFd != -1) {
+        ::close(epollFd);
+        epollFd = -1;
+    }
+}
+
+static uint32_t toEpollEvents(int events) {
+    uint32_t epollEvents = 0;
+    if (events & SocketPoller::Readable) epollEvents |= EPOLLIN | EPOLLRDHUP;
+    if (events & SocketPoller::Writable) epollEvents |= EPOLLOUT;
+    return epollEvents;
+}
+
+bool SocketPoller::add(SOCKET socket, int events) {
+    epoll_event event{};
+    event.events = toEpollEvents(events);
+    event.data.fd = socket;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, socket, &event) == 0;
+}
+
+bool SocketPoller::modify(SOCKET socket, int events) {
+    epoll_event event{};
+    event.events = toEpollEvents(events);
+    event.data.fd = socket;
+    return epoll_ctl(epollFd, EPOLL_CTL_MOD, socket, &event) == 0;
+}
+
+void SocketPoller::remove(SOCKET socket) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, socket, nullptr);
+}
+
+int SocketPoller::wait(std::vector<Event>& ready, int timeoutMs) {
+    ready.clear();
+
+    epoll_event events[64];
+    int count = epoll_wait(epollFd, events, 64, timeoutMs);
+    if (count == -1) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.fd == wakeFd) {
+            drainWakeSignal();
+            continue;
+        }
+
+        int flags = 0;
+        if (events[i].events & EPOLLIN) flags |= Readable;
+        if (events[i].events & EPOLLOUT) flags |= Writable;
+        // Report hangups as readable too so the owner finds out through recv()
+        if (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) flags |= Hangup | Readable;
+        ready.push_back({ events[i].data.fd, flags });
+    }
+
+    return (int)ready.size();
+}
+
+void SocketPoller::wake() {
+    if (wakeFd != -1) {
+        uint64_t signal = 1;
+        ssize_t written = write(wakeFd, &signal, sizeof(signal));
+        (void)written;
+    }
+}
+
+void SocketPoller::drainWakeSignal() {
+    uint64_t value;
+    while (read(wakeFd, &value, sizeof(value)) > 0) {
+    }
+}
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+const int SOCKET_SEND_FLAGS = 0;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+
+// Don't let a client that went away kill the process with SIGPIPE
+const int SOCKET_SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+// One contiguous piece of outbound data for sendVectored()
+struct SendSlice {
+    const char* data;
+    size_t length;
+};
+
+// Upper bound on slices per sendVectored() call, well below IOV_MAX
+const size_t MAX_SEND_SLICES = 64;
+
+// Thin wrappers over the handful of calls that differ between Winsock and BSD sockets
+bool socketStartup();
+void socketCleanup();
+void closeSocket(SOCKET socket);
+bool setSocketNonBlocking(SOCKET socket);
+int socketLastError();
+bool socketWouldBlock(int error);
+bool socketConnectionLost(int error);
+
+// Gather-write of up to MAX_SEND_SLICES slices in one call (WSASend / sendmsg).
+// Returns the number of bytes written, which may be fewer than requested, or SOCKET_ERROR.
+int sendVectored(SOCKET socket, const SendSlice* slices, size_t count);
+
+// Readiness notification for a small set of sockets: WSAPoll on Windows, epoll on Linux.
+// A poller belongs to the thread that calls wait(); only wake() may be called from other threads.
+class SocketPoller {
+public:
+    enum EventFlags {
+        Readable = 1,
+        Writable = 2,
+        Hangup = 4
+    };
+
+    struct Event {
+        SOCKET socket;
+        int events;
+    };
+
+    SocketPoller();
+    ~SocketPoller();
+
+    bool open();
+    void close();
+
+    bool add(SOCKET socket, int events);
+    bool modify(SOCKET socket, int events);
+    void remove(SOCKET socket);
+
+    // Blocks until a watched socket is ready, wake() is called or the timeout (ms, -1 = forever) expires.
+    // Returns the number of ready sockets in `ready` (0 on timeout or wake), -1 on error.
+    int wait(std::vector<Event>& ready, int timeoutMs);
+    void wake();
+
+private:
+    void drainWakeSignal();
+
+#ifdef _WIN32
+    SOCKET wakeSocket;
+    std::vector<WSAPOLLFD> pollFds;
+#else
+    int epollFd;
+    int wakeFd;
+#endif
+};
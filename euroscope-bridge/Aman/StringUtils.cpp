@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "StringUtils.h"
+
+// What std::isspace() matches in the C locale, without its locale lookup
+static bool isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+std::string trimSpaces(std::string_view text) {
+    std::string out;
+    size_t start;
+    size_t end = 0;
+    while ((start = text.find_first_not_of(' ', end)) != std::string_view::npos) {
+        end = text.find(' ', start);
+        if (!out.empty()) {
+            out += ' ';
+        }
+        std::string_view word = text.substr(start, end - start);
+        out.append(word.data(), word.size());
+    }
+    return out;
+}
+
+void collapseSpaces(std::string_view text, std::string& out) {
+    out.clear();
+    size_t position = 0;
+    std::string_view token;
+    while (nextRouteToken(text, position, token)) {
+        if (!out.empty()) {
+            out += ' ';
+        }
+        out.append(token.data(), token.size());
+    }
+}
+
+bool nextRouteToken(std::string_view route, size_t& position, std::string_view& token) {
+    while (position < route.size() && isWhitespace(route[position])) {
+        position++;
+    }
+    if (position >= route.size()) {
+        return false;
+    }
+    size_t start = position;
+    while (position < route.size() && !isWhitespace(route[position])) {
+        position++;
+    }
+    token = route.substr(start, position - start);
+    return true;
+}
+
+std::vector<std::string_view> splitString(std::string_view text, char delimiter) {
+    std::vector<std::string_view> tokens;
+    size_t start;
+    size_t end = 0;
+    while ((start = text.find_first_not_of(delimiter, end)) != std::string_view::npos) {
+        end = text.find(delimiter, start);
+        tokens.push_back(text.substr(start, end - start));
+    }
+    return tokens;
+}
+
+std::string withArrivalRunway(std::string_view route, std::string_view arrivalAirport, std::string_view runway) {
+    // Measure first, so that the result is allocated once
+    size_t collapsedLength = 0;
+    size_t position = 0;
+    std::string_view token;
+    std::string_view last;
+    while (nextRouteToken(route, position, token)) {
+        collapsedLength += (collapsedLength > 0 ? 1 : 0) + token.size();
+        last = token;
+    }
+
+    std::string out;
+    size_t slash = last.find('/');
+    if (last.empty()) {
+        out.reserve(arrivalAirport.size() + 1 + runway.size());
+        out.append(arrivalAirport.data(), arrivalAirport.size());
+        out += '/';
+    } else if (slash != std::string_view::npos) {
+        // Everything after the slash is replaced
+        size_t kept = collapsedLength - last.size() + slash + 1;
+        out.reserve(collapsedLength + runway.size());
+        collapseSpaces(route, out);
+        out.resize(kept);
+    } else {
+        out.reserve(collapsedLength + 1 + arrivalAirport.size() + 1 + runway.size());
+        collapseSpaces(route, out);
+        out += ' ';
+        out.append(arrivalAirport.data(), arrivalAirport.size());
+        out += '/';
+    }
+    out.append(runway.data(), runway.size());
+    return out;
+}
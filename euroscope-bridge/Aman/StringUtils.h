@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Text handling for the EuroScope callbacks: sector file names and flight plan routes. Views into
+// the input are returned where possible, and functions producing a string allocate it once.
+
+// Without the spaces sector files pad names with, and with runs of spaces inside the name
+// collapsed to one, as the ^ +| +$|( ) + regex this replaces did. Other whitespace is kept.
+std::string trimSpaces(std::string_view text);
+
+// Whitespace-separated tokens joined by single spaces, replacing the contents of `out`
+void collapseSpaces(std::string_view text, std::string& out);
+
+// The token after `position` in a route, moving `position` past it; false when there is none left
+bool nextRouteToken(std::string_view route, size_t& position, std::string_view& token);
+
+// Tokens separated by one or more `delimiter`s
+std::vector<std::string_view> splitString(std::string_view text, char delimiter);
+
+// The route with `runway` after the slash of its final DEST/RWY token, or with
+// "`arrivalAirport`/`runway`" appended when it has none. Whitespace is collapsed.
+std::string withArrivalRunway(std::string_view route, std::string_view arrivalAirport, std::string_view runway);
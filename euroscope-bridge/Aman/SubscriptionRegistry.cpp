@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include "SubscriptionRegistry.h"
+
+#include <algorithm>
+
+namespace {
+
+bool byIcao(const SubscriptionRegistry::Airport& airport, const std::string& icao) {
+    return airport.icao < icao;
+}
+
+bool byClientId(const SubscriptionRegistry::Subscriber& subscriber, ClientId clientId) {
+    return subscriber.clientId < clientId;
+}
+
+}
+
+const SubscriptionRegistry::Airport* SubscriptionRegistry::Version::find(const std::string& icao) const {
+    auto it = std::lower_bound(airports.begin(), airports.end(), icao, byIcao);
+    if (it == airports.end() || it->icao != icao) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+const SubscriptionRegistry::Subscriber* SubscriptionRegistry::Version::find(const std::string& icao, ClientId clientId) const {
+    const Airport* airport = find(icao);
+    if (airport == nullptr) {
+        return nullptr;
+    }
+    auto it = std::lower_bound(airport->subscribers.begin(), airport->subscribers.end(), clientId, byClientId);
+    if (it == airport->subscribers.end() || it->clientId != clientId) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+SubscriptionRegistry::Reader::Reader(const SubscriptionRegistry& registry) : registry(registry) {
+    // Counted before the load: a writer that sees no open Reader after swapping knows nobody
+    // still holds the version it replaced
+    registry.openReaders.fetch_add(1);
+    version = registry.current.load();
+}
+
+SubscriptionRegistry::Reader::~Reader() {
+    registry.openReaders.fetch_sub(1);
+}
+
+SubscriptionRegistry::SubscriptionRegistry() : current(new Version()), openReaders(0) {
+}
+
+SubscriptionRegistry::~SubscriptionRegistry() {
+    delete current.load();
+}
+
+void SubscriptionRegistry::subscribe(ClientId clientId, const std::string& airportIcao, const SubscriptionOptions& options) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::unique_ptr<Version> next(new Version(*current.load()));
+
+    auto airport = std::lower_bound(next->airports.begin(), next->airports.end(), airportIcao, byIcao);
+    if (airport == next->airports.end() || airport->icao != airportIcao) {
+        airport = next->airports.insert(airport, Airport());
+        airport->icao = airportIcao;
+    }
+    auto& subscribers = airport->subscribers;
+    auto subscriber = std::lower_bound(subscribers.begin(), subscribers.end(), clientId, byClientId);
+    if (subscriber == subscribers.end() || subscriber->clientId != clientId) {
+        subscriber = subscribers.insert(subscriber, Subscriber());
+        subscriber->clientId = clientId;
+    }
+    subscriber->options = options;
+    publish(std::move(next));
+}
+
+void SubscriptionRegistry::unsubscribe(ClientId clientId, const std::string& airportIcao) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const Version* version = current.load();
+    const Airport* subscribed = version->find(airportIcao);
+    if (subscribed == nullptr) {
+        return;
+    }
+
+    std::unique_ptr<Version> next(new Version(*version));
+    auto airport = next->airports.begin() + (subscribed - version->airports.data());
+    auto& subscribers = airport->subscribers;
+    auto subscriber = std::lower_bound(subscribers.begin(), subscribers.end(), clientId, byClientId);
+    if (subscriber == subscribers.end() || subscriber->clientId != clientId) {
+        return;
+    }
+    subscribers.erase(subscriber);
+    if (subscribers.empty()) {
+        next->airports.erase(airport);
+    }
+    publish(std::move(next));
+}
+
+void SubscriptionRegistry::removeClient(ClientId clientId) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::unique_ptr<Version> next(new Version(*current.load()));
+    bool changed = false;
+    for (auto airport = next->airports.begin(); airport != next->airports.end();) {
+        auto& subscribers = airport->subscribers;
+        auto subscriber = std::lower_bound(subscribers.begin(), subscribers.end(), clientId, byClientId);
+        if (subscriber != subscribers.end() && subscriber->clientId == clientId) {
+            subscribers.erase(subscriber);
+            changed = true;
+        }
+        airport = subscribers.empty() ? next->airports.erase(airport) : airport + 1;
+    }
+    if (changed) {
+        publish(std::move(next));
+    }
+}
+
+void SubscriptionRegistry::publish(std::unique_ptr<Version> next) {
+    next->number++;
+    retired.emplace_back(current.exchange(next.release()));
+    if (openReaders.load() == 0) {
+        retired.clear();
+    }
+}
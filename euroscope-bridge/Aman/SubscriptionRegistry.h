@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ServerEventsHandler.h"
+
+// Every client's airport subscriptions and their options, for the threads that produce messages.
+// Readers never lock: a Reader pins the current version, which is immutable. Writers, which only
+// run when a client registers, unregisters or disconnects, copy it, change the copy and swap it in.
+// Replaced versions are freed by a later write that finds no Reader open.
+class SubscriptionRegistry {
+public:
+    struct Subscriber {
+        ClientId clientId;
+        SubscriptionOptions options;
+    };
+
+    struct Airport {
+        std::string icao;
+        std::vector<Subscriber> subscribers;    // By client id
+    };
+
+    struct Version {
+        uint64_t number = 0;                    // Goes up by one with every change
+        std::vector<Airport> airports;          // Only those with subscribers, by ICAO
+
+        const Airport* find(const std::string& icao) const;
+        // The client's subscription to the airport, or nullptr if it has none
+        const Subscriber* find(const std::string& icao, ClientId clientId) const;
+    };
+
+    // The version current when it was opened, valid until it is closed. Keep it short: replaced
+    // versions are only freed while no Reader is open.
+    class Reader {
+    public:
+        explicit Reader(const SubscriptionRegistry& registry);
+        ~Reader();
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const Version& operator*() const { return *version; }
+        const Version* operator->() const { return version; }
+
+    private:
+        const SubscriptionRegistry& registry;
+        const Version* version;
+    };
+
+    SubscriptionRegistry();
+    ~SubscriptionRegistry();
+
+    // Registering again replaces the options
+    void subscribe(ClientId clientId, const std::string& airportIcao, const SubscriptionOptions& options);
+    void unsubscribe(ClientId clientId, const std::string& airportIcao);
+    void removeClient(ClientId clientId);
+
+private:
+    // Swaps in `next`; called with writeMutex held
+    void publish(std::unique_ptr<Version> next);
+
+    std::atomic<const Version*> current;
+    mutable std::atomic<int> openReaders;
+    std::mutex writeMutex;
+    std::vector<std::unique_ptr<const Version>> retired;   // Guarded by writeMutex
+};
@@ -0,0 +1,230 @@
+#include "stdafx.h"
+#include "Tracing.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+namespace {
+
+// Per thread; about 3 MB, or a minute of a busy tick
+const size_t EVENTS_PER_THREAD = 1 << 16;
+const size_t DETAIL_LENGTH = 24;
+
+struct TraceEvent {
+    const char* name;
+    char detail[DETAIL_LENGTH];
+    bool async;
+    Tracing::TimePoint startTime;
+    Tracing::TimePoint endTime;
+};
+
+struct ThreadTrace {
+    // Only contended while a trace is cleared or written out
+    std::mutex mutex;
+    int threadId = 0;
+    std::string threadName;
+    std::vector<TraceEvent> events;
+    size_t next = 0;
+    bool wrapped = false;
+};
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadTrace>> threadTraces;     // Kept after a thread ends, for the trace file
+Tracing::TimePoint traceStart;
+
+thread_local std::shared_ptr<ThreadTrace> currentThreadTrace;
+thread_local const char* currentThreadName = nullptr;
+
+ThreadTrace& getThreadTrace() {
+    if (!currentThreadTrace) {
+        auto trace = std::make_shared<ThreadTrace>();
+        trace->events.resize(EVENTS_PER_THREAD);
+        trace->threadName = currentThreadName ? currentThreadName : "";
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        trace->threadId = (int)threadTraces.size() + 1;
+        if (trace->threadName.empty()) {
+            trace->threadName = "Thread " + std::to_string(trace->threadId);
+        }
+        threadTraces.push_back(trace);
+        currentThreadTrace = trace;
+    }
+    return *currentThreadTrace;
+}
+
+void copyDetail(char* target, const char* detail) {
+    size_t length = detail ? strlen(detail) : 0;
+    if (length >= DETAIL_LENGTH) {
+        length = DETAIL_LENGTH - 1;
+    }
+    memcpy(target, detail, length);
+    target[length] = '\0';
+}
+
+void record(const char* name, const char* detail, bool async, Tracing::TimePoint startTime, Tracing::TimePoint endTime) {
+    ThreadTrace& trace = getThreadTrace();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    TraceEvent& event = trace.events[trace.next];
+    event.name = name;
+    copyDetail(event.detail, detail);
+    event.async = async;
+    event.startTime = startTime;
+    event.endTime = endTime;
+    if (++trace.next == trace.events.size()) {
+        trace.next = 0;
+        trace.wrapped = true;
+    }
+}
+
+double toTraceMicros(Tracing::TimePoint time) {
+    return std::chrono::duration<double, std::micro>(time - traceStart).count();
+}
+
+}
+
+std::atomic<bool> Tracing::enabled(false);
+
+void Tracing::start() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& trace : threadTraces) {
+        std::lock_guard<std::mutex> threadLock(trace->mutex);
+        trace->next = 0;
+        trace->wrapped = false;
+    }
+    traceStart = std::chrono::steady_clock::now();
+    enabled = true;
+}
+
+void Tracing::stop() {
+    enabled = false;
+}
+
+void Tracing::setThreadName(const char* name) {
+    currentThreadName = name;
+    if (currentThreadTrace) {
+        std::lock_guard<std::mutex> lock(currentThreadTrace->mutex);
+        currentThreadTrace->threadName = name;
+    }
+}
+
+void Tracing::recordSpan(const char* name, const char* detail, TimePoint startTime, TimePoint endTime) {
+    record(name, detail, false, startTime, endTime);
+}
+
+void Tracing::recordAsyncSpan(const char* name, const char* detail, TimePoint startTime, TimePoint endTime) {
+    if (isEnabled()) {
+        record(name, detail, true, startTime, endTime);
+    }
+}
+
+bool Tracing::writeChromeTrace(const std::string& path) {
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    uint64_t asyncId = 0;
+
+    writer.StartObject();
+    writer.Key("displayTimeUnit");
+    writer.String("ms");
+    writer.Key("traceEvents");
+    writer.StartArray();
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& trace : threadTraces) {
+            std::lock_guard<std::mutex> threadLock(trace->mutex);
+            size_t count = trace->wrapped ? trace->events.size() : trace->next;
+            if (count == 0) {
+                continue;
+            }
+
+            writer.StartObject();
+            writer.Key("name"); writer.String("thread_name");
+            writer.Key("ph"); writer.String("M");
+            writer.Key("pid"); writer.Int(1);
+            writer.Key("tid"); writer.Int(trace->threadId);
+            writer.Key("args");
+            writer.StartObject();
+            writer.Key("name"); writer.String(trace->threadName.c_str());
+            writer.EndObject();
+            writer.EndObject();
+
+            // Oldest first
+            size_t first = trace->wrapped ? trace->next : 0;
+            for (size_t i = 0; i < count; i++) {
+                const TraceEvent& event = trace->events[(first + i) % trace->events.size()];
+                if (event.startTime < traceStart) {
+                    continue;
+                }
+                double startMicros = toTraceMicros(event.startTime);
+                double endMicros = toTraceMicros(event.endTime);
+
+                if (!event.async) {
+                    writer.StartObject();
+                    writer.Key("name"); writer.String(event.name);
+                    writer.Key("ph"); writer.String("X");
+                    writer.Key("ts"); writer.Double(startMicros);
+                    writer.Key("dur"); writer.Double(endMicros - startMicros);
+                    writer.Key("pid"); writer.Int(1);
+                    writer.Key("tid"); writer.Int(trace->threadId);
+                    if (event.detail[0] != '\0') {
+                        writer.Key("args");
+                        writer.StartObject();
+                        writer.Key("detail"); writer.String(event.detail);
+                        writer.EndObject();
+                    }
+                    writer.EndObject();
+                    continue;
+                }
+
+                // Async spans are a begin/end pair sharing an id
+                asyncId++;
+                for (int phase = 0; phase < 2; phase++) {
+                    writer.StartObject();
+                    writer.Key("name"); writer.String(event.name);
+                    writer.Key("cat"); writer.String(event.name);
+                    writer.Key("ph"); writer.String(phase == 0 ? "b" : "e");
+                    writer.Key("id"); writer.Uint64(asyncId);
+                    writer.Key("ts"); writer.Double(phase == 0 ? startMicros : endMicros);
+                    writer.Key("pid"); writer.Int(1);
+                    writer.Key("tid"); writer.Int(trace->threadId);
+                    if (phase == 0 && event.detail[0] != '\0') {
+                        writer.Key("args");
+                        writer.StartObject();
+                        writer.Key("detail"); writer.String(event.detail);
+                        writer.EndObject();
+                    }
+                    writer.EndObject();
+                }
+            }
+        }
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file.write(buffer.GetString(), buffer.GetSize());
+    return (bool)file;
+}
+
+TraceSpan::TraceSpan(const char* name, const std::string& detail) : name(Tracing::isEnabled() ? name : nullptr) {
+    if (this->name) {
+        copyDetail(this->detail, detail.c_str());
+        startTime = std::chrono::steady_clock::now();
+    }
+}
+
+TraceSpan::TraceSpan(const char* name, int id) : name(Tracing::isEnabled() ? name : nullptr) {
+    if (this->name) {
+        snprintf(detail, sizeof(detail), "%d", id);
+        startTime = std::chrono::steady_clock::now();
+    }
+}
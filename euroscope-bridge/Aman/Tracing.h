@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Timing spans for looking at where a tick goes in chrome://tracing or ui.perfetto.dev.
+// Every thread records into its own ring buffer; the newest spans win when it is full.
+// While tracing is off a span costs one relaxed atomic load.
+class Tracing {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    // Starts a new trace, discarding anything recorded before
+    static void start();
+    static void stop();
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Writes what the threads recorded since start() as Chrome trace event JSON
+    static bool writeChromeTrace(const std::string& path);
+
+    // Label for the calling thread's track in the trace
+    static void setThreadName(const char* name);
+
+    // `name` must be a string literal; `detail` is truncated to a few characters
+    static void recordSpan(const char* name, const char* detail, TimePoint startTime, TimePoint endTime);
+    // A span that overlaps others on the same thread, such as a frame waiting in a send queue
+    static void recordAsyncSpan(const char* name, const char* detail, TimePoint startTime, TimePoint endTime);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Records the time from construction to destruction, if tracing was on when it was constructed
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name(Tracing::isEnabled() ? name : nullptr) {
+        if (this->name) {
+            detail[0] = '\0';
+            startTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    TraceSpan(const char* name, const std::string& detail);
+    TraceSpan(const char* name, int id);
+
+    ~TraceSpan() {
+        end();
+    }
+
+    // Ends the span before the end of its scope
+    void end() {
+        if (name) {
+            Tracing::recordSpan(name, detail, startTime, std::chrono::steady_clock::now());
+            name = nullptr;
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    char detail[24];
+    Tracing::TimePoint startTime;
+};
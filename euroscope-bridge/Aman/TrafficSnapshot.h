@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AmanDataTypes.h"
+
+// Everything one tick publishes, copied out of the EuroScope API on its thread so that the
+// serialization can happen elsewhere. Snapshots are recycled: the vectors only ever grow and the
+// counts say how much of them is in use, so the strings and routes of earlier ticks are assigned
+// over instead of being freed and allocated again.
+struct TrafficSnapshot {
+    struct Inbound {
+        AmanAircraft aircraft;
+        uint64_t revision = 0;          // AircraftStateCache::Record::revision it was copied at
+    };
+
+    struct Airport {
+        std::string icao;
+        std::vector<Inbound> inbounds;
+        size_t inboundCount = 0;
+        std::vector<DmanAircraft> outbounds;
+        size_t outboundCount = 0;
+    };
+
+    int counter = 0;                    // OnTimer's
+    std::vector<Airport> airports;      // Subscribed ones, sorted by ICAO
+    size_t airportCount = 0;
+    bool hasController = false;
+    ControllerInfo controller;
+};
+
+// Next element of a recycled vector, holding whatever was last written to it
+template <typename T>
+T& recycleNext(std::vector<T>& items, size_t& count) {
+    if (count == items.size()) {
+        items.emplace_back();
+    }
+    return items[count++];
+}
@@ -0,0 +1,302 @@
+#include "stdafx.h"
+#include "WireCodec.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "rapidjson/reader.h"
+
+using namespace rapidjson;
+
+namespace {
+
+enum CborMajorType : uint8_t {
+    CborUnsigned = 0,
+    CborNegative = 1,
+    CborText = 3,
+    CborArray = 4,
+    CborMap = 5,
+    CborSimple = 7
+};
+
+const uint8_t CBOR_FALSE = 0xf4;
+const uint8_t CBOR_TRUE = 0xf5;
+const uint8_t CBOR_NULL = 0xf6;
+const uint8_t CBOR_FLOAT32 = 0xfa;
+const uint8_t CBOR_FLOAT64 = 0xfb;
+
+const size_t LENGTH_PREFIX_BYTES = 4;
+
+void appendBigEndian(std::string& out, uint64_t value, int bytes) {
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        out.push_back((char)(uint8_t)(value >> shift));
+    }
+}
+
+// Bytes following the initial byte for an argument of this size
+int argumentBytes(uint64_t value) {
+    if (value < 24) {
+        return 0;
+    }
+    if (value <= 0xff) {
+        return 1;
+    }
+    if (value <= 0xffff) {
+        return 2;
+    }
+    return value <= 0xffffffff ? 4 : 8;
+}
+
+void appendHead(std::string& out, CborMajorType major, uint64_t value) {
+    int bytes = argumentBytes(value);
+    // 24, 25, 26, 27 announce a 1, 2, 4 or 8 byte argument
+    static const uint8_t ADDITIONAL_INFO[] = { 0, 24, 25, 0, 26, 0, 0, 0, 27 };
+    uint8_t additional = bytes == 0 ? (uint8_t)value : ADDITIONAL_INFO[bytes];
+    out.push_back((char)(uint8_t)((major << 5) | additional));
+    appendBigEndian(out, value, bytes);
+}
+
+bool appendCbor(const std::string& json, std::string& out) {
+    CborWriter writer(out);
+    Reader reader;
+    StringStream stream(json.c_str());
+    return !reader.Parse<kParseNumbersAsStringsFlag | kParseStopWhenDoneFlag>(stream, writer).IsError();
+}
+
+void writeLengthPrefix(std::string& out) {
+    uint64_t length = out.size() - LENGTH_PREFIX_BYTES;
+    for (size_t i = 0; i < LENGTH_PREFIX_BYTES; i++) {
+        out[i] = (char)(uint8_t)(length >> ((LENGTH_PREFIX_BYTES - 1 - i) * 8));
+    }
+}
+
+// Reads the head of a CBOR item at `pos`; false if it is not of the expected major type
+bool readHead(const std::string& data, size_t& pos, CborMajorType major, uint64_t& value) {
+    if (pos >= data.size() || (uint8_t)data[pos] >> 5 != major) {
+        return false;
+    }
+    uint8_t additional = (uint8_t)data[pos++] & 0x1f;
+    if (additional < 24) {
+        value = additional;
+        return true;
+    }
+    if (additional > 27) {
+        return false;
+    }
+    int bytes = 1 << (additional - 24);
+    if (pos + bytes > data.size()) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | (uint8_t)data[pos++];
+    }
+    return true;
+}
+
+bool readText(const std::string& data, size_t& pos, std::string& text) {
+    uint64_t length;
+    if (!readHead(data, pos, CborText, length) || length > data.size() - pos) {
+        return false;
+    }
+    text.assign(data, pos, (size_t)length);
+    pos += (size_t)length;
+    return true;
+}
+
+}
+
+bool CborWriter::Null() {
+    countItem();
+    out.push_back((char)CBOR_NULL);
+    return true;
+}
+
+bool CborWriter::Bool(bool value) {
+    countItem();
+    out.push_back((char)(value ? CBOR_TRUE : CBOR_FALSE));
+    return true;
+}
+
+bool CborWriter::Int64(int64_t value) {
+    countItem();
+    if (value < 0) {
+        appendHead(out, CborNegative, (uint64_t)(-1 - value));
+    } else {
+        appendHead(out, CborUnsigned, (uint64_t)value);
+    }
+    return true;
+}
+
+bool CborWriter::Uint64(uint64_t value) {
+    countItem();
+    appendHead(out, CborUnsigned, value);
+    return true;
+}
+
+bool CborWriter::Double(double value) {
+    countItem();
+    float narrow = (float)value;
+    if ((double)narrow == value) {
+        uint32_t bits;
+        memcpy(&bits, &narrow, sizeof(bits));
+        out.push_back((char)CBOR_FLOAT32);
+        appendBigEndian(out, bits, 4);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        out.push_back((char)CBOR_FLOAT64);
+        appendBigEndian(out, bits, 8);
+    }
+    return true;
+}
+
+// from_chars reads doubles back exactly, like kParseFullPrecisionFlag, at a fraction of its cost
+bool CborWriter::RawNumber(const char* text, unsigned length, bool) {
+    const char* end = text + length;
+    if (std::find_if(text, end, [](char c) { return c == '.' || c == 'e' || c == 'E'; }) == end) {
+        if (text[0] == '-') {
+            int64_t value;
+            if (std::from_chars(text, end, value).ec == std::errc()) {
+                return Int64(value);
+            }
+        } else {
+            uint64_t value;
+            if (std::from_chars(text, end, value).ec == std::errc()) {
+                return Uint64(value);
+            }
+        }
+    }
+    double value;
+    if (std::from_chars(text, end, value).ec != std::errc()) {
+        return false;
+    }
+    return Double(value);
+}
+
+bool CborWriter::String(const char* value, unsigned length, bool) {
+    countItem();
+    appendHead(out, CborText, length);
+    out.append(value, length);
+    return true;
+}
+
+bool CborWriter::StartObject() {
+    return startContainer(CborMap);
+}
+
+bool CborWriter::EndObject(unsigned) {
+    return endContainer(CborMap, openContainers[depth - 1].items / 2);
+}
+
+bool CborWriter::StartArray() {
+    return startContainer(CborArray);
+}
+
+bool CborWriter::EndArray(unsigned) {
+    return endContainer(CborArray, openContainers[depth - 1].items);
+}
+
+void CborWriter::countItem() {
+    if (depth > 0) {
+        openContainers[depth - 1].items++;
+    }
+}
+
+bool CborWriter::startContainer(int majorType) {
+    if (depth == MAX_DEPTH) {
+        return false;
+    }
+    countItem();
+    openContainers[depth++] = { out.size(), 0 };
+    out.push_back((char)(uint8_t)(majorType << 5));
+    return true;
+}
+
+bool CborWriter::endContainer(int majorType, uint64_t length) {
+    size_t headOffset = openContainers[--depth].headOffset;
+
+    std::string head;
+    appendHead(head, (CborMajorType)majorType, length);
+    out[headOffset] = head[0];
+    if (head.size() > 1) {
+        out.insert(headOffset + 1, head, 1, std::string::npos);
+    }
+    return true;
+}
+
+bool parseWireCodec(const std::string& name, WireCodec& codec) {
+    if (name == "json") {
+        codec = CodecJson;
+        return true;
+    }
+    if (name == "cbor") {
+        codec = CodecCbor;
+        return true;
+    }
+    return false;
+}
+
+const char* wireCodecName(WireCodec codec) {
+    return codec == CodecCbor ? "cbor" : "json";
+}
+
+bool encodeCborFrame(const std::string& json, std::string& out) {
+    out.clear();
+    out.reserve(json.size());
+    out.append(LENGTH_PREFIX_BYTES, '\0');
+    if (!appendCbor(json, out)) {
+        out.clear();
+        return false;
+    }
+    writeLengthPrefix(out);
+    return true;
+}
+
+bool encodeCborFrameWithItems(const std::string& json, const std::vector<const std::string*>& items, std::string& out) {
+    size_t itemBytes = 0;
+    for (auto item : items) {
+        itemBytes += item->size();
+    }
+
+    out.clear();
+    out.reserve(json.size() + itemBytes + 8);
+    out.append(LENGTH_PREFIX_BYTES, '\0');
+    // The empty array is the last byte of the encoded message; its head is replaced by the real one
+    if (!appendCbor(json, out) || (uint8_t)out.back() != (CborArray << 5)) {
+        out.clear();
+        return false;
+    }
+    out.pop_back();
+    appendHead(out, CborArray, items.size());
+    for (auto item : items) {
+        out.append(*item);
+    }
+    writeLengthPrefix(out);
+    return true;
+}
+
+std::string frameMessageType(const std::string& frame) {
+    if (!isCborFrame(frame)) {
+        static const char prefix[] = "{\"type\":\"";
+        const size_t prefixLength = sizeof(prefix) - 1;
+        if (frame.compare(0, prefixLength, prefix) != 0) {
+            return "unknown";
+        }
+        size_t end = frame.find('"', prefixLength);
+        return end == std::string::npos ? "unknown" : frame.substr(prefixLength, end - prefixLength);
+    }
+
+    size_t pos = LENGTH_PREFIX_BYTES;
+    uint64_t memberCount;
+    std::string key;
+    std::string type;
+    if (!readHead(frame, pos, CborMap, memberCount) || memberCount == 0
+        || !readText(frame, pos, key) || key != "type" || !readText(frame, pos, type)) {
+        return "unknown";
+    }
+    return type;
+}
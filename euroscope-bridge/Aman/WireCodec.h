@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// How the bridge encodes the messages it sends to a client. Every client starts out with JSON and
+// may switch with {"type":"selectCodec","codec":"cbor"}; the bridge answers with a codecSelected
+// message, which is the last one in the previous codec. Messages from clients are always
+// newline-delimited JSON.
+enum WireCodec {
+    CodecJson,      // One JSON object per line
+    CodecCbor       // CBOR (RFC 8949), each message preceded by its length as a 4-byte big-endian integer
+};
+
+const int WIRE_CODEC_COUNT = 2;
+
+bool parseWireCodec(const std::string& name, WireCodec& codec);
+const char* wireCodecName(WireCodec codec);
+
+// Writes CBOR through the same calls as rapidjson::Writer, so the serializer's templates can
+// produce either encoding, and it can take the events of a rapidjson::Reader. Container sizes are
+// only known at the end, so each container gets a one byte head that is widened in place if it
+// holds 24 or more items.
+class CborWriter {
+public:
+    // Deepest nesting accepted, as in rapidjson::Writer by default
+    static const size_t MAX_DEPTH = 32;
+
+    // Appends to `out`
+    explicit CborWriter(std::string& out) : out(out), depth(0) {}
+
+    bool Null();
+    bool Bool(bool value);
+    bool Int(int value) { return Int64(value); }
+    bool Uint(unsigned value) { return Uint64(value); }
+    bool Int64(int64_t value);
+    bool Uint64(uint64_t value);
+    bool Double(double value);
+    // Text of a number, from a reader with kParseNumbersAsStringsFlag
+    bool RawNumber(const char* text, unsigned length, bool copy);
+    bool String(const char* value, unsigned length, bool copy = false);
+    bool Key(const char* value, unsigned length, bool copy = false) { return String(value, length, copy); }
+    bool Key(const char* value) { return String(value, (unsigned)strlen(value)); }
+
+    // Counts are taken from what was written, so callers may leave them out
+    bool StartObject();
+    bool EndObject(unsigned memberCount = 0);
+    bool StartArray();
+    bool EndArray(unsigned elementCount = 0);
+
+private:
+    struct OpenContainer {
+        size_t headOffset;
+        uint64_t items;     // Keys and values
+    };
+
+    void countItem();
+    bool startContainer(int majorType);
+    bool endContainer(int majorType, uint64_t length);
+
+    std::string& out;
+    // Fixed, so that writing allocates nothing beyond `out`
+    OpenContainer openContainers[MAX_DEPTH];
+    size_t depth;
+};
+
+// Re-encodes a message written by JsonMessageHelper as a length-prefixed CBOR frame, replacing
+// `out`. The structure is kept as is: objects become maps with their keys in the same order,
+// integers the shortest CBOR integer, and doubles a float32 when that is exact, else a float64.
+bool encodeCborFrame(const std::string& json, std::string& out);
+// Frame of a message whose last member is an array of values already encoded as CBOR, such as
+// the cached aircraft of an arrivals message. `json` is the message with that array empty.
+bool encodeCborFrameWithItems(const std::string& json, const std::vector<const std::string*>& items, std::string& out);
+
+// A JSON frame always starts with '{'. A CBOR frame starts with the high byte of its length,
+// which is never '{' for the frame sizes the send queues allow.
+inline bool isCborFrame(const std::string& frame) {
+    return !frame.empty() && frame[0] != '{';
+}
+
+// Bytes of the frame on the wire, the newline after a JSON frame included
+inline size_t frameWireSize(const std::string& frame) {
+    return isCborFrame(frame) ? frame.size() : frame.size() + 1;
+}
+
+// "type" of a frame in either codec, which the serializer always writes first; "unknown" if missing
+std::string frameMessageType(const std::string& frame);
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #ifndef VC_EXTRALEAN
 #define VC_EXTRALEAN            // Exclude rarely-used stuff from Windows headers
 #endif
@@ -36,4 +38,9 @@
 #include <afxcmn.h>                     // MFC support for Windows Common Controls
 #endif // _AFX_NO_AFXCMN_SUPPORT
 
+#else
+
+// Portable build against the fake EuroScope runtime, see fake-euroscope/
+#include <windows.h>
 
+#endif // _WIN32
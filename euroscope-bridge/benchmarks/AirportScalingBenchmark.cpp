@@ -0,0 +1,244 @@
+#include "FakeEuroScope.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// OnTimer against the number of subscribed airports, with the traffic the same throughout:
+// 2000 aircraft spread over 50 airports, 25 arrivals and 15 departures each. One client subscribes
+// to 1, then 10, then all 50 of them. Each tick moves a fifth of the radar targets, as a five
+// second radar update would, and the timer is measured on the EuroScope thread. With one pass over
+// the traffic per tick, OnTimer grows with the aircraft at the subscribed airports rather than
+// with airports times traffic.
+//
+//   aman-airport-scaling-benchmark [--ticks N]
+
+static const int BRIDGE_PORT = 12345;
+static const int AIRPORTS = 50;
+static const int ARRIVALS_PER_AIRPORT = 25;
+static const int DEPARTURES_PER_AIRPORT = 15;
+static const int ROUTE_POINTS = 12;
+static const int RADAR_INTERVAL_TICKS = 5;
+static const int WARM_UP_TICKS = 10;
+static const int DEFAULT_MEASURED_TICKS = 100;
+
+// A client that subscribes to airports and reads whatever it is sent until the socket closes
+class SubscribingClient {
+public:
+    bool connect() {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(BRIDGE_PORT);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        // The server thread may not be listening yet
+        for (int attempt = 0; attempt < 50; attempt++) {
+            socketFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (::connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+                reader = std::thread([this] { drain(); });
+                return true;
+            }
+            close(socketFd);
+            socketFd = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+
+    void subscribe(const std::string& icao) {
+        std::string line = "{\"type\":\"registerAirport\",\"icao\":\"" + icao + "\"}\n";
+        send(socketFd, line.data(), line.size(), 0);
+    }
+
+    void disconnect() {
+        if (socketFd >= 0) {
+            shutdown(socketFd, SHUT_RDWR);
+        }
+        if (reader.joinable()) {
+            reader.join();
+        }
+        if (socketFd >= 0) {
+            close(socketFd);
+            socketFd = -1;
+        }
+    }
+
+    uint64_t getBytesReceived() const { return bytesReceived; }
+
+private:
+    void drain() {
+        char buffer[64 * 1024];
+        ssize_t received;
+        while ((received = recv(socketFd, buffer, sizeof(buffer), 0)) > 0) {
+            bytesReceived += received;
+        }
+    }
+
+    int socketFd = -1;
+    std::thread reader;
+    std::atomic<uint64_t> bytesReceived{ 0 };
+};
+
+static std::string airportIcao(int index) {
+    std::string icao = "EA";
+    icao += static_cast<char>('A' + index / 26);
+    icao += static_cast<char>('A' + index % 26);
+    return icao;
+}
+
+static double airportLatitude(int index) {
+    return 45.0 + (index % 10) * 1.5;
+}
+
+static double airportLongitude(int index) {
+    return 0.0 + (index / 10) * 3.0;
+}
+
+// Fixed traffic, the same on every run; arrivals come from the airport before theirs
+static void populate(FakeTraffic& traffic) {
+    time_t now = time(nullptr);
+    std::tm utc = *gmtime(&now);
+    char eobt[8];
+    std::snprintf(eobt, sizeof(eobt), "%02d%02d", utc.tm_hour, utc.tm_min);
+
+    for (int a = 0; a < AIRPORTS; a++) {
+        traffic.airports.push_back(airportIcao(a));
+    }
+
+    for (int a = 0; a < AIRPORTS; a++) {
+        double latitude = airportLatitude(a);
+        double longitude = airportLongitude(a);
+        for (int i = 0; i < ARRIVALS_PER_AIRPORT; i++) {
+            FakeAircraft inbound;
+            inbound.callsign = "ARR" + std::to_string(a * 100 + i);
+            inbound.origin = airportIcao((a + AIRPORTS - 1) % AIRPORTS);
+            inbound.destination = airportIcao(a);
+            inbound.icaoType = i % 2 == 0 ? "B738" : "A320";
+            inbound.trueAirspeed = 430;
+            inbound.starName = "STAR" + std::to_string(i % 4);
+            inbound.arrivalRunway = "09";
+            double bearing = i * 2 * M_PI / ARRIVALS_PER_AIRPORT;
+            for (int p = 0; p < ROUTE_POINTS; p++) {
+                double distance = (ROUTE_POINTS - p) * 0.15;
+                FakeRoutePoint point;
+                point.name = "P" + std::to_string(a) + "X" + std::to_string(i % 4) + "Y" + std::to_string(p);
+                point.latitude = latitude + distance * std::cos(bearing);
+                point.longitude = longitude + distance * std::sin(bearing);
+                inbound.routePoints.push_back(point);
+            }
+            inbound.pointsCalculatedIndex = i % 4;
+            inbound.latitude = inbound.routePoints[inbound.pointsCalculatedIndex].latitude;
+            inbound.longitude = inbound.routePoints[inbound.pointsCalculatedIndex].longitude;
+            inbound.pressureAltitude = 6000 + i * 400;
+            inbound.flightLevel = inbound.pressureAltitude;
+            inbound.groundSpeed = 220 + i * 4;
+            inbound.trackHeading = std::fmod(bearing * 180 / M_PI + 180, 360);
+            traffic.add(inbound);
+        }
+        for (int i = 0; i < DEPARTURES_PER_AIRPORT; i++) {
+            FakeAircraft outbound;
+            outbound.callsign = "DEP" + std::to_string(a * 100 + i);
+            outbound.origin = airportIcao(a);
+            outbound.destination = airportIcao((a + 1) % AIRPORTS);
+            outbound.icaoType = "A320";
+            outbound.sidName = "SID" + std::to_string(i % 3);
+            outbound.departureRunway = "27";
+            outbound.estimatedDepartureTime = eobt;
+            outbound.latitude = latitude;
+            outbound.longitude = longitude;
+            traffic.add(outbound);
+        }
+    }
+}
+
+// A fifth of the arrivals get a new radar position each tick
+static void advance(FakeTraffic& traffic, int tick) {
+    int index = 0;
+    for (auto& entry : traffic.getAircraft()) {
+        FakeAircraft& aircraft = entry.second;
+        if (aircraft.groundSpeed == 0 || index++ % RADAR_INTERVAL_TICKS != tick % RADAR_INTERVAL_TICKS) {
+            continue;
+        }
+        double step = aircraft.groundSpeed / 3600.0 * RADAR_INTERVAL_TICKS / 60.0;
+        double heading = aircraft.trackHeading * M_PI / 180;
+        aircraft.latitude += step * std::cos(heading);
+        aircraft.longitude += step * std::sin(heading);
+        FakeEuroScope::radarTargetPositionUpdate(entry.first);
+    }
+}
+
+int main(int argc, char** argv) {
+    int measuredTicks = DEFAULT_MEASURED_TICKS;
+    if (argc >= 3 && std::string(argv[1]) == "--ticks") {
+        measuredTicks = std::max(1, std::atoi(argv[2]));
+    }
+
+    auto& traffic = FakeEuroScope::traffic();
+    FakeEuroScope::loadPlugIn();
+    populate(traffic);
+
+    SubscribingClient client;
+    if (!client.connect()) {
+        std::fprintf(stderr, "Cannot connect to the bridge on port %d\n", BRIDGE_PORT);
+        return 2;
+    }
+
+    std::printf("%d aircraft at %d airports, %d ticks per step\n", AIRPORTS * (ARRIVALS_PER_AIRPORT + DEPARTURES_PER_AIRPORT),
+        AIRPORTS, measuredTicks);
+    std::printf("%-10s %12s %12s %12s %14s\n", "airports", "mean us", "p50 us", "p99 us", "bytes/tick");
+
+    const int steps[] = { 1, 10, 50 };
+    int subscribed = 0;
+    int tick = 0;
+    for (int airports : steps) {
+        while (subscribed < airports) {
+            client.subscribe(airportIcao(subscribed++));
+        }
+        // Lets the I/O thread queue the registrations for the next OnTimer
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        std::vector<double> timerMicros;
+        uint64_t bytesBefore = 0;
+        for (int i = 0; i < WARM_UP_TICKS + measuredTicks; i++) {
+            tick++;
+            advance(traffic, tick);
+            if (i == WARM_UP_TICKS) {
+                bytesBefore = client.getBytesReceived();
+            }
+            auto started = std::chrono::steady_clock::now();
+            FakeEuroScope::timer(tick);
+            if (i >= WARM_UP_TICKS) {
+                timerMicros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count());
+            }
+            // Lets the publisher and I/O threads finish the tick, as the one-second timer would
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        uint64_t bytes = client.getBytesReceived() - bytesBefore;
+
+        std::sort(timerMicros.begin(), timerMicros.end());
+        double total = 0;
+        for (double micros : timerMicros) {
+            total += micros;
+        }
+        std::printf("%-10d %12.1f %12.1f %12.1f %14llu\n", airports, total / timerMicros.size(),
+            timerMicros[timerMicros.size() / 2], timerMicros[timerMicros.size() * 99 / 100],
+            static_cast<unsigned long long>(bytes / measuredTicks));
+    }
+
+    client.disconnect();
+    FakeEuroScope::unloadPlugIn();
+    return 0;
+}
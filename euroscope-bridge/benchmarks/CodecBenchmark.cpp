@@ -0,0 +1,355 @@
+#include "FakeEuroScope.h"
+#include "FrameCompression.h"
+#include "ScenarioGenerator.h"
+#include "WireCodec.h"
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Frame size and encode/decode CPU of JSON, CBOR and LZ4 (see FrameCompression.h) on the messages
+// the plugin publishes for a scenario. Two clients collect the JSON frames, one taking full
+// arrivals and departures, one the delta streams. Each frame is then timed per codec:
+//   encode: a rapidjson DOM of the message written with rapidjson::Writer or CborWriter
+//   decode: the frame read back into a rapidjson DOM, JSON doubles at full precision as CBOR's are
+//   lz4:    compressBlock / decompressBlock of the JSON and of the CBOR frame
+// The plugin itself writes most messages without a DOM, so the encode columns compare the two
+// writers rather than the publishing path.
+//
+//   aman-codec-benchmark SCENARIO [--ticks N]
+//
+// Exits non-zero if a CBOR frame does not decode to the same document as its JSON twin.
+
+static const int BRIDGE_PORT = 12345;
+// Each measurement repeats its frames until at least this much time has passed
+static const double MIN_MEASURE_MILLIS = 50;
+
+// Collects the newline-delimited JSON frames one client receives
+class CollectingClient {
+public:
+    bool connect(const std::string& registerMessage) {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(BRIDGE_PORT);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        for (int attempt = 0; attempt < 50; attempt++) {
+            socketFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (::connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+                std::string line = registerMessage + "\n";
+                send(socketFd, line.data(), line.size(), 0);
+                reader = std::thread([this] { collect(); });
+                return true;
+            }
+            close(socketFd);
+            socketFd = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+
+    void disconnect() {
+        if (socketFd >= 0) {
+            shutdown(socketFd, SHUT_RDWR);
+        }
+        if (reader.joinable()) {
+            reader.join();
+        }
+        if (socketFd >= 0) {
+            close(socketFd);
+            socketFd = -1;
+        }
+    }
+
+    std::vector<std::string> takeFrames() {
+        std::lock_guard<std::mutex> lock(framesMutex);
+        return std::move(frames);
+    }
+
+private:
+    void collect() {
+        std::string pending;
+        char buffer[64 * 1024];
+        ssize_t received;
+        while ((received = recv(socketFd, buffer, sizeof(buffer), 0)) > 0) {
+            pending.append(buffer, received);
+            size_t start = 0;
+            size_t newline;
+            while ((newline = pending.find('\n', start)) != std::string::npos) {
+                std::lock_guard<std::mutex> lock(framesMutex);
+                frames.push_back(pending.substr(start, newline - start));
+                start = newline + 1;
+            }
+            pending.erase(0, start);
+        }
+    }
+
+    int socketFd = -1;
+    std::thread reader;
+    std::mutex framesMutex;
+    std::vector<std::string> frames;
+};
+
+// Reads a CBOR frame as written by CborWriter (definite lengths, text keys) into SAX events, for
+// rapidjson::Document::Populate()
+class CborFrameParser {
+public:
+    CborFrameParser(const std::string& frame) : next(reinterpret_cast<const uint8_t*>(frame.data()) + 4),
+        end(reinterpret_cast<const uint8_t*>(frame.data()) + frame.size()) {}
+
+    template <typename Handler>
+    bool operator()(Handler& handler) {
+        return value(handler) && next == end;
+    }
+
+private:
+    bool head(int& majorType, uint64_t& argument, uint8_t& initial) {
+        if (next >= end) {
+            return false;
+        }
+        initial = *next++;
+        majorType = initial >> 5;
+        int info = initial & 0x1f;
+        if (info < 24) {
+            argument = info;
+            return true;
+        }
+        if (info > 27) {
+            return false;
+        }
+        size_t length = size_t(1) << (info - 24);
+        if (static_cast<size_t>(end - next) < length) {
+            return false;
+        }
+        argument = 0;
+        for (size_t i = 0; i < length; i++) {
+            argument = argument << 8 | *next++;
+        }
+        return true;
+    }
+
+    template <typename Handler>
+    bool value(Handler& handler) {
+        int majorType;
+        uint64_t argument;
+        uint8_t initial;
+        if (!head(majorType, argument, initial)) {
+            return false;
+        }
+        switch (majorType) {
+        case 0:
+            return handler.Uint64(argument);
+        case 1:
+            return handler.Int64(-1 - static_cast<int64_t>(argument));
+        case 3: {
+            if (static_cast<uint64_t>(end - next) < argument) {
+                return false;
+            }
+            const char* text = reinterpret_cast<const char*>(next);
+            next += argument;
+            return handler.String(text, static_cast<rapidjson::SizeType>(argument), true);
+        }
+        case 4:
+            handler.StartArray();
+            for (uint64_t i = 0; i < argument; i++) {
+                if (!value(handler)) {
+                    return false;
+                }
+            }
+            return handler.EndArray(static_cast<rapidjson::SizeType>(argument));
+        case 5:
+            handler.StartObject();
+            for (uint64_t i = 0; i < argument; i++) {
+                if (!value(handler) || !value(handler)) {
+                    return false;
+                }
+            }
+            return handler.EndObject(static_cast<rapidjson::SizeType>(argument));
+        case 7:
+            if (initial == 0xf4 || initial == 0xf5) {
+                return handler.Bool(initial == 0xf5);
+            }
+            if (initial == 0xf6) {
+                return handler.Null();
+            }
+            if (initial == 0xfa) {
+                uint32_t bits = static_cast<uint32_t>(argument);
+                float single;
+                std::memcpy(&single, &bits, sizeof(single));
+                return handler.Double(single);
+            }
+            if (initial == 0xfb) {
+                double full;
+                std::memcpy(&full, &argument, sizeof(full));
+                return handler.Double(full);
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    const uint8_t* next;
+    const uint8_t* end;
+};
+
+// Microseconds per frame of `call`, run over all frames as often as MIN_MEASURE_MILLIS takes
+template <typename Call>
+static double measure(size_t frames, Call call) {
+    size_t calls = 0;
+    auto started = std::chrono::steady_clock::now();
+    double elapsedMillis = 0;
+    do {
+        for (size_t i = 0; i < frames; i++) {
+            call(i);
+        }
+        calls += frames;
+        elapsedMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    } while (elapsedMillis < MIN_MEASURE_MILLIS);
+    return elapsedMillis * 1000 / calls;
+}
+
+static double percentOf(size_t part, size_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: aman-codec-benchmark SCENARIO [--ticks N]\n");
+        return 2;
+    }
+    int ticks = 20;
+    if (argc >= 4 && std::strcmp(argv[2], "--ticks") == 0) {
+        ticks = std::atoi(argv[3]);
+    }
+
+    ScenarioGenerator generator;
+    std::string error;
+    if (!generator.load(argv[1], error)) {
+        std::fprintf(stderr, "Cannot load scenario: %s\n", error.c_str());
+        return 2;
+    }
+    auto& traffic = FakeEuroScope::traffic();
+    FakeEuroScope::loadPlugIn();
+    generator.populate(traffic);
+
+    // Every airport of the scenario, once as full messages and once as delta streams
+    std::string fullRegistrations;
+    std::string deltaRegistrations;
+    for (auto& icao : traffic.airports) {
+        fullRegistrations += (fullRegistrations.empty() ? "" : "\n") + std::string("{\"type\":\"registerAirport\",\"icao\":\"") + icao + "\"}";
+        deltaRegistrations += (deltaRegistrations.empty() ? "" : "\n") + std::string("{\"type\":\"registerAirport\",\"icao\":\"") + icao
+            + "\",\"arrivalsDelta\":true,\"departuresDelta\":true}";
+    }
+    CollectingClient clients[2];
+    if (!clients[0].connect(fullRegistrations) || !clients[1].connect(deltaRegistrations)) {
+        std::fprintf(stderr, "Cannot connect to the bridge on port %d\n", BRIDGE_PORT);
+        return 2;
+    }
+
+    // Every frame counts, the delta streams' first snapshot and dictionary included
+    for (int tick = 1; tick <= ticks; tick++) {
+        generator.advance(traffic);
+        FakeEuroScope::timer(tick);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    FakeEuroScope::unloadPlugIn();
+
+    std::map<std::string, std::vector<std::string>> framesByType;
+    for (auto& client : clients) {
+        client.disconnect();
+        for (auto& frame : client.takeFrames()) {
+            framesByType[frameMessageType(frame)].push_back(std::move(frame));
+        }
+    }
+
+    std::printf("%s, %zu aircraft, %d ticks\n\n", argv[1], generator.getAircraftCount(), ticks);
+    std::printf("%-18s %6s %10s %6s %9s %9s | %8s %8s | %8s %8s | %8s %8s\n", "message", "frames", "JSON B", "CBOR",
+        "LZ4 JSON", "LZ4 CBOR", "enc JSON", "enc CBOR", "dec JSON", "dec CBOR", "lz4 c", "lz4 d");
+    std::printf("%-18s %6s %10s %6s %9s %9s | %17s | %17s | %17s\n", "", "", "avg", "%", "%", "%",
+        "us per frame", "us per frame", "us per JSON frame");
+
+    int mismatches = 0;
+    for (auto& entry : framesByType) {
+        auto& frames = entry.second;
+        size_t count = frames.size();
+        std::vector<std::string> cborFrames(count);
+        std::vector<std::string> compressedJson(count);
+        std::vector<rapidjson::Document> documents(count);
+        size_t jsonBytes = 0;
+        size_t cborBytes = 0;
+        size_t lz4JsonBytes = 0;
+        size_t lz4CborBytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            encodeCborFrame(frames[i], cborFrames[i]);
+            documents[i].Parse<rapidjson::kParseFullPrecisionFlag>(frames[i].data(), frames[i].size());
+            compressBlock(frames[i].data(), frames[i].size(), compressedJson[i]);
+            std::string compressedCbor;
+            compressBlock(cborFrames[i].data(), cborFrames[i].size(), compressedCbor);
+            jsonBytes += frameWireSize(frames[i]);
+            cborBytes += frameWireSize(cborFrames[i]);
+            lz4JsonBytes += compressedJson[i].size();
+            lz4CborBytes += compressedCbor.size();
+
+            rapidjson::Document decoded;
+            CborFrameParser parser(cborFrames[i]);
+            decoded.Populate(parser);
+            if (decoded.HasParseError() || decoded != documents[i]) {
+                mismatches++;
+            }
+        }
+
+        std::string out;
+        double encodeJson = measure(count, [&](size_t i) {
+            rapidjson::StringBuffer buffer;
+            rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+            documents[i].Accept(writer);
+        });
+        double encodeCbor = measure(count, [&](size_t i) {
+            out.clear();
+            CborWriter writer(out);
+            documents[i].Accept(writer);
+        });
+        double decodeJson = measure(count, [&](size_t i) {
+            rapidjson::Document document;
+            document.Parse<rapidjson::kParseFullPrecisionFlag>(frames[i].data(), frames[i].size());
+        });
+        double decodeCbor = measure(count, [&](size_t i) {
+            rapidjson::Document document;
+            CborFrameParser parser(cborFrames[i]);
+            document.Populate(parser);
+        });
+        double compress = measure(count, [&](size_t i) {
+            compressBlock(frames[i].data(), frames[i].size(), out);
+        });
+        double decompress = measure(count, [&](size_t i) {
+            decompressBlock(compressedJson[i].data(), compressedJson[i].size(), frames[i].size(), out);
+        });
+
+        std::printf("%-18s %6zu %10zu %5.0f%% %8.0f%% %8.0f%% | %8.1f %8.1f | %8.1f %8.1f | %8.1f %8.1f\n", entry.first.c_str(), count,
+            jsonBytes / count, percentOf(cborBytes, jsonBytes), percentOf(lz4JsonBytes, jsonBytes), percentOf(lz4CborBytes, jsonBytes),
+            encodeJson, encodeCbor, decodeJson, decodeCbor, compress, decompress);
+    }
+
+    if (mismatches > 0) {
+        std::fprintf(stderr, "%d CBOR frames do not decode to their JSON message\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include "JsonMessageHelper.h"
+
+#define RAPIDJSON_HAS_STDSTRING 1
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// The rapidjson DOM the plugin used to build for every message against JsonMessageHelper's
+// streaming writer, on synthetic arrivals with 40 route points each and on departures:
+//   Dom:       a Document with one Value per field and route point, written through Writer<StringBuffer>
+//   Streaming: JsonMessageHelper writing straight from the aircraft into a reused buffer
+//   Cached:    arrivals assembled from per-aircraft JSON, as published when few aircraft changed
+//
+//   aman-json-writer-benchmark [--benchmark_filter=...]
+//
+// Exits non-zero, before timing anything, if the two paths do not write the same JSON.
+
+using namespace rapidjson;
+
+static const int ROUTE_POINTS = 40;
+
+// Deterministic traffic around ENGM; the same count always gives the same aircraft
+static std::vector<AmanAircraft> makeArrivals(int count) {
+    static const char* const TYPES[] = { "B738", "A320", "A21N", "E190", "DH8D", "B77W" };
+    static const char* const STARS[] = { "ADOPI2C", "LUNIP1B", "", "RIPAM3A" };
+    std::vector<AmanAircraft> arrivals(count);
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+    for (int i = 0; i < count; i++) {
+        AmanAircraft& inbound = arrivals[i];
+        inbound.callsign = "SAS" + std::to_string(100 + i);
+        inbound.icaoType = TYPES[i % 6];
+        inbound.arrivalAirportIcao = "ENGM";
+        inbound.assignedStar = STARS[i % 4];
+        inbound.arrivalRunway = i % 3 == 0 ? "" : "01L";
+        inbound.scratchPad = i % 7 == 0 ? "HOLD" : "";
+        inbound.trackingController = i % 2 == 0 ? "ENOS_APP" : "";
+        inbound.isSelected = false;
+        inbound.latitude = 60.2f + (next() % 20000) / 10000.0f;
+        inbound.longitude = 11.1f + (next() % 20000) / 10000.0f;
+        inbound.groundSpeed = 250 + next() % 200;
+        inbound.pressureAltitude = 3000 + next() % 30000;
+        inbound.flightLevel = inbound.pressureAltitude + 120;
+        inbound.flightPlanTas = i % 5 == 0 ? 0 : 430;
+        inbound.track = next() % 360;
+        inbound.remainingRoute.resize(ROUTE_POINTS);
+        for (int p = 0; p < ROUTE_POINTS; p++) {
+            RouteFix& point = inbound.remainingRoute[p];
+            point.name = "FIX" + std::to_string((i + p) % 300);
+            point.latitude = 58.0 + (next() % 500000) / 100000.0;
+            point.longitude = 8.0 + (next() % 800000) / 100000.0;
+            point.isPassed = p < i % 5;
+            point.fixId = 0;
+        }
+    }
+    return arrivals;
+}
+
+static std::vector<DmanAircraft> makeDepartures(int count) {
+    std::vector<DmanAircraft> departures(count);
+    for (int i = 0; i < count; i++) {
+        DmanAircraft& outbound = departures[i];
+        outbound.departureAirportIcao = "ENGM";
+        outbound.callsign = "NOZ" + std::to_string(200 + i);
+        outbound.sid = i % 2 == 0 ? "GM1A" : "OSLO4X";
+        outbound.runway = i % 2 == 0 ? "01L" : "01R";
+        outbound.icaoType = i % 3 == 0 ? "B738" : "A320";
+        outbound.wakeCategory = 'M';
+        outbound.estimatedDepartureTime = 1760000000L + i * 90;
+    }
+    return departures;
+}
+
+// What JsonMessageHelper::getJsonOfArrivals() did before the streaming writer
+static std::string domArrivals(const std::vector<AmanAircraft>& aircraftList) {
+    Document document;
+    document.SetObject();
+    Value arrivalsArray(kArrayType);
+
+    Document::AllocatorType& allocator = document.GetAllocator();
+
+    for (auto& inbound : aircraftList) {
+        Value arrivalObject(kObjectType);
+
+        arrivalObject.AddMember("callsign", inbound.callsign, allocator);
+        arrivalObject.AddMember("icaoType", inbound.icaoType, allocator);
+        arrivalObject.AddMember("latitude", inbound.latitude, allocator);
+        arrivalObject.AddMember("longitude", inbound.longitude, allocator);
+        arrivalObject.AddMember("flightLevel", inbound.flightLevel, allocator);
+        arrivalObject.AddMember("pressureAltitude", inbound.pressureAltitude, allocator);
+        arrivalObject.AddMember("track", inbound.track, allocator);
+        arrivalObject.AddMember("groundSpeed", inbound.groundSpeed, allocator);
+        arrivalObject.AddMember("arrivalAirportIcao", inbound.arrivalAirportIcao, allocator);
+
+        if (!inbound.scratchPad.empty())
+            arrivalObject.AddMember("scratchPad", inbound.scratchPad, allocator);
+
+        if (!inbound.assignedStar.empty())
+            arrivalObject.AddMember("assignedStar", inbound.assignedStar, allocator);
+
+        if (!inbound.assignedDirectRouting.empty())
+            arrivalObject.AddMember("assignedDirect", inbound.assignedDirectRouting, allocator);
+
+        if (!inbound.arrivalRunway.empty())
+            arrivalObject.AddMember("assignedRunway", inbound.arrivalRunway, allocator);
+
+        if (!inbound.trackingController.empty())
+            arrivalObject.AddMember("trackingController", inbound.trackingController, allocator);
+
+        if (inbound.flightPlanTas > 0)
+            arrivalObject.AddMember("flightPlanTas", inbound.flightPlanTas, allocator);
+
+        Value routePoints(kArrayType);
+        for (auto& point : inbound.remainingRoute) {
+            Value pointObject(kObjectType);
+            pointObject.AddMember("name", point.name, allocator);
+            pointObject.AddMember("latitude", point.latitude, allocator);
+            pointObject.AddMember("longitude", point.longitude, allocator);
+            pointObject.AddMember("isPassed", point.isPassed, allocator);
+            routePoints.PushBack(pointObject, allocator);
+        }
+
+        arrivalObject.AddMember("route", routePoints, allocator);
+
+        arrivalsArray.PushBack(arrivalObject, allocator);
+    }
+
+    document.AddMember("type", "arrivals", allocator);
+    document.AddMember("inbounds", arrivalsArray, allocator);
+
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+    document.Accept(writer);
+
+    return sb.GetString();
+}
+
+// What JsonMessageHelper::getJsonOfDepartures() did before the streaming writer
+static std::string domDepartures(const std::vector<DmanAircraft>& aircraftList) {
+    Document document;
+    document.SetObject();
+    Value departuresArray(kArrayType);
+
+    Document::AllocatorType& allocator = document.GetAllocator();
+
+    for (auto& outbound : aircraftList) {
+        Value departureObject(kObjectType);
+        departureObject.AddMember("departureAirportIcao", outbound.departureAirportIcao, allocator);
+        departureObject.AddMember("callsign", outbound.callsign, allocator);
+        departureObject.AddMember("sid", outbound.sid, allocator);
+        departureObject.AddMember("runway", outbound.runway, allocator);
+        departureObject.AddMember("estimatedDepartureTime", outbound.estimatedDepartureTime, allocator);
+        departureObject.AddMember("icaoType", outbound.icaoType, allocator);
+        departureObject.AddMember("wakeCategory", outbound.wakeCategory, allocator);
+
+        departuresArray.PushBack(departureObject, allocator);
+    }
+
+    document.AddMember("type", "departures", allocator);
+    document.AddMember("outbounds", departuresArray, allocator);
+
+    StringBuffer sb;
+    Writer<StringBuffer> writer(sb);
+    document.Accept(writer);
+
+    return sb.GetString();
+}
+
+static std::vector<const AmanAircraft*> pointersTo(const std::vector<AmanAircraft>& arrivals) {
+    std::vector<const AmanAircraft*> pointers;
+    for (auto& inbound : arrivals) {
+        pointers.push_back(&inbound);
+    }
+    return pointers;
+}
+
+static void arrivalsDom(benchmark::State& state) {
+    auto arrivals = makeArrivals((int)state.range(0));
+    for (auto _ : state) {
+        std::string json = domArrivals(arrivals);
+        benchmark::DoNotOptimize(json.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void arrivalsStreaming(benchmark::State& state) {
+    auto arrivals = makeArrivals((int)state.range(0));
+    auto pointers = pointersTo(arrivals);
+    JsonMessageHelper serializer;
+    std::string out;
+    for (auto _ : state) {
+        serializer.writeArrivals(pointers, ArrivalAllFields, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void arrivalsCached(benchmark::State& state) {
+    auto arrivals = makeArrivals((int)state.range(0));
+    JsonMessageHelper serializer;
+    std::vector<std::string> arrivalsJson(arrivals.size());
+    std::vector<const std::string*> elements;
+    for (size_t i = 0; i < arrivals.size(); i++) {
+        serializer.writeArrival(arrivals[i], arrivalsJson[i]);
+        elements.push_back(&arrivalsJson[i]);
+    }
+    std::string out;
+    for (auto _ : state) {
+        serializer.writeArrivals(elements, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void departuresDom(benchmark::State& state) {
+    auto departures = makeDepartures((int)state.range(0));
+    for (auto _ : state) {
+        std::string json = domDepartures(departures);
+        benchmark::DoNotOptimize(json.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void departuresStreaming(benchmark::State& state) {
+    auto departures = makeDepartures((int)state.range(0));
+    JsonMessageHelper serializer;
+    std::string out;
+    for (auto _ : state) {
+        serializer.writeDepartures(departures, departures.size(), out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(arrivalsDom)->Arg(50)->Arg(300)->Arg(1000);
+BENCHMARK(arrivalsStreaming)->Arg(50)->Arg(300)->Arg(1000);
+BENCHMARK(arrivalsCached)->Arg(50)->Arg(300)->Arg(1000);
+BENCHMARK(departuresDom)->Arg(50)->Arg(300)->Arg(1000);
+BENCHMARK(departuresStreaming)->Arg(50)->Arg(300)->Arg(1000);
+
+// Both paths have to agree byte for byte, or the timings compare different work
+static bool sameOutput() {
+    JsonMessageHelper serializer;
+    auto arrivals = makeArrivals(300);
+    auto departures = makeDepartures(300);
+    std::string streamed;
+    bool same = true;
+
+    serializer.writeArrivals(pointersTo(arrivals), ArrivalAllFields, streamed);
+    if (streamed != domArrivals(arrivals)) {
+        std::fprintf(stderr, "Streamed arrivals differ from the DOM's\n");
+        same = false;
+    }
+    serializer.writeDepartures(departures, departures.size(), streamed);
+    if (streamed != domDepartures(departures)) {
+        std::fprintf(stderr, "Streamed departures differ from the DOM's\n");
+        same = false;
+    }
+    return same;
+}
+
+int main(int argc, char** argv) {
+    if (!sameOutput()) {
+        return 1;
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 2;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
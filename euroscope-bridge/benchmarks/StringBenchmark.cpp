@@ -0,0 +1,205 @@
+#include "StringUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times the StringUtils helpers against the regex and stringstream code they replaced, on filed
+// routes and padded sector file names, and checks that both give the same result.
+//
+//   aman-string-benchmark [--iterations N]
+//
+// Exits non-zero if any output differs from the old code's.
+
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size > 0 ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+// Filed routes as EuroScope hands them over: speed/level groups, airways, DEST/RWY suffixes,
+// the odd tab or double space, and an empty one
+static const char* const ROUTES[] = {
+    "N0454F360 LUNIP1B LUNIP L996 RIGAS DCT PENOR T317 ADOPI ADOPI2C",
+    "N0448F380 SOMVA1C SOMVA P155 ODNEK N872 LUVOR LUVOR3A ENGM/01L",
+    "N0460F350 DCT VEDAR UL980 OKLAP OKLAP1N",
+    "N0430F300  RILAX  T23 PENUN  DCT GM446\tENGM/19R",
+    "N0456F370 ABTAL1A ABTAL M852 ARSUP M852 OSDIR DCT KOVAN KOVAN2W EDDF/25C",
+    "N0441F340 ADEMU1D ADEMU L623 NAXUN DCT ERSUR",
+    "N0420F240 NOSLA L7 OLKAS OLKAS3C ENBR",
+    "N0470F390 PIKAS1Y PIKAS UN873 BENIX UL620 NARAK UM150 TOMBO DCT SPESA SPESA1A EDDF/07R",
+    "   DCT TORNO  ",
+    "",
+};
+
+// Sector file names are padded to fixed columns
+static const char* const SECTOR_NAMES[] = {
+    "ENGM", "ENGM ", "01L", " 01L ", "19R   ", "EDDF    ", "25C", "07R ", "ENBR", "  17  ",
+};
+
+// What the plugin did before StringUtils
+static std::string regexTrim(const std::string& value) {
+    return std::regex_replace(value, std::regex("^ +| +$|( ) +"), "$1");
+}
+
+static std::string streamArrivalRunway(const std::string& originalRoute, const std::string& arrivalAirport, const std::string& assignedRunway) {
+    std::stringstream ss(originalRoute);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (ss >> token) {
+        tokens.push_back(token);
+    }
+    if (tokens.empty()) {
+        return arrivalAirport + "/" + assignedRunway;
+    }
+
+    std::string& last = tokens.back();
+    size_t slashPos = last.find('/');
+    if (slashPos != std::string::npos) {
+        last = last.substr(0, slashPos + 1) + assignedRunway;
+    } else {
+        tokens.push_back(arrivalAirport + "/" + assignedRunway);
+    }
+
+    std::ostringstream out;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (i > 0) out << " ";
+        out << tokens[i];
+    }
+    return out.str();
+}
+
+static std::vector<std::string> copySplit(const std::string& string, const char delim) {
+    std::vector<std::string> output;
+    size_t start;
+    size_t end = 0;
+    while ((start = string.find_first_not_of(delim, end)) != std::string::npos) {
+        end = string.find(delim, start);
+        output.push_back(string.substr(start, end - start));
+    }
+    return output;
+}
+
+struct Measurement {
+    double nanosPerCall;
+    double allocationsPerCall;
+};
+
+// Keeps the compiler from dropping a result it can see is never read, as benchmark::DoNotOptimize does
+template <typename T>
+static void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs `call` over every input `iterations` times
+template <typename Call>
+static Measurement measure(int iterations, size_t inputs, Call call) {
+    uint64_t allocationsBefore = allocations.load();
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (size_t input = 0; input < inputs; input++) {
+            doNotOptimize(call(input));
+        }
+    }
+    double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+    double calls = static_cast<double>(iterations) * inputs;
+    return { nanos / calls, (allocations.load() - allocationsBefore) / calls };
+}
+
+static void report(const char* name, const Measurement& before, const Measurement& after) {
+    std::printf("%-16s %9.1f ns %6.1f allocs  ->  %9.1f ns %6.1f allocs  (%.1fx)\n", name,
+        before.nanosPerCall, before.allocationsPerCall, after.nanosPerCall, after.allocationsPerCall,
+        before.nanosPerCall / after.nanosPerCall);
+}
+
+int main(int argc, char** argv) {
+    int iterations = 20000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string(argv[i]) == "--iterations") {
+            iterations = std::atoi(argv[i + 1]);
+        } else {
+            std::cerr << "usage: aman-string-benchmark [--iterations N]" << std::endl;
+            return 1;
+        }
+    }
+
+    const size_t routeCount = sizeof(ROUTES) / sizeof(ROUTES[0]);
+    const size_t nameCount = sizeof(SECTOR_NAMES) / sizeof(SECTOR_NAMES[0]);
+    std::vector<std::string> routes(ROUTES, ROUTES + routeCount);
+    std::vector<std::string> names(SECTOR_NAMES, SECTOR_NAMES + nameCount);
+
+    int mismatches = 0;
+    for (auto& name : names) {
+        if (trimSpaces(name) != regexTrim(name)) {
+            std::cerr << "trimSpaces differs for \"" << name << "\"" << std::endl;
+            mismatches++;
+        }
+    }
+    for (auto& route : routes) {
+        if (withArrivalRunway(route, "ENGM", "01R") != streamArrivalRunway(route, "ENGM", "01R")) {
+            std::cerr << "withArrivalRunway differs for \"" << route << "\"" << std::endl;
+            mismatches++;
+        }
+        auto views = splitString(route, ' ');
+        auto copies = copySplit(route, ' ');
+        if (std::vector<std::string>(views.begin(), views.end()) != copies) {
+            std::cerr << "splitString differs for \"" << route << "\"" << std::endl;
+            mismatches++;
+        }
+    }
+
+    std::printf("%d iterations, %zu routes, %zu sector names; old -> new, per call\n", iterations, routeCount, nameCount);
+    report("trimSpaces",
+        measure(iterations / 10, nameCount, [&](size_t i) { return regexTrim(names[i]).size(); }),
+        measure(iterations, nameCount, [&](size_t i) { return trimSpaces(names[i]).size(); }));
+    report("withArrivalRwy",
+        measure(iterations, routeCount, [&](size_t i) { return streamArrivalRunway(routes[i], "ENGM", "01R").size(); }),
+        measure(iterations, routeCount, [&](size_t i) { return withArrivalRunway(routes[i], "ENGM", "01R").size(); }));
+    report("splitString",
+        measure(iterations, routeCount, [&](size_t i) { return copySplit(routes[i], ' ').size(); }),
+        measure(iterations, routeCount, [&](size_t i) { return splitString(routes[i], ' ').size(); }));
+    report("routeTokens",
+        measure(iterations, routeCount, [&](size_t i) {
+            std::stringstream ss(routes[i]);
+            std::string token;
+            size_t count = 0;
+            while (ss >> token) {
+                count += token.size();
+            }
+            return count;
+        }),
+        measure(iterations, routeCount, [&](size_t i) {
+            size_t position = 0;
+            std::string_view token;
+            size_t count = 0;
+            while (nextRouteToken(routes[i], position, token)) {
+                count += token.size();
+            }
+            return count;
+        }));
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " outputs differ from the old code" << std::endl;
+        return 1;
+    }
+    return 0;
+}
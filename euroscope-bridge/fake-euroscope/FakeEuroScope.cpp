@@ -0,0 +1,462 @@
+#include "FakeEuroScope.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace EuroScopePlugIn;
+
+// Per-plugin state behind CPlugIn::m_pPluginData
+class CPlugInData {
+public:
+    std::string name;
+};
+
+namespace EuroScopePlugIn {
+
+// The SDK classes befriend "CPlugInData"; for GCC and Clang that names a class in their own
+// namespace. The driver builds the references it passes to the callbacks through it.
+class CPlugInData {
+public:
+    static CRadarTarget radarTarget(FakeAircraft* aircraft) {
+        CRadarTarget radarTarget;
+        radarTarget.m_RtPosition = aircraft;
+        return radarTarget;
+    }
+
+    static CFlightPlan flightPlan(FakeAircraft* aircraft) {
+        CFlightPlan flightPlan;
+        flightPlan.m_FpPosition = aircraft;
+        return flightPlan;
+    }
+};
+
+}
+
+namespace {
+
+CPlugIn* loadedPlugIn = nullptr;
+std::vector<std::string> pendingDataUpdates;
+
+FakeAircraft* aircraftOf(ESINDEX position) {
+    return static_cast<FakeAircraft*>(position);
+}
+
+const FakeRunway* runwayAt(int position, int elementType) {
+    auto& runways = FakeEuroScope::traffic().runways;
+    if (elementType != SECTOR_ELEMENT_RUNWAY || position < 0 || position >= (int)runways.size()) {
+        return nullptr;
+    }
+    return &runways[position];
+}
+
+// Updates made by the plugin while it was inside a callback are reported once it returned
+void flushPendingUpdates() {
+    while (loadedPlugIn != nullptr && !pendingDataUpdates.empty()) {
+        auto callsigns = std::move(pendingDataUpdates);
+        pendingDataUpdates.clear();
+        for (auto& callsign : callsigns) {
+            FakeEuroScope::flightPlanDataUpdate(callsign);
+        }
+    }
+}
+
+}
+
+//---Driver---------------------------------------------------------------
+
+FakeTraffic& FakeEuroScope::traffic() {
+    static FakeTraffic world;
+    return world;
+}
+
+CPlugIn* FakeEuroScope::loadPlugIn() {
+    if (loadedPlugIn == nullptr) {
+        EuroScopePlugInInit(&loadedPlugIn);
+    }
+    return loadedPlugIn;
+}
+
+void FakeEuroScope::unloadPlugIn() {
+    if (loadedPlugIn != nullptr) {
+        EuroScopePlugInExit();
+        loadedPlugIn = nullptr;
+        pendingDataUpdates.clear();
+    }
+}
+
+void FakeEuroScope::timer(int counter) {
+    if (loadedPlugIn != nullptr) {
+        loadedPlugIn->OnTimer(counter);
+        flushPendingUpdates();
+    }
+}
+
+void FakeEuroScope::radarTargetPositionUpdate(const std::string& callsign) {
+    auto aircraft = traffic().find(callsign);
+    if (loadedPlugIn != nullptr && aircraft != nullptr && aircraft->hasRadarTarget) {
+        loadedPlugIn->OnRadarTargetPositionUpdate(EuroScopePlugIn::CPlugInData::radarTarget(aircraft));
+        flushPendingUpdates();
+    }
+}
+
+void FakeEuroScope::flightPlanDataUpdate(const std::string& callsign) {
+    auto aircraft = traffic().find(callsign);
+    if (loadedPlugIn != nullptr && aircraft != nullptr) {
+        loadedPlugIn->OnFlightPlanFlightPlanDataUpdate(EuroScopePlugIn::CPlugInData::flightPlan(aircraft));
+        flushPendingUpdates();
+    }
+}
+
+void FakeEuroScope::controllerAssignedDataUpdate(const std::string& callsign, int dataType) {
+    auto aircraft = traffic().find(callsign);
+    if (loadedPlugIn != nullptr && aircraft != nullptr) {
+        loadedPlugIn->OnFlightPlanControllerAssignedDataUpdate(EuroScopePlugIn::CPlugInData::flightPlan(aircraft), dataType);
+        flushPendingUpdates();
+    }
+}
+
+void FakeEuroScope::runwayActivityChanged() {
+    if (loadedPlugIn != nullptr) {
+        loadedPlugIn->OnAirportRunwayActivityChanged();
+        flushPendingUpdates();
+    }
+}
+
+void FakeEuroScope::flightPlanDisconnect(const std::string& callsign) {
+    auto aircraft = traffic().find(callsign);
+    if (aircraft == nullptr) {
+        return;
+    }
+    if (loadedPlugIn != nullptr) {
+        loadedPlugIn->OnFlightPlanDisconnect(EuroScopePlugIn::CPlugInData::flightPlan(aircraft));
+    }
+    traffic().remove(callsign);
+    flushPendingUpdates();
+}
+
+bool FakeEuroScope::compileCommand(const std::string& commandLine) {
+    if (loadedPlugIn == nullptr) {
+        return false;
+    }
+    bool handled = loadedPlugIn->OnCompileCommand(commandLine.c_str());
+    flushPendingUpdates();
+    return handled;
+}
+
+void FakeEuroScope::queueFlightPlanDataUpdate(const std::string& callsign) {
+    pendingDataUpdates.push_back(callsign);
+}
+
+//---CPlugIn--------------------------------------------------------------
+
+CPlugIn::CPlugIn(int /*CompatibilityCode*/, const char* sPlugInName, const char* /*sVersionNumber*/, const char* /*sAuthorName*/, const char* /*sCopyrigthMessage*/) {
+    m_pPluginData = new ::CPlugInData{ sPlugInName };
+}
+
+CPlugIn::~CPlugIn(void) {
+    delete m_pPluginData;
+}
+
+void CPlugIn::DisplayUserMessage(const char* sHandlerName, const char* sSenderName, const char* sMessage, bool /*ShowHandler*/, bool /*ShowUnread*/, bool /*ShowUnreadEvenIfBusy*/, bool /*StartFlashing*/, bool /*OnlyIfNotBusy*/) {
+    std::cerr << "[" << sHandlerName << "] " << sSenderName << ": " << sMessage << std::endl;
+}
+
+CController CPlugIn::ControllerMyself(void) const {
+    CController controller;
+    auto& myself = FakeEuroScope::traffic().myself;
+    if (myself.connected) {
+        controller.m_CtrPosition = &myself;
+        controller.m_Myself = true;
+    }
+    return controller;
+}
+
+CFlightPlan CPlugIn::FlightPlanSelect(const char* sCallsign) const {
+    CFlightPlan flightPlan;
+    flightPlan.m_FpPosition = FakeEuroScope::traffic().find(sCallsign);
+    return flightPlan;
+}
+
+CFlightPlan CPlugIn::FlightPlanSelectFirst(void) const {
+    CFlightPlan flightPlan;
+    auto& aircraft = FakeEuroScope::traffic().getAircraft();
+    if (!aircraft.empty()) {
+        flightPlan.m_FpPosition = &aircraft.begin()->second;
+    }
+    return flightPlan;
+}
+
+CFlightPlan CPlugIn::FlightPlanSelectNext(CFlightPlan CurrentFlightPlan) const {
+    CFlightPlan flightPlan;
+    auto& aircraft = FakeEuroScope::traffic().getAircraft();
+    auto next = aircraft.upper_bound(aircraftOf(CurrentFlightPlan.m_FpPosition)->callsign);
+    if (next != aircraft.end()) {
+        flightPlan.m_FpPosition = &next->second;
+    }
+    return flightPlan;
+}
+
+CRadarTarget CPlugIn::RadarTargetSelect(const char* sCallsign) const {
+    CRadarTarget radarTarget;
+    auto aircraft = FakeEuroScope::traffic().find(sCallsign);
+    if (aircraft != nullptr && aircraft->hasRadarTarget) {
+        radarTarget.m_RtPosition = aircraft;
+    }
+    return radarTarget;
+}
+
+CRadarTarget CPlugIn::RadarTargetSelectASEL(void) const {
+    return RadarTargetSelect(FakeEuroScope::traffic().selectedCallsign.c_str());
+}
+
+CSectorElement CPlugIn::SectorFileElementSelectFirst(int ElementType) const {
+    CSectorElement element;
+    element.m_ElementType = ElementType;
+    auto& traffic = FakeEuroScope::traffic();
+    if ((ElementType == SECTOR_ELEMENT_AIRPORT && !traffic.airports.empty()) ||
+        (ElementType == SECTOR_ELEMENT_RUNWAY && !traffic.runways.empty())) {
+        element.m_Position = 0;
+    }
+    return element;
+}
+
+CSectorElement CPlugIn::SectorFileElementSelectNext(CSectorElement CurrentElement, int ElementType) const {
+    CSectorElement element;
+    element.m_ElementType = ElementType;
+    auto& traffic = FakeEuroScope::traffic();
+    int next = CurrentElement.m_Position + 1;
+    if ((ElementType == SECTOR_ELEMENT_AIRPORT && next < (int)traffic.airports.size()) ||
+        (ElementType == SECTOR_ELEMENT_RUNWAY && next < (int)traffic.runways.size())) {
+        element.m_Position = next;
+    }
+    return element;
+}
+
+//---CSectorElement-------------------------------------------------------
+
+const char* CSectorElement::GetName(void) const {
+    if (m_ElementType == SECTOR_ELEMENT_AIRPORT) {
+        return FakeEuroScope::traffic().airports[m_Position].c_str();
+    }
+    auto runway = runwayAt(m_Position, m_ElementType);
+    return runway != nullptr ? runway->names[0].c_str() : "";
+}
+
+const char* CSectorElement::GetAirportName(void) const {
+    auto runway = runwayAt(m_Position, m_ElementType);
+    return runway != nullptr ? runway->airportIcao.c_str() : "";
+}
+
+const char* CSectorElement::GetRunwayName(int Index) const {
+    auto runway = runwayAt(m_Position, m_ElementType);
+    return runway != nullptr && (Index == 0 || Index == 1) ? runway->names[Index].c_str() : "";
+}
+
+bool CSectorElement::IsElementActive(bool Departure, int Index) {
+    auto runway = runwayAt(m_Position, m_ElementType);
+    if (runway == nullptr || (Index != 0 && Index != 1)) {
+        return false;
+    }
+    return Departure ? runway->activeForDepartures[Index] : runway->activeForArrivals[Index];
+}
+
+//---CController----------------------------------------------------------
+
+const char* CController::GetCallsign(void) const {
+    return static_cast<FakeController*>(m_CtrPosition)->callsign.c_str();
+}
+
+const char* CController::GetPositionId(void) const {
+    return static_cast<FakeController*>(m_CtrPosition)->positionId.c_str();
+}
+
+int CController::GetFacility(void) const {
+    return static_cast<FakeController*>(m_CtrPosition)->facility;
+}
+
+//---CRadarTarget---------------------------------------------------------
+
+const char* CRadarTarget::GetCallsign(void) const {
+    return aircraftOf(m_RtPosition)->callsign.c_str();
+}
+
+CFlightPlan CRadarTarget::GetCorrelatedFlightPlan(void) const {
+    CFlightPlan flightPlan;
+    flightPlan.m_FpPosition = m_RtPosition;
+    return flightPlan;
+}
+
+CRadarTargetPositionData CRadarTarget::GetPosition(void) const {
+    CRadarTargetPositionData position;
+    position.m_RtPosition = m_RtPosition;
+    position.m_PosPosition = m_RtPosition;
+    return position;
+}
+
+double CRadarTarget::GetTrackHeading(void) const {
+    return aircraftOf(m_RtPosition)->trackHeading;
+}
+
+//---CRadarTargetPositionData---------------------------------------------
+
+CPosition CRadarTargetPositionData::GetPosition(void) const {
+    CPosition position;
+    position.m_Latitude = aircraftOf(m_RtPosition)->latitude;
+    position.m_Longitude = aircraftOf(m_RtPosition)->longitude;
+    return position;
+}
+
+int CRadarTargetPositionData::GetPressureAltitude(void) const {
+    return aircraftOf(m_RtPosition)->pressureAltitude;
+}
+
+int CRadarTargetPositionData::GetFlightLevel(void) const {
+    return aircraftOf(m_RtPosition)->flightLevel;
+}
+
+int CRadarTargetPositionData::GetReportedGS(void) const {
+    return aircraftOf(m_RtPosition)->groundSpeed;
+}
+
+//---CFlightPlan----------------------------------------------------------
+
+const char* CFlightPlan::GetCallsign(void) const {
+    return aircraftOf(m_FpPosition)->callsign.c_str();
+}
+
+const char* CFlightPlan::GetTrackingControllerId(void) const {
+    return aircraftOf(m_FpPosition)->trackingControllerId.c_str();
+}
+
+CFlightPlanData CFlightPlan::GetFlightPlanData(void) const {
+    CFlightPlanData data;
+    data.m_FpPosition = m_FpPosition;
+    return data;
+}
+
+CFlightPlanControllerAssignedData CFlightPlan::GetControllerAssignedData(void) const {
+    CFlightPlanControllerAssignedData data;
+    data.m_FpPosition = m_FpPosition;
+    return data;
+}
+
+CFlightPlanExtractedRoute CFlightPlan::GetExtractedRoute(void) const {
+    CFlightPlanExtractedRoute route;
+    route.m_FpPosition = m_FpPosition;
+    return route;
+}
+
+//---CFlightPlanData------------------------------------------------------
+
+const char* CFlightPlanData::GetOrigin(void) const {
+    return aircraftOf(m_FpPosition)->origin.c_str();
+}
+
+const char* CFlightPlanData::GetDestination(void) const {
+    return aircraftOf(m_FpPosition)->destination.c_str();
+}
+
+const char* CFlightPlanData::GetRoute(void) const {
+    return aircraftOf(m_FpPosition)->route.c_str();
+}
+
+const char* CFlightPlanData::GetAircraftFPType(void) const {
+    return aircraftOf(m_FpPosition)->icaoType.c_str();
+}
+
+char CFlightPlanData::GetAircraftWtc(void) const {
+    return aircraftOf(m_FpPosition)->wakeCategory;
+}
+
+int CFlightPlanData::GetTrueAirspeed(void) const {
+    return aircraftOf(m_FpPosition)->trueAirspeed;
+}
+
+const char* CFlightPlanData::GetSidName(void) const {
+    return aircraftOf(m_FpPosition)->sidName.c_str();
+}
+
+const char* CFlightPlanData::GetDepartureRwy(void) const {
+    return aircraftOf(m_FpPosition)->departureRunway.c_str();
+}
+
+const char* CFlightPlanData::GetStarName(void) const {
+    return aircraftOf(m_FpPosition)->starName.c_str();
+}
+
+const char* CFlightPlanData::GetArrivalRwy(void) const {
+    return aircraftOf(m_FpPosition)->arrivalRunway.c_str();
+}
+
+const char* CFlightPlanData::GetEstimatedDepartureTime(void) const {
+    return aircraftOf(m_FpPosition)->estimatedDepartureTime.c_str();
+}
+
+bool CFlightPlanData::SetRoute(const char* sRoute) {
+    aircraftOf(m_FpPosition)->route = sRoute;
+    return true;
+}
+
+bool CFlightPlanData::SetEstimatedDepartureTime(const char* sDepTime) {
+    aircraftOf(m_FpPosition)->estimatedDepartureTime = sDepTime;
+    FakeEuroScope::queueFlightPlanDataUpdate(aircraftOf(m_FpPosition)->callsign);
+    return true;
+}
+
+bool CFlightPlanData::AmendFlightPlan(void) {
+    FakeEuroScope::queueFlightPlanDataUpdate(aircraftOf(m_FpPosition)->callsign);
+    return true;
+}
+
+//---CFlightPlanControllerAssignedData------------------------------------
+
+const char* CFlightPlanControllerAssignedData::GetScratchPadString(void) const {
+    return aircraftOf(m_FpPosition)->scratchPad.c_str();
+}
+
+const char* CFlightPlanControllerAssignedData::GetDirectToPointName(void) const {
+    return aircraftOf(m_FpPosition)->directTo.c_str();
+}
+
+//---CFlightPlanExtractedRoute--------------------------------------------
+
+int CFlightPlanExtractedRoute::GetPointsNumber(void) const {
+    return (int)aircraftOf(m_FpPosition)->routePoints.size();
+}
+
+int CFlightPlanExtractedRoute::GetPointsCalculatedIndex(void) const {
+    return aircraftOf(m_FpPosition)->pointsCalculatedIndex;
+}
+
+int CFlightPlanExtractedRoute::GetPointsAssignedIndex(void) const {
+    return aircraftOf(m_FpPosition)->pointsAssignedIndex;
+}
+
+const char* CFlightPlanExtractedRoute::GetPointName(int Index) const {
+    return aircraftOf(m_FpPosition)->routePoints[Index].name.c_str();
+}
+
+const char* CFlightPlanExtractedRoute::GetPointAirwayName(int Index) const {
+    return aircraftOf(m_FpPosition)->routePoints[Index].airway.c_str();
+}
+
+CPosition CFlightPlanExtractedRoute::GetPointPosition(int Index) const {
+    CPosition position;
+    position.m_Latitude = aircraftOf(m_FpPosition)->routePoints[Index].latitude;
+    position.m_Longitude = aircraftOf(m_FpPosition)->routePoints[Index].longitude;
+    return position;
+}
+
+//---Win32------------------------------------------------------------------
+
+char __ImageBase;
+
+DWORD GetModuleFileNameA(HINSTANCE /*module*/, char* fileName, DWORD size) {
+    const char path[] = "./Aman.dll";
+    if (size < sizeof(path)) {
+        return 0;
+    }
+    memcpy(fileName, path, sizeof(path));
+    return sizeof(path) - 1;
+}
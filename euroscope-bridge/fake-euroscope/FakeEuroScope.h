@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+#include "EuroScopePlugIn.h"
+#include "FakeTraffic.h"
+
+// Stands in for EuroScope: loads the plugin through EuroScopePlugInInit(), owns the traffic the
+// SDK classes read from, and raises the plugin callbacks. Changes the plugin makes itself, such
+// as AmendFlightPlan(), are reported back once the callback that made them has returned.
+class FakeEuroScope {
+public:
+    static FakeTraffic& traffic();
+
+    static EuroScopePlugIn::CPlugIn* loadPlugIn();
+    static void unloadPlugIn();
+
+    // Callbacks; each one is a no-op when no plugin is loaded
+    static void timer(int counter);
+    static void radarTargetPositionUpdate(const std::string& callsign);
+    static void flightPlanDataUpdate(const std::string& callsign);
+    static void controllerAssignedDataUpdate(const std::string& callsign, int dataType);
+    static void runwayActivityChanged();
+    // Raises OnFlightPlanDisconnect, then removes the aircraft from the traffic
+    static void flightPlanDisconnect(const std::string& callsign);
+    // A dot command typed in the EuroScope command line; false if no plugin took it
+    static bool compileCommand(const std::string& commandLine);
+
+    // Used by the SDK classes when the plugin amends a flight plan
+    static void queueFlightPlanDataUpdate(const std::string& callsign);
+};
@@ -0,0 +1,130 @@
+#include "FakeEuroScope.h"
+#include "ScenarioGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs the plugin against the traffic of a scenario file. Clients connect to the bridge port
+// as usual. Each tick is one simulated second.
+//
+//   aman-fake-euroscope --scenario FILE [--seed N] [--ticks N] [--interval-ms N] [--capture FILE]
+//                       [--trace FILE] [--metrics-port N]
+//
+// --ticks 0 runs until killed; --interval-ms 1000 is real time, 100 is 10x, 0 as fast as possible.
+// --capture records the client sessions for aman-replay, like ".aman capture on FILE" in EuroScope.
+// --trace records timing spans for the whole run and writes them as Chrome trace JSON on exit.
+// --metrics-port serves Prometheus metrics on 127.0.0.1, like ".aman metrics on N" in EuroScope.
+
+struct HostOptions {
+    std::string scenarioPath;
+    uint64_t seed = 0;
+    bool seedSet = false;
+    int ticks = 0;
+    int intervalMs = 1000;
+    std::string capturePath;
+    std::string tracePath;
+    int metricsPort = 0;
+};
+
+static bool parseOptions(int argc, char** argv, HostOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (name == "--scenario") {
+            options.scenarioPath = value;
+        } else if (name == "--seed") {
+            options.seed = strtoull(value.c_str(), nullptr, 10);
+            options.seedSet = true;
+        } else if (name == "--ticks") {
+            options.ticks = atoi(value.c_str());
+        } else if (name == "--interval-ms") {
+            options.intervalMs = atoi(value.c_str());
+        } else if (name == "--capture") {
+            options.capturePath = value;
+        } else if (name == "--trace") {
+            options.tracePath = value;
+        } else if (name == "--metrics-port") {
+            options.metricsPort = atoi(value.c_str());
+        } else {
+            return false;
+        }
+    }
+    return !options.scenarioPath.empty();
+}
+
+int main(int argc, char** argv) {
+    HostOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: aman-fake-euroscope --scenario FILE [--seed N] [--ticks N] [--interval-ms N] [--capture FILE] [--trace FILE] [--metrics-port N]" << std::endl;
+        return 1;
+    }
+
+    ScenarioGenerator generator;
+    std::string error;
+    if (!generator.load(options.scenarioPath, error)) {
+        std::cerr << "Cannot load scenario: " << error << std::endl;
+        return 1;
+    }
+    if (options.seedSet) {
+        generator.setSeed(options.seed);
+    }
+
+    auto& traffic = FakeEuroScope::traffic();
+    FakeEuroScope::loadPlugIn();
+    if (!options.capturePath.empty()) {
+        FakeEuroScope::compileCommand(".aman capture on " + options.capturePath);
+    }
+    if (!options.tracePath.empty()) {
+        FakeEuroScope::compileCommand(".aman trace on");
+    }
+    if (options.metricsPort > 0) {
+        FakeEuroScope::compileCommand(".aman metrics on " + std::to_string(options.metricsPort));
+    }
+    generator.populate(traffic);
+    std::cerr << "Scenario loaded: " << generator.getAircraftCount() << " aircraft" << std::endl;
+
+    // OnTimer durations, reported on exit
+    std::vector<double> timerMicros;
+
+    for (int tick = 1; options.ticks == 0 || tick <= options.ticks; tick++) {
+        auto started = std::chrono::steady_clock::now();
+        generator.advance(traffic);
+
+        auto timerStarted = std::chrono::steady_clock::now();
+        FakeEuroScope::timer(tick);
+        timerMicros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - timerStarted).count());
+
+        if (options.intervalMs > 0) {
+            std::this_thread::sleep_until(started + std::chrono::milliseconds(options.intervalMs));
+        }
+    }
+
+    if (!options.capturePath.empty()) {
+        FakeEuroScope::compileCommand(".aman capture off");
+    }
+    if (!options.tracePath.empty()) {
+        FakeEuroScope::compileCommand(".aman trace off " + options.tracePath);
+    }
+    FakeEuroScope::unloadPlugIn();
+
+    if (!timerMicros.empty()) {
+        std::sort(timerMicros.begin(), timerMicros.end());
+        double total = 0;
+        for (double micros : timerMicros) {
+            total += micros;
+        }
+        std::cerr << "OnTimer over " << timerMicros.size() << " ticks: mean " << total / timerMicros.size()
+            << " us, p50 " << timerMicros[timerMicros.size() / 2]
+            << " us, p99 " << timerMicros[timerMicros.size() * 99 / 100]
+            << " us, max " << timerMicros.back() << " us" << std::endl;
+    }
+    return 0;
+}
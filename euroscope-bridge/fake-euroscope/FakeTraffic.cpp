@@ -0,0 +1,20 @@
+#include "FakeTraffic.h"
+
+FakeAircraft& FakeTraffic::add(const FakeAircraft& newAircraft) {
+    auto& entry = aircraft[newAircraft.callsign];
+    entry = newAircraft;
+    return entry;
+}
+
+FakeAircraft* FakeTraffic::find(const std::string& callsign) {
+    auto it = aircraft.find(callsign);
+    return it != aircraft.end() ? &it->second : nullptr;
+}
+
+void FakeTraffic::remove(const std::string& callsign) {
+    aircraft.erase(callsign);
+}
+
+void FakeTraffic::clear() {
+    aircraft.clear();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// In-memory world behind the fake EuroScopePlugIn classes. Everything the plugin reads through
+// CRadarTarget, CFlightPlan and CSectorElement comes from here, and plugin writes such as
+// SetRoute() land here. Like EuroScope itself it is only touched from one thread.
+
+struct FakeRoutePoint {
+    std::string name;
+    std::string airway;
+    double latitude = 0;
+    double longitude = 0;
+};
+
+// A flight plan and, once it is airborne, its correlated radar target
+struct FakeAircraft {
+    std::string callsign;
+
+    // Flight plan data
+    std::string origin;
+    std::string destination;
+    std::string route;
+    std::string icaoType;
+    char wakeCategory = 'M';
+    int trueAirspeed = 0;
+    std::string sidName;
+    std::string departureRunway;
+    std::string starName;
+    std::string arrivalRunway;
+    std::string estimatedDepartureTime;     // HHMM
+
+    // Controller assigned data
+    std::string scratchPad;
+    std::string directTo;
+    std::string trackingControllerId;
+
+    // Extracted route
+    std::vector<FakeRoutePoint> routePoints;
+    int pointsCalculatedIndex = -1;     // Closest point ahead
+    int pointsAssignedIndex = -1;       // Direct-to point, -1 when none
+
+    // Radar target
+    bool hasRadarTarget = true;
+    double latitude = 0;
+    double longitude = 0;
+    int pressureAltitude = 0;
+    int flightLevel = 0;
+    int groundSpeed = 0;
+    double trackHeading = 0;
+};
+
+struct FakeRunway {
+    std::string airportIcao;
+    std::string names[2];                   // One per direction
+    bool activeForDepartures[2] = { false, false };
+    bool activeForArrivals[2] = { false, false };
+};
+
+struct FakeController {
+    bool connected = false;
+    std::string callsign;
+    std::string positionId;
+    int facility = 0;
+};
+
+class FakeTraffic {
+public:
+    // Adds or replaces the aircraft with the same callsign
+    FakeAircraft& add(const FakeAircraft& aircraft);
+    FakeAircraft* find(const std::string& callsign);
+    void remove(const std::string& callsign);
+    void clear();
+
+    // Iteration order of FlightPlanSelectFirst/Next
+    std::map<std::string, FakeAircraft>& getAircraft() { return aircraft; }
+
+    std::vector<std::string> airports;     // Sector file airports, by ICAO
+    std::vector<FakeRunway> runways;        // Sector file runways
+    FakeController myself;
+    std::string selectedCallsign;           // ASEL, empty when nothing is selected
+
+private:
+    // Node based, so handles given out to the plugin stay valid until the aircraft is removed
+    std::map<std::string, FakeAircraft> aircraft;
+};
@@ -0,0 +1,372 @@
+#include "MiniYaml.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+struct Line {
+    int number;
+    int indent;
+    std::string text;
+};
+
+const YamlNode NULL_NODE;
+
+std::string trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t\r");
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    size_t end = value.find_last_not_of(" \t\r");
+    return value.substr(start, end - start + 1);
+}
+
+// Drops a trailing comment, leaving '#' inside quotes alone
+std::string stripComment(const std::string& text) {
+    char quote = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '#' && (i == 0 || text[i - 1] == ' ' || text[i - 1] == '\t')) {
+            return text.substr(0, i);
+        }
+    }
+    return text;
+}
+
+// Position of the ':' that ends a map key, or npos
+size_t findKeySeparator(const std::string& text) {
+    if (text.empty() || text[0] == '{' || text[0] == '[') {
+        return std::string::npos;
+    }
+    char quote = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (quote != 0) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == ':' && (i + 1 == text.size() || text[i + 1] == ' ')) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+std::string unquote(const std::string& value) {
+    if (value.size() >= 2 && (value[0] == '"' || value[0] == '\'') && value.back() == value[0]) {
+        return value.substr(1, value.size() - 2);
+    }
+    return value;
+}
+
+YamlNode makeScalar(const std::string& text) {
+    YamlNode node;
+    std::string value = trim(text);
+    if (value.empty() || value == "~" || value == "null") {
+        return node;
+    }
+    node.kind = YamlNode::Scalar;
+    node.scalar = unquote(value);
+    return node;
+}
+
+// Parser for the flow style ({ a: 1, b: [x, y] }) of a single line
+class FlowParser {
+public:
+    FlowParser(const std::string& text) : text(text), pos(0) {}
+
+    bool parse(YamlNode& node, std::string& error) {
+        if (!parseValue(node, error)) {
+            return false;
+        }
+        skipSpaces();
+        if (pos != text.size()) {
+            error = "unexpected '" + text.substr(pos) + "'";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const std::string& text;
+    size_t pos;
+
+    void skipSpaces() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) {
+            pos++;
+        }
+    }
+
+    bool parseValue(YamlNode& node, std::string& error) {
+        skipSpaces();
+        if (pos < text.size() && text[pos] == '{') {
+            return parseMap(node, error);
+        }
+        if (pos < text.size() && text[pos] == '[') {
+            return parseList(node, error);
+        }
+        node = makeScalar(readScalar(",]}"));
+        return true;
+    }
+
+    std::string readScalar(const char* terminators) {
+        skipSpaces();
+        size_t start = pos;
+        if (pos < text.size() && (text[pos] == '"' || text[pos] == '\'')) {
+            char quote = text[pos++];
+            while (pos < text.size() && text[pos] != quote) {
+                pos++;
+            }
+            pos++;
+            return text.substr(start, pos - start);
+        }
+        while (pos < text.size() && strchr(terminators, text[pos]) == nullptr) {
+            pos++;
+        }
+        return text.substr(start, pos - start);
+    }
+
+    bool parseMap(YamlNode& node, std::string& error) {
+        node = YamlNode();
+        node.kind = YamlNode::Map;
+        pos++;
+        for (;;) {
+            skipSpaces();
+            if (pos < text.size() && text[pos] == '}') {
+                pos++;
+                return true;
+            }
+            std::string key = unquote(trim(readScalar(":,}")));
+            if (pos >= text.size() || text[pos] != ':') {
+                error = "expected ':' after '" + key + "'";
+                return false;
+            }
+            pos++;
+            YamlNode value;
+            if (!parseValue(value, error)) {
+                return false;
+            }
+            node.entries.push_back({ key, value });
+            if (!parseSeparator('}', error)) {
+                return false;
+            }
+        }
+    }
+
+    bool parseList(YamlNode& node, std::string& error) {
+        node = YamlNode();
+        node.kind = YamlNode::List;
+        pos++;
+        for (;;) {
+            skipSpaces();
+            if (pos < text.size() && text[pos] == ']') {
+                pos++;
+                return true;
+            }
+            YamlNode item;
+            if (!parseValue(item, error)) {
+                return false;
+            }
+            node.items.push_back(item);
+            if (!parseSeparator(']', error)) {
+                return false;
+            }
+        }
+    }
+
+    bool parseSeparator(char close, std::string& error) {
+        skipSpaces();
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+            return true;
+        }
+        if (pos < text.size() && text[pos] == close) {
+            return true;
+        }
+        error = std::string("expected ',' or '") + close + "'";
+        return false;
+    }
+};
+
+// Parser for the block (indentation based) structure
+class BlockParser {
+public:
+    BlockParser(std::vector<Line>& lines) : lines(lines), pos(0) {}
+
+    bool parse(YamlNode& root, std::string& error) {
+        if (lines.empty()) {
+            root = YamlNode();
+            return true;
+        }
+        if (!parseNode(lines[0].indent, root, error)) {
+            return false;
+        }
+        if (pos < lines.size()) {
+            return fail(lines[pos], "unexpected indentation", error);
+        }
+        return true;
+    }
+
+private:
+    std::vector<Line>& lines;
+    size_t pos;
+
+    static bool isListItem(const Line& line) {
+        return line.text == "-" || line.text.compare(0, 2, "- ") == 0;
+    }
+
+    static bool fail(const Line& line, const std::string& message, std::string& error) {
+        error = "line " + std::to_string(line.number) + ": " + message;
+        return false;
+    }
+
+    bool parseInline(const Line& line, const std::string& text, YamlNode& node, std::string& error) {
+        std::string flowError;
+        if (!FlowParser(text).parse(node, flowError)) {
+            return fail(line, flowError, error);
+        }
+        return true;
+    }
+
+    bool parseNode(int indent, YamlNode& node, std::string& error) {
+        return isListItem(lines[pos]) ? parseList(indent, node, error) : parseMap(indent, node, error);
+    }
+
+    // Value of "key:" or "-" with nothing after it: whatever is nested below, if anything
+    bool parseNested(int parentIndent, bool allowSameIndentList, YamlNode& node, std::string& error) {
+        node = YamlNode();
+        if (pos >= lines.size()) {
+            return true;
+        }
+        const Line& next = lines[pos];
+        if (next.indent > parentIndent || (allowSameIndentList && next.indent == parentIndent && isListItem(next))) {
+            return parseNode(next.indent, node, error);
+        }
+        return true;
+    }
+
+    bool parseList(int indent, YamlNode& node, std::string& error) {
+        node = YamlNode();
+        node.kind = YamlNode::List;
+        while (pos < lines.size() && lines[pos].indent == indent && isListItem(lines[pos])) {
+            Line& line = lines[pos];
+            std::string rest = trim(line.text.substr(1));
+            YamlNode item;
+
+            if (rest.empty()) {
+                pos++;
+                if (!parseNested(indent, false, item, error)) {
+                    return false;
+                }
+            } else if (findKeySeparator(rest) != std::string::npos) {
+                // "- key: value" starts a map indented like its first key
+                line.indent = indent + (int)(line.text.size() - rest.size());
+                line.text = rest;
+                if (!parseMap(line.indent, item, error)) {
+                    return false;
+                }
+            } else {
+                if (!parseInline(line, rest, item, error)) {
+                    return false;
+                }
+                pos++;
+            }
+            node.items.push_back(item);
+        }
+        return true;
+    }
+
+    bool parseMap(int indent, YamlNode& node, std::string& error) {
+        node = YamlNode();
+        node.kind = YamlNode::Map;
+        while (pos < lines.size() && lines[pos].indent == indent && !isListItem(lines[pos])) {
+            const Line& line = lines[pos];
+            size_t separator = findKeySeparator(line.text);
+            if (separator == std::string::npos) {
+                return fail(line, "expected 'key: value'", error);
+            }
+            std::string key = unquote(trim(line.text.substr(0, separator)));
+            std::string rest = trim(line.text.substr(separator + 1));
+            pos++;
+
+            YamlNode value;
+            if (rest.empty()) {
+                if (!parseNested(indent, true, value, error)) {
+                    return false;
+                }
+            } else if (!parseInline(line, rest, value, error)) {
+                return false;
+            }
+            node.entries.push_back({ key, value });
+        }
+        return true;
+    }
+};
+
+}
+
+const YamlNode& YamlNode::operator[](const std::string& key) const {
+    for (auto& entry : entries) {
+        if (entry.first == key) {
+            return entry.second;
+        }
+    }
+    return NULL_NODE;
+}
+
+std::string YamlNode::asString(const std::string& fallback) const {
+    return kind == Scalar ? scalar : fallback;
+}
+
+double YamlNode::asDouble(double fallback) const {
+    return kind == Scalar ? atof(scalar.c_str()) : fallback;
+}
+
+int YamlNode::asInt(int fallback) const {
+    return kind == Scalar ? atoi(scalar.c_str()) : fallback;
+}
+
+bool parseYaml(const std::string& text, YamlNode& root, std::string& error) {
+    std::vector<Line> lines;
+    std::istringstream input(text);
+    std::string raw;
+    for (int number = 1; std::getline(input, raw); number++) {
+        std::string content = stripComment(raw);
+        if (trim(content).empty()) {
+            continue;
+        }
+        if (content.find('\t') < content.find_first_not_of(" \t")) {
+            error = "line " + std::to_string(number) + ": tabs are not allowed for indentation";
+            return false;
+        }
+        int indent = (int)content.find_first_not_of(' ');
+        lines.push_back({ number, indent, trim(content) });
+    }
+    return BlockParser(lines).parse(root, error);
+}
+
+bool parseYamlFile(const std::string& path, YamlNode& root, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    if (!parseYaml(content.str(), root, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
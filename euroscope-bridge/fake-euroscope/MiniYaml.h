@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough YAML for the client's config files and the scenario files: block maps and lists,
+// flow maps and lists ({ a: 1 }, [a, b]), quoted and plain scalars, and comments.
+// Anchors, multi-line strings and documents are not supported.
+struct YamlNode {
+    enum Kind {
+        Null,
+        Scalar,
+        Map,
+        List
+    };
+
+    Kind kind = Null;
+    std::string scalar;
+    std::vector<std::pair<std::string, YamlNode>> entries;     // Map, in file order
+    std::vector<YamlNode> items;                                // List
+
+    bool isNull() const { return kind == Null; }
+
+    // Member of a map; a null node when missing
+    const YamlNode& operator[](const std::string& key) const;
+
+    std::string asString(const std::string& fallback = "") const;
+    double asDouble(double fallback = 0) const;
+    int asInt(int fallback = 0) const;
+};
+
+bool parseYaml(const std::string& text, YamlNode& root, std::string& error);
+bool parseYamlFile(const std::string& path, YamlNode& root, std::string& error);
@@ -0,0 +1,577 @@
+#include "ScenarioGenerator.h"
+#include "FakeEuroScope.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <set>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+// A 3 degree glide path
+const double FEET_PER_NM_ON_FINAL = 318;
+// Distance of synthesized STAR entry fixes from the airport
+const double ENTRY_FIX_DISTANCE_NM = 45;
+// Departures are followed for this long after take-off, then replaced
+const int DEPARTURE_TRACKED_SECONDS = 600;
+
+const char* AIRLINES[] = { "SAS", "NOZ", "DLH", "KLM", "BAW", "WIF", "FIN", "RYR", "AFR", "EZY" };
+const char* OTHER_AIRPORTS[] = { "ESSA", "EKCH", "EGLL", "EHAM", "EDDM", "LFPG", "ENBR", "ENZV", "EFHK", "LEMD" };
+
+struct AircraftType {
+    const char* icaoType;
+    char wakeCategory;
+    int cruiseTas;
+};
+
+const AircraftType AIRCRAFT_TYPES[] = {
+    { "A320", 'M', 450 }, { "B738", 'M', 455 }, { "A20N", 'M', 450 }, { "B38M", 'M', 455 },
+    { "E190", 'M', 430 }, { "DH8D", 'M', 300 }, { "AT76", 'M', 275 }, { "A359", 'H', 490 },
+    { "B77W", 'H', 490 }, { "A388", 'J', 490 }
+};
+
+template <typename T, size_t N>
+size_t countOf(const T (&)[N]) {
+    return N;
+}
+
+double toRadians(double degrees) {
+    return degrees * PI / 180;
+}
+
+// Flat-earth approximations are plenty for a terminal area
+FakeRoutePoint offset(const FakeRoutePoint& from, double bearing, double distanceNm) {
+    FakeRoutePoint point = from;
+    point.latitude += distanceNm / 60 * cos(toRadians(bearing));
+    point.longitude += distanceNm / 60 * sin(toRadians(bearing)) / cos(toRadians(from.latitude));
+    return point;
+}
+
+double distanceBetween(const FakeRoutePoint& from, const FakeRoutePoint& to) {
+    double north = (to.latitude - from.latitude) * 60;
+    double east = (to.longitude - from.longitude) * 60 * cos(toRadians((from.latitude + to.latitude) / 2));
+    return sqrt(north * north + east * east);
+}
+
+double bearingBetween(const FakeRoutePoint& from, const FakeRoutePoint& to) {
+    double north = to.latitude - from.latitude;
+    double east = (to.longitude - from.longitude) * cos(toRadians((from.latitude + to.latitude) / 2));
+    double bearing = atan2(east, north) * 180 / PI;
+    return bearing < 0 ? bearing + 360 : bearing;
+}
+
+// Stable direction for a synthesized fix, so the same name lands in the same place on every run
+double bearingForName(const std::string& name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+    return hash % 360;
+}
+
+// "01L" -> "19R", "35" -> "17"
+std::string oppositeRunway(const std::string& runway) {
+    int number = atoi(runway.c_str());
+    if (number < 1 || number > 36) {
+        return std::string();
+    }
+    char name[8];
+    snprintf(name, sizeof(name), "%02d", (number + 17) % 36 + 1);
+    std::string opposite = name;
+    char side = runway.back();
+    if (side == 'L') {
+        opposite += 'R';
+    } else if (side == 'R') {
+        opposite += 'L';
+    } else if (side == 'C') {
+        opposite += 'C';
+    }
+    return opposite;
+}
+
+std::vector<std::string> asStringList(const YamlNode& node) {
+    std::vector<std::string> values;
+    for (auto& item : node.items) {
+        values.push_back(item.asString());
+    }
+    return values;
+}
+
+bool contains(const std::vector<std::string>& values, const std::string& value) {
+    return std::find(values.begin(), values.end(), value) != values.end();
+}
+
+}
+
+bool ScenarioGenerator::load(const std::string& scenarioPath, std::string& error) {
+    YamlNode scenario;
+    if (!parseYamlFile(scenarioPath, scenario, error)) {
+        return false;
+    }
+
+    size_t slash = scenarioPath.find_last_of('/');
+    std::string scenarioDirectory = slash == std::string::npos ? "." : scenarioPath.substr(0, slash);
+
+    seed = (uint64_t)scenario["seed"].asDouble(1);
+    if (scenario["startTime"].asString() == "now") {
+        // The current UTC time, so that departures fall within the plugin's departures window
+        startTimeMinutes = (int)(time(nullptr) % (24 * 60 * 60) / 60);
+    } else {
+        int startTime = scenario["startTime"].asInt(1200);
+        startTimeMinutes = (startTime / 100) * 60 + startTime % 100;
+    }
+    radarIntervalSeconds = std::max(1, scenario["radarIntervalSeconds"].asInt(5));
+    approachLegNm = scenario["approachLegNm"].asDouble(150);
+    configDirectory = scenarioDirectory + "/" + scenario["config"].asString("../../../aman-dman-client/config");
+
+    auto& controllerNode = scenario["controller"];
+    controller.connected = true;
+    controller.callsign = controllerNode["callsign"].asString("ENGM_APP");
+    controller.positionId = controllerNode["positionId"].asString("OA");
+    controller.facility = controllerNode["facility"].asInt(5);
+
+    for (auto& fix : scenario["fixes"].entries) {
+        configuredFixes[fix.first] = { fix.first, "", fix.second["latitude"].asDouble(), fix.second["longitude"].asDouble() };
+    }
+
+    YamlNode airportsConfig;
+    if (!parseYamlFile(configDirectory + "/airports.yaml", airportsConfig, error)) {
+        return false;
+    }
+
+    airports.clear();
+    for (auto& entry : scenario["airports"].entries) {
+        if (!loadAirport(entry.first, entry.second, airportsConfig, error)) {
+            return false;
+        }
+    }
+    if (airports.empty()) {
+        error = scenarioPath + ": no airports";
+        return false;
+    }
+    return true;
+}
+
+bool ScenarioGenerator::loadAirport(const std::string& icao, const YamlNode& scenarioAirport, const YamlNode& airportsConfig, std::string& error) {
+    auto& config = airportsConfig["airports"][icao];
+    if (config.isNull()) {
+        error = icao + " is not defined in airports.yaml";
+        return false;
+    }
+
+    AirportModel airport;
+    airport.icao = icao;
+    airport.location = { icao, "", config["location"]["latitude"].asDouble(), config["location"]["longitude"].asDouble() };
+    for (auto& entry : config["runwayThresholds"].entries) {
+        Threshold threshold;
+        threshold.location = { icao, "", entry.second["location"]["latitude"].asDouble(), entry.second["location"]["longitude"].asDouble() };
+        threshold.elevation = entry.second["elevation"].asInt();
+        threshold.trueHeading = entry.second["trueHeading"].asDouble();
+        airport.thresholds[entry.first] = threshold;
+    }
+
+    airport.arrivals = scenarioAirport["arrivals"].asInt();
+    airport.departures = scenarioAirport["departures"].asInt();
+    airport.arrivalRunways = asStringList(scenarioAirport["arrivalRunways"]);
+    airport.departureRunways = asStringList(scenarioAirport["departureRunways"]);
+    airport.sids = asStringList(scenarioAirport["sids"]);
+    if (airport.arrivalRunways.empty() && !airport.thresholds.empty()) {
+        airport.arrivalRunways.push_back(airport.thresholds.begin()->first);
+    }
+    if (airport.departureRunways.empty()) {
+        airport.departureRunways = airport.arrivalRunways;
+    }
+    for (auto& runway : airport.arrivalRunways) {
+        if (airport.thresholds.count(runway) == 0) {
+            error = icao + ": runway " + runway + " has no threshold in airports.yaml";
+            return false;
+        }
+    }
+    for (auto& runway : airport.departureRunways) {
+        if (airport.thresholds.count(runway) == 0) {
+            error = icao + ": runway " + runway + " has no threshold in airports.yaml";
+            return false;
+        }
+    }
+
+    // Departures are spread over an hour unless the scenario says otherwise
+    int defaultInterval = airport.departures > 0 ? std::max(1, 3600 / airport.departures) : 60;
+    airport.departureIntervalSeconds = std::max(1, scenarioAirport["departureIntervalSeconds"].asInt(defaultInterval));
+
+    YamlNode stars;
+    std::string starsPath = configDirectory + "/stars/" + icao + ".yaml";
+    if (std::ifstream(starsPath) && !parseYamlFile(starsPath, stars, error)) {
+        return false;
+    }
+    buildRoutes(airport, stars);
+
+    airports.push_back(airport);
+    return true;
+}
+
+void ScenarioGenerator::buildRoutes(AirportModel& airport, const YamlNode& stars) {
+    // Fix positions are shared between the STARs of an airport
+    std::map<std::string, FakeRoutePoint> fixes = configuredFixes;
+
+    for (auto& star : stars["stars"].items) {
+        ArrivalRoute route;
+        route.starName = star["name"].asString();
+        route.runway = star["runway"].asString();
+        if (!contains(airport.arrivalRunways, route.runway)) {
+            continue;
+        }
+        for (auto& waypoint : star["waypoints"].items) {
+            route.points.push_back({ waypoint["id"].asString(), route.starName, 0, 0 });
+            route.altitudes.push_back(waypoint["typicalAltitude"].asInt(-1));
+            route.speeds.push_back(waypoint["typicalSpeed"].asInt(-1));
+        }
+        finishRoute(airport, route, fixes);
+    }
+
+    // No STARs configured: straight in from the four quadrants
+    if (airport.routes.empty()) {
+        static const char* QUADRANTS[] = { "NE", "SE", "SW", "NW" };
+        for (auto& runway : airport.arrivalRunways) {
+            auto& threshold = airport.thresholds[runway];
+            for (int quadrant = 0; quadrant < 4; quadrant++) {
+                ArrivalRoute route;
+                route.runway = runway;
+                std::string entryName = airport.icao + QUADRANTS[quadrant];
+                if (fixes.count(entryName) == 0) {
+                    fixes[entryName] = offset(airport.location, 45 + quadrant * 90, ENTRY_FIX_DISTANCE_NM);
+                }
+                route.points.push_back({ entryName, "", 0, 0 });
+                route.points.push_back({ "FF" + runway, "", 0, 0 });
+                route.altitudes = { -1, threshold.elevation + 3000 };
+                route.speeds = { 250, 180 };
+                finishRoute(airport, route, fixes);
+            }
+        }
+    }
+}
+
+void ScenarioGenerator::finishRoute(AirportModel& airport, ArrivalRoute& route, std::map<std::string, FakeRoutePoint>& fixes) {
+    auto& threshold = airport.thresholds[route.runway];
+
+    if (route.points.empty() || route.points.back().name != airport.icao) {
+        route.points.push_back({ airport.icao, "", 0, 0 });
+        route.altitudes.push_back(-1);
+        route.speeds.push_back(-1);
+    }
+    if (route.points.size() < 3) {
+        return;
+    }
+
+    size_t last = route.points.size() - 1;
+    size_t finalFix = last - 1;
+
+    // The STARs only name their fixes. The last one before the airport goes on the extended
+    // centreline at glide path distance, the first one on a ring around the airport, and the
+    // ones in between on the line joining the two.
+    auto& finalName = route.points[finalFix].name;
+    if (fixes.count(finalName) == 0) {
+        int altitude = route.altitudes[finalFix] > 0 ? route.altitudes[finalFix] : threshold.elevation + 3000;
+        double distance = std::max(4.0, (altitude - threshold.elevation) / FEET_PER_NM_ON_FINAL);
+        fixes[finalName] = offset(threshold.location, threshold.trueHeading + 180, distance);
+    }
+    auto& entryName = route.points[0].name;
+    if (fixes.count(entryName) == 0) {
+        fixes[entryName] = offset(airport.location, bearingForName(entryName), ENTRY_FIX_DISTANCE_NM);
+    }
+    for (size_t i = 1; i < finalFix; i++) {
+        auto& name = route.points[i].name;
+        if (fixes.count(name) == 0) {
+            double fraction = (double)i / finalFix;
+            FakeRoutePoint point;
+            point.latitude = fixes[entryName].latitude + (fixes[finalName].latitude - fixes[entryName].latitude) * fraction;
+            point.longitude = fixes[entryName].longitude + (fixes[finalName].longitude - fixes[entryName].longitude) * fraction;
+            fixes[name] = point;
+        }
+    }
+
+    for (size_t i = 0; i < last; i++) {
+        route.points[i].latitude = fixes[route.points[i].name].latitude;
+        route.points[i].longitude = fixes[route.points[i].name].longitude;
+    }
+    route.points[last].latitude = threshold.location.latitude;
+    route.points[last].longitude = threshold.location.longitude;
+
+    // Missing altitudes are interpolated between their neighbours, missing speeds carried over
+    route.altitudes[last] = threshold.elevation;
+    if (route.altitudes[0] < 0) {
+        route.altitudes[0] = 12000;
+    }
+    for (size_t i = 1; i < last; i++) {
+        if (route.altitudes[i] >= 0) {
+            continue;
+        }
+        size_t next = i + 1;
+        while (route.altitudes[next] < 0) {
+            next++;
+        }
+        double fraction = 1.0 / (next - i + 1);
+        route.altitudes[i] = (int)(route.altitudes[i - 1] + (route.altitudes[next] - route.altitudes[i - 1]) * fraction);
+    }
+    if (route.speeds[0] < 0) {
+        route.speeds[0] = 250;
+    }
+    for (size_t i = 1; i <= last; i++) {
+        if (route.speeds[i] < 0) {
+            route.speeds[i] = i == last ? 140 : route.speeds[i - 1];
+        }
+    }
+
+    route.distances.push_back(0);
+    for (size_t i = 1; i <= last; i++) {
+        route.distances.push_back(route.distances.back() + distanceBetween(route.points[i - 1], route.points[i]));
+    }
+
+    airport.routes.push_back(route);
+}
+
+void ScenarioGenerator::populate(FakeTraffic& traffic) {
+    rngState = seed;
+    simulatedSeconds = 0;
+    nextSerial = 0;
+    flights.clear();
+    traffic.clear();
+    traffic.airports.clear();
+    traffic.runways.clear();
+    traffic.myself = controller;
+
+    for (auto& airport : airports) {
+        traffic.airports.push_back(airport.icao);
+
+        std::set<std::string> paired;
+        for (auto& entry : airport.thresholds) {
+            if (paired.count(entry.first) != 0) {
+                continue;
+            }
+            FakeRunway runway;
+            runway.airportIcao = airport.icao;
+            runway.names[0] = entry.first;
+            auto opposite = oppositeRunway(entry.first);
+            if (airport.thresholds.count(opposite) != 0) {
+                runway.names[1] = opposite;
+                paired.insert(opposite);
+            }
+            for (int direction = 0; direction < 2; direction++) {
+                runway.activeForArrivals[direction] = contains(airport.arrivalRunways, runway.names[direction]);
+                runway.activeForDepartures[direction] = contains(airport.departureRunways, runway.names[direction]);
+            }
+            traffic.runways.push_back(runway);
+        }
+    }
+
+    for (size_t i = 0; i < airports.size(); i++) {
+        if (airports[i].routes.empty()) {
+            continue;
+        }
+        // Spread the initial arrivals over the whole way in
+        for (int n = 0; n < airports[i].arrivals; n++) {
+            spawnArrival(traffic, i, nextUniform());
+        }
+        airports[i].nextDepartureSlot = airports[i].departureIntervalSeconds;
+        for (int n = 0; n < airports[i].departures; n++) {
+            spawnDeparture(traffic, i);
+        }
+    }
+}
+
+void ScenarioGenerator::advance(FakeTraffic& traffic) {
+    simulatedSeconds++;
+
+    std::vector<std::string> finished;
+    for (auto& entry : flights) {
+        auto& flight = entry.second;
+        if (simulatedSeconds % radarIntervalSeconds != flight.radarPhase) {
+            continue;
+        }
+        auto aircraft = traffic.find(entry.first);
+        if (aircraft == nullptr) {
+            continue;
+        }
+
+        if (flight.arrival) {
+            auto& route = airports[flight.airport].routes[flight.routeIndex];
+            flight.distanceFlown += aircraft->groundSpeed * radarIntervalSeconds / 3600.0;
+            if (flight.distanceFlown >= route.distances.back()) {
+                finished.push_back(entry.first);
+                continue;
+            }
+            placeArrival(*aircraft, flight);
+        } else {
+            if (simulatedSeconds < flight.offBlockSecond) {
+                continue;
+            }
+            if (simulatedSeconds - flight.offBlockSecond > DEPARTURE_TRACKED_SECONDS) {
+                finished.push_back(entry.first);
+                continue;
+            }
+            aircraft->hasRadarTarget = true;
+            placeDeparture(*aircraft, flight);
+        }
+        FakeEuroScope::radarTargetPositionUpdate(entry.first);
+    }
+
+    // Landed and departed aircraft make room for new ones, keeping the load steady
+    for (auto& callsign : finished) {
+        auto flight = flights[callsign];
+        FakeEuroScope::flightPlanDisconnect(callsign);
+        flights.erase(callsign);
+        if (flight.arrival) {
+            spawnArrival(traffic, flight.airport, 0);
+        } else {
+            spawnDeparture(traffic, flight.airport);
+        }
+    }
+}
+
+uint64_t ScenarioGenerator::nextRandom() {
+    // splitmix64: the same sequence on every platform and standard library
+    uint64_t z = (rngState += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double ScenarioGenerator::nextUniform() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+std::string ScenarioGenerator::nextCallsign() {
+    return AIRLINES[nextRandom() % countOf(AIRLINES)] + std::to_string(100 + nextSerial++);
+}
+
+void ScenarioGenerator::spawnArrival(FakeTraffic& traffic, size_t airportIndex, double progress) {
+    auto& airport = airports[airportIndex];
+
+    Flight flight;
+    flight.airport = airportIndex;
+    flight.arrival = true;
+    flight.routeIndex = (int)(nextRandom() % airport.routes.size());
+    flight.radarPhase = (int)(nextRandom() % radarIntervalSeconds);
+    auto& route = airport.routes[flight.routeIndex];
+    // Progress 0 is the start of the inbound leg, 1 the threshold
+    flight.distanceFlown = -approachLegNm + progress * (approachLegNm + route.distances.back()) * 0.99;
+
+    auto& type = AIRCRAFT_TYPES[nextRandom() % countOf(AIRCRAFT_TYPES)];
+    FakeAircraft aircraft;
+    aircraft.callsign = nextCallsign();
+    aircraft.origin = OTHER_AIRPORTS[nextRandom() % countOf(OTHER_AIRPORTS)];
+    aircraft.destination = airport.icao;
+    aircraft.icaoType = type.icaoType;
+    aircraft.wakeCategory = type.wakeCategory;
+    aircraft.trueAirspeed = type.cruiseTas;
+    aircraft.starName = route.starName;
+    aircraft.arrivalRunway = route.runway;
+    aircraft.route = route.points[0].name + (route.starName.empty() ? "" : " " + route.starName);
+    aircraft.routePoints = route.points;
+    placeArrival(aircraft, flight);
+
+    traffic.add(aircraft);
+    flights[aircraft.callsign] = flight;
+    FakeEuroScope::flightPlanDataUpdate(aircraft.callsign);
+}
+
+void ScenarioGenerator::spawnDeparture(FakeTraffic& traffic, size_t airportIndex) {
+    auto& airport = airports[airportIndex];
+
+    Flight flight;
+    flight.airport = airportIndex;
+    flight.arrival = false;
+    flight.offBlockSecond = airport.nextDepartureSlot;
+    flight.radarPhase = (int)(nextRandom() % radarIntervalSeconds);
+    airport.nextDepartureSlot += airport.departureIntervalSeconds;
+
+    auto& type = AIRCRAFT_TYPES[nextRandom() % countOf(AIRCRAFT_TYPES)];
+    FakeAircraft aircraft;
+    aircraft.callsign = nextCallsign();
+    aircraft.origin = airport.icao;
+    aircraft.destination = OTHER_AIRPORTS[nextRandom() % countOf(OTHER_AIRPORTS)];
+    aircraft.icaoType = type.icaoType;
+    aircraft.wakeCategory = type.wakeCategory;
+    aircraft.trueAirspeed = type.cruiseTas;
+    aircraft.departureRunway = airport.departureRunways[nextRandom() % airport.departureRunways.size()];
+    aircraft.sidName = airport.sids.empty() ? "" : airport.sids[nextRandom() % airport.sids.size()];
+    aircraft.estimatedDepartureTime = formatTime(flight.offBlockSecond);
+    aircraft.hasRadarTarget = false;
+    placeDeparture(aircraft, flight);
+
+    traffic.add(aircraft);
+    flights[aircraft.callsign] = flight;
+    FakeEuroScope::flightPlanDataUpdate(aircraft.callsign);
+}
+
+void ScenarioGenerator::placeArrival(FakeAircraft& aircraft, const Flight& flight) {
+    auto& airport = airports[flight.airport];
+    auto& route = airport.routes[flight.routeIndex];
+
+    FakeRoutePoint position;
+    double track;
+    int altitude;
+    int speed;
+    int nextPoint;
+
+    if (flight.distanceFlown < 0) {
+        // Inbound leg towards the entry fix, descending from cruise
+        double outbound = bearingBetween(airport.location, route.points[0]);
+        position = offset(route.points[0], outbound, -flight.distanceFlown);
+        track = fmod(outbound + 180, 360);
+        double fraction = -flight.distanceFlown / approachLegNm;
+        altitude = (int)(route.altitudes[0] + (35000 - route.altitudes[0]) * fraction);
+        speed = 280;
+        nextPoint = 0;
+    } else {
+        size_t segment = 0;
+        while (segment + 2 < route.distances.size() && route.distances[segment + 1] <= flight.distanceFlown) {
+            segment++;
+        }
+        auto& from = route.points[segment];
+        auto& to = route.points[segment + 1];
+        double length = route.distances[segment + 1] - route.distances[segment];
+        double fraction = length > 0 ? (flight.distanceFlown - route.distances[segment]) / length : 1;
+        position.latitude = from.latitude + (to.latitude - from.latitude) * fraction;
+        position.longitude = from.longitude + (to.longitude - from.longitude) * fraction;
+        track = bearingBetween(from, to);
+        altitude = (int)(route.altitudes[segment] + (route.altitudes[segment + 1] - route.altitudes[segment]) * fraction);
+        speed = route.speeds[segment + 1];
+        nextPoint = (int)segment + 1;
+    }
+
+    aircraft.latitude = position.latitude;
+    aircraft.longitude = position.longitude;
+    aircraft.trackHeading = track;
+    aircraft.pressureAltitude = altitude;
+    aircraft.flightLevel = altitude;
+    // Indicated to ground speed, roughly 2% per 1000 ft in still air
+    aircraft.groundSpeed = (int)(speed * (1 + 0.02 * altitude / 1000));
+    aircraft.pointsCalculatedIndex = nextPoint;
+}
+
+void ScenarioGenerator::placeDeparture(FakeAircraft& aircraft, const Flight& flight) {
+    auto& airport = airports[flight.airport];
+    auto& threshold = airport.thresholds[aircraft.departureRunway];
+
+    int airborneSeconds = std::max(0, simulatedSeconds - flight.offBlockSecond);
+    int speed = 160 + std::min(airborneSeconds, 300) * 120 / 300;
+    auto position = offset(threshold.location, threshold.trueHeading, speed * airborneSeconds / 3600.0);
+
+    aircraft.latitude = position.latitude;
+    aircraft.longitude = position.longitude;
+    aircraft.trackHeading = threshold.trueHeading;
+    aircraft.pressureAltitude = std::min(threshold.elevation + airborneSeconds * 40, 20000);
+    aircraft.flightLevel = aircraft.pressureAltitude;
+    aircraft.groundSpeed = airborneSeconds > 0 ? speed : 0;
+}
+
+std::string ScenarioGenerator::formatTime(int simulatedSecond) const {
+    int minutes = (startTimeMinutes + simulatedSecond / 60) % (24 * 60);
+    char time[8];
+    snprintf(time, sizeof(time), "%02d%02d", minutes / 60, minutes % 60);
+    return time;
+}
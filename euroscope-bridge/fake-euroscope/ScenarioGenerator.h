@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FakeTraffic.h"
+#include "MiniYaml.h"
+
+// Synthetic traffic for benchmarks, described by a scenario file (see scenarios/). Arrivals fly
+// the STARs from the client's config towards the runway thresholds in airports.yaml, departures
+// wait for their EOBT and climb out. Landed and departed aircraft are replaced, so each airport
+// keeps its configured number of arrivals and departures. Everything is derived from the seed,
+// so a scenario produces the same traffic on every run and at any speed.
+class ScenarioGenerator {
+public:
+    bool load(const std::string& scenarioPath, std::string& error);
+    void setSeed(uint64_t seed) { this->seed = seed; }
+
+    // Sector file data and the initial traffic at simulated second 0
+    void populate(FakeTraffic& traffic);
+    // One simulated second: moves aircraft whose radar update is due and replaces landed and
+    // departed ones, raising the callbacks EuroScope would
+    void advance(FakeTraffic& traffic);
+
+    int getSimulatedSeconds() const { return simulatedSeconds; }
+    size_t getAircraftCount() const { return flights.size(); }
+
+private:
+    struct Threshold {
+        FakeRoutePoint location;
+        int elevation = 0;
+        double trueHeading = 0;
+    };
+
+    struct ArrivalRoute {
+        std::string starName;
+        std::string runway;
+        std::vector<FakeRoutePoint> points;     // Entry fix to threshold
+        std::vector<int> altitudes;
+        std::vector<int> speeds;
+        std::vector<double> distances;          // Along the route from the entry fix, NM
+    };
+
+    struct AirportModel {
+        std::string icao;
+        FakeRoutePoint location;
+        std::map<std::string, Threshold> thresholds;
+        int arrivals = 0;
+        int departures = 0;
+        std::vector<std::string> arrivalRunways;
+        std::vector<std::string> departureRunways;
+        std::vector<std::string> sids;
+        std::vector<ArrivalRoute> routes;
+        int nextDepartureSlot = 0;              // Simulated second of the next EOBT to hand out
+        int departureIntervalSeconds = 60;
+    };
+
+    struct Flight {
+        size_t airport;
+        bool arrival;
+        int routeIndex = 0;                     // Arrivals
+        double distanceFlown = 0;               // Along the route, negative before the entry fix
+        int offBlockSecond = 0;                 // Departures
+        int radarPhase = 0;                     // Radar updates happen when the second matches
+    };
+
+    uint64_t seed = 1;
+    uint64_t rngState = 0;
+    int startTimeMinutes = 12 * 60;
+    int radarIntervalSeconds = 5;
+    double approachLegNm = 150;
+    std::string configDirectory;
+    std::map<std::string, FakeRoutePoint> configuredFixes;
+    FakeController controller;
+
+    std::vector<AirportModel> airports;
+    std::map<std::string, Flight> flights;      // By callsign
+    int simulatedSeconds = 0;
+    int nextSerial = 0;
+
+    bool loadAirport(const std::string& icao, const YamlNode& scenarioAirport, const YamlNode& airportsConfig, std::string& error);
+    void buildRoutes(AirportModel& airport, const YamlNode& stars);
+    void finishRoute(AirportModel& airport, ArrivalRoute& route, std::map<std::string, FakeRoutePoint>& fixes);
+
+    uint64_t nextRandom();
+    double nextUniform();
+    std::string nextCallsign();
+
+    void spawnArrival(FakeTraffic& traffic, size_t airportIndex, double progress);
+    void spawnDeparture(FakeTraffic& traffic, size_t airportIndex);
+    void placeArrival(FakeAircraft& aircraft, const Flight& flight);
+    void placeDeparture(FakeAircraft& aircraft, const Flight& flight);
+    std::string formatTime(int simulatedSecond) const;
+};
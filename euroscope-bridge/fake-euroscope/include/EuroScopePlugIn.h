@@ -0,0 +1,21 @@
+#pragma once
+
+// Makes the SDK header digestible for GCC and Clang: it expects windows.h to be included
+// already, and relies on MSVC accepting two classes before their declaration and "= NULL" as
+// a pure specifier.
+
+#include <windows.h>
+
+#define DllSpecEuroScope
+#define ESINDEX void *
+
+namespace EuroScopePlugIn {
+class CRadarTarget;
+class CPlugIn;
+}
+
+#pragma push_macro("NULL")
+#undef NULL
+#define NULL 0
+#include_next <EuroScopePlugIn.h>
+#pragma pop_macro("NULL")
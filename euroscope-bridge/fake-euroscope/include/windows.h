@@ -0,0 +1,48 @@
+#pragma once
+
+// The handful of Win32 declarations the plugin sources and EuroScopePlugIn.h rely on,
+// so they compile unchanged on Linux against the fake EuroScope runtime.
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#define __declspec(x)
+
+#ifndef _MAX_PATH
+#define _MAX_PATH 260
+#endif
+
+typedef uint32_t DWORD;
+typedef uint32_t COLORREF;
+typedef void* HDC;
+typedef void* HWND;
+typedef void* HINSTANCE;
+
+typedef struct tagRECT {
+    long left;
+    long top;
+    long right;
+    long bottom;
+} RECT;
+
+typedef struct tagPOINT {
+    long x;
+    long y;
+} POINT;
+
+// Stands in for the linker-provided base address of the plugin DLL
+extern "C" char __ImageBase;
+
+// Reports the plugin as living in the current directory
+DWORD GetModuleFileNameA(HINSTANCE module, char* fileName, DWORD size);
+
+inline int gmtime_s(struct tm* result, const time_t* time) {
+    return gmtime_r(time, result) != nullptr ? 0 : errno;
+}
+
+inline time_t _mkgmtime(struct tm* time) {
+    return timegm(time);
+}
@@ -0,0 +1,192 @@
+#include "FakeEuroScope.h"
+#include "ScenarioGenerator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Runs a scenario through the plugin with clients connected and checks that, once warmed up,
+// OnTimer plus the publisher and I/O threads stay within an allocation budget per tick. Counts
+// every operator new on the plugin's threads; the traffic generator and the test's own client
+// threads are left out.
+//
+//   aman-allocation-test SCENARIO [--budget-per-tick N]
+
+static const int WARM_UP_TICKS = 30;
+static const int MEASURED_TICKS = 40;
+// What a steady-state engm-peak tick with these clients allocates, all of it per published message
+// and none per aircraft: each message becomes a frame that outlives the tick in the clients' send
+// queues (its string, shared_ptr control block and coalesce key), and the CBOR client's copies are
+// re-encoded from JSON (parse stack and output). Anything new on the tick shows up as a failure.
+static const double DEFAULT_BUDGET_PER_TICK = 24;
+static const int BRIDGE_PORT = 12345;
+
+static std::atomic<uint64_t> allocations(0);
+static thread_local bool notCounted = false;
+
+void* operator new(size_t size) {
+    if (!notCounted) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* memory = std::malloc(size > 0 ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+// Scope in which the calling thread's allocations are not counted
+class NotCounted {
+public:
+    NotCounted() : previous(notCounted) { notCounted = true; }
+    ~NotCounted() { notCounted = previous; }
+
+private:
+    bool previous;
+};
+
+// A client that registers for an airport and reads whatever it is sent until the socket closes
+class DrainingClient {
+public:
+    bool connect(const std::string& registerMessage) {
+        NotCounted notCountedHere;
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(BRIDGE_PORT);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        // The server thread may not be listening yet
+        for (int attempt = 0; attempt < 50; attempt++) {
+            socketFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (::connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+                std::string line = registerMessage + "\n";
+                send(socketFd, line.data(), line.size(), 0);
+                reader = std::thread([this] { drain(); });
+                return true;
+            }
+            close(socketFd);
+            socketFd = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+
+    void disconnect() {
+        if (socketFd >= 0) {
+            shutdown(socketFd, SHUT_RDWR);
+        }
+        if (reader.joinable()) {
+            reader.join();
+        }
+        if (socketFd >= 0) {
+            close(socketFd);
+            socketFd = -1;
+        }
+    }
+
+    uint64_t getBytesReceived() const { return bytesReceived; }
+
+private:
+    void drain() {
+        notCounted = true;
+        char buffer[64 * 1024];
+        ssize_t received;
+        while ((received = recv(socketFd, buffer, sizeof(buffer), 0)) > 0) {
+            bytesReceived += received;
+        }
+    }
+
+    int socketFd = -1;
+    std::thread reader;
+    std::atomic<uint64_t> bytesReceived{ 0 };
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: aman-allocation-test SCENARIO [--budget-per-tick N]\n");
+        return 2;
+    }
+    double budgetPerTick = DEFAULT_BUDGET_PER_TICK;
+    if (argc >= 4 && std::strcmp(argv[2], "--budget-per-tick") == 0) {
+        budgetPerTick = std::atof(argv[3]);
+    }
+
+    ScenarioGenerator generator;
+    std::string error;
+    {
+        NotCounted notCountedHere;
+        if (!generator.load(argv[1], error)) {
+            std::fprintf(stderr, "Cannot load scenario: %s\n", error.c_str());
+            return 2;
+        }
+    }
+
+    auto& traffic = FakeEuroScope::traffic();
+    FakeEuroScope::loadPlugIn();
+    {
+        NotCounted notCountedHere;
+        generator.populate(traffic);
+    }
+
+    // Full arrivals, a delta stream and a CBOR client: every publishing path the plugin has
+    DrainingClient clients[3];
+    const char* registrations[3] = {
+        "{\"type\":\"registerAirport\",\"icao\":\"ENGM\"}",
+        "{\"type\":\"registerAirport\",\"icao\":\"ENGM\",\"arrivalsDelta\":true,\"departuresDelta\":true}",
+        "{\"type\":\"selectCodec\",\"codec\":\"cbor\"}\n{\"type\":\"registerAirport\",\"icao\":\"ENGM\"}",
+    };
+    for (int i = 0; i < 3; i++) {
+        if (!clients[i].connect(registrations[i])) {
+            std::fprintf(stderr, "Cannot connect to the bridge on port %d\n", BRIDGE_PORT);
+            return 2;
+        }
+    }
+
+    uint64_t measuredAllocations = 0;
+    for (int tick = 1; tick <= WARM_UP_TICKS + MEASURED_TICKS; tick++) {
+        {
+            NotCounted notCountedHere;
+            generator.advance(traffic);
+        }
+        if (tick == WARM_UP_TICKS + 1) {
+            measuredAllocations = allocations.load();
+        }
+        FakeEuroScope::timer(tick);
+        // Lets the publisher and I/O threads finish the tick, as the one-second timer would
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    measuredAllocations = allocations.load() - measuredAllocations;
+
+    for (auto& client : clients) {
+        client.disconnect();
+    }
+    FakeEuroScope::unloadPlugIn();
+
+    double perTick = static_cast<double>(measuredAllocations) / MEASURED_TICKS;
+    std::printf("%d ticks after %d to warm up: %llu allocations, %.1f per tick (budget %.1f)\n", MEASURED_TICKS, WARM_UP_TICKS,
+        static_cast<unsigned long long>(measuredAllocations), perTick, budgetPerTick);
+    for (int i = 0; i < 3; i++) {
+        if (clients[i].getBytesReceived() == 0) {
+            std::fprintf(stderr, "Client %d received nothing\n", i + 1);
+            return 1;
+        }
+    }
+    return perTick <= budgetPerTick ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include "FakeEuroScope.h"
+#include "ScenarioGenerator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Runs a scenario through the plugin with several clients on the same airport, one of which
+// never reads. Checks that every reading client gets the arrivals of each tick while the stalled
+// one's socket is full, so one slow peer holds up neither the others nor OnTimer.
+//
+//   aman-fan-out-test SCENARIO
+
+static const int READING_CLIENTS = 4;
+static const int WARM_UP_TICKS = 10;
+static const int MEASURED_TICKS = 60;
+// Arrivals a reading client may miss over the measured ticks, for frames still in flight
+static const int MISSED_ARRIVALS_ALLOWED = 3;
+// OnTimer only reads the traffic, so a stalled client must not show up in it
+static const double MAX_TIMER_MILLIS = 100;
+static const int BRIDGE_PORT = 12345;
+static const char REGISTER_ENGM[] = "{\"type\":\"registerAirport\",\"icao\":\"ENGM\"}\n";
+static const char ARRIVALS_TYPE[] = "{\"type\":\"arrivals\"";
+
+static int connectToBridge(int receiveBufferBytes) {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(BRIDGE_PORT);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // The server thread may not be listening yet
+    for (int attempt = 0; attempt < 50; attempt++) {
+        int socketFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (receiveBufferBytes > 0) {
+            setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &receiveBufferBytes, sizeof(receiveBufferBytes));
+        }
+        if (::connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            send(socketFd, REGISTER_ENGM, sizeof(REGISTER_ENGM) - 1, 0);
+            return socketFd;
+        }
+        close(socketFd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return -1;
+}
+
+// Reads newline-delimited frames until the socket closes, counting the arrivals among them
+class ReadingClient {
+public:
+    bool connect() {
+        socketFd = connectToBridge(0);
+        if (socketFd < 0) {
+            return false;
+        }
+        reader = std::thread([this] { read(); });
+        return true;
+    }
+
+    void disconnect() {
+        if (socketFd >= 0) {
+            shutdown(socketFd, SHUT_RDWR);
+        }
+        if (reader.joinable()) {
+            reader.join();
+        }
+        if (socketFd >= 0) {
+            close(socketFd);
+            socketFd = -1;
+        }
+    }
+
+    int getArrivalsReceived() const { return arrivalsReceived; }
+    uint64_t getBytesReceived() const { return bytesReceived; }
+
+private:
+    void read() {
+        std::string pending;
+        char buffer[64 * 1024];
+        ssize_t received;
+        while ((received = recv(socketFd, buffer, sizeof(buffer), 0)) > 0) {
+            bytesReceived += received;
+            pending.append(buffer, received);
+            size_t start = 0;
+            size_t newline;
+            while ((newline = pending.find('\n', start)) != std::string::npos) {
+                if (pending.compare(start, sizeof(ARRIVALS_TYPE) - 1, ARRIVALS_TYPE) == 0) {
+                    arrivalsReceived++;
+                }
+                start = newline + 1;
+            }
+            pending.erase(0, start);
+        }
+    }
+
+    int socketFd = -1;
+    std::thread reader;
+    std::atomic<int> arrivalsReceived{ 0 };
+    std::atomic<uint64_t> bytesReceived{ 0 };
+};
+
+// Bytes waiting on a socket nobody has read from, without blocking
+static uint64_t drainWithoutBlocking(int socketFd) {
+    uint64_t bytes = 0;
+    char buffer[64 * 1024];
+    ssize_t received;
+    while ((received = recv(socketFd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        bytes += received;
+    }
+    return bytes;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: aman-fan-out-test SCENARIO\n");
+        return 2;
+    }
+
+    ScenarioGenerator generator;
+    std::string error;
+    if (!generator.load(argv[1], error)) {
+        std::fprintf(stderr, "Cannot load scenario: %s\n", error.c_str());
+        return 2;
+    }
+
+    auto& traffic = FakeEuroScope::traffic();
+    FakeEuroScope::loadPlugIn();
+    generator.populate(traffic);
+
+    // The stalled client registers like the others and then never reads
+    int stalledSocket = connectToBridge(4096);
+    ReadingClient clients[READING_CLIENTS];
+    bool connected = stalledSocket >= 0;
+    for (int i = 0; connected && i < READING_CLIENTS; i++) {
+        connected = clients[i].connect();
+    }
+    if (!connected) {
+        std::fprintf(stderr, "Cannot connect to the bridge on port %d\n", BRIDGE_PORT);
+        return 2;
+    }
+
+    int arrivalsBefore[READING_CLIENTS] = {};
+    double maxTimerMillis = 0;
+    for (int tick = 1; tick <= WARM_UP_TICKS + MEASURED_TICKS; tick++) {
+        generator.advance(traffic);
+        if (tick == WARM_UP_TICKS + 1) {
+            for (int i = 0; i < READING_CLIENTS; i++) {
+                arrivalsBefore[i] = clients[i].getArrivalsReceived();
+            }
+        }
+        auto started = std::chrono::steady_clock::now();
+        FakeEuroScope::timer(tick);
+        double timerMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        if (tick > WARM_UP_TICKS && timerMillis > maxTimerMillis) {
+            maxTimerMillis = timerMillis;
+        }
+        // Lets the publisher and I/O threads finish the tick, as the one-second timer would
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    for (auto& client : clients) {
+        client.disconnect();
+    }
+    uint64_t stalledBytes = drainWithoutBlocking(stalledSocket);
+    close(stalledSocket);
+    FakeEuroScope::unloadPlugIn();
+
+    bool passed = true;
+    std::printf("OnTimer at most %.2f ms over %d ticks; the stalled client had %llu bytes waiting\n", maxTimerMillis,
+        MEASURED_TICKS, static_cast<unsigned long long>(stalledBytes));
+    for (int i = 0; i < READING_CLIENTS; i++) {
+        int arrivals = clients[i].getArrivalsReceived() - arrivalsBefore[i];
+        std::printf("Client %d: %d arrivals in %d ticks, %llu bytes\n", i + 1, arrivals, MEASURED_TICKS,
+            static_cast<unsigned long long>(clients[i].getBytesReceived()));
+        if (arrivals < MEASURED_TICKS - MISSED_ARRIVALS_ALLOWED) {
+            std::fprintf(stderr, "Client %d fell behind\n", i + 1);
+            passed = false;
+        }
+        // Otherwise the stalled client kept up and the test did not stall anything
+        if (clients[i].getBytesReceived() <= stalledBytes) {
+            std::fprintf(stderr, "The stalled client's socket never filled up\n");
+            passed = false;
+        }
+    }
+    if (maxTimerMillis > MAX_TIMER_MILLIS) {
+        std::fprintf(stderr, "OnTimer took %.2f ms\n", maxTimerMillis);
+        passed = false;
+    }
+    return passed ? 0 : 1;
+}
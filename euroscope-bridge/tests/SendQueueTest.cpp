@@ -0,0 +1,114 @@
+#include "CoalescingSendQueue.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+// What CoalescingSendQueue keeps and what it evicts to stay under its byte cap: snapshots are
+// replaced by newer copies and go first, stream frames go from the tail and report the loss,
+// frames that must be kept stay even over the cap, and a half-written head frame is never touched.
+//
+//   aman-send-queue-test
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (false)
+
+// A JSON frame taking `wireBytes` on the wire, its newline included
+static SharedFrame frameOf(size_t wireBytes, char fill) {
+    return std::make_shared<const std::string>("{" + std::string(wireBytes - 2, fill));
+}
+
+static void newerSnapshotReplacesQueuedOne() {
+    CoalescingSendQueue queue(1000);
+    CHECK(queue.push(frameOf(30, 'a'), "arrivals/ENGM", RetainLatest));
+    CHECK(queue.push(frameOf(40, 'b'), "arrivals/ENGM", RetainLatest));
+    CHECK(queue.getStats().queuedFrames == 1);
+    CHECK(queue.getStats().queuedBytes == 40);
+    CHECK(queue.getStats().framesCoalesced == 1);
+}
+
+static void snapshotsAreEvictedBeforeStreams() {
+    CoalescingSendQueue queue(100);
+    queue.push(frameOf(30, 's'), "", RetainStream);
+    queue.push(frameOf(30, 'l'), "arrivals/ENGM", RetainLatest);
+    queue.push(frameOf(30, 'a'), "", RetainAlways);
+    CHECK(queue.push(frameOf(30, 't'), "", RetainStream));
+    CHECK(queue.getStats().queuedFrames == 3);
+    CHECK(queue.getStats().queuedBytes == 90);
+    CHECK(queue.getStats().framesDropped == 1);
+    CHECK(!queue.takeStreamLoss());
+}
+
+static void streamsAreEvictedFromTheTail() {
+    CoalescingSendQueue queue(100);
+    queue.push(frameOf(30, 's'), "", RetainStream);
+    queue.push(frameOf(30, 't'), "", RetainStream);
+    queue.push(frameOf(30, 'a'), "", RetainAlways);
+    CHECK(queue.push(frameOf(30, 'b'), "", RetainAlways));
+    CHECK(queue.getStats().queuedBytes == 90);
+
+    // The older stream frame is left, so what was queued of the stream is still a prefix of it
+    SendSlice slices[8];
+    size_t bytes = 0;
+    queue.gather(slices, 8, bytes);
+    CHECK(slices[0].length == 29 && slices[0].data[1] == 's');
+    CHECK(queue.takeStreamLoss());
+    CHECK(!queue.takeStreamLoss());
+}
+
+static void pushedFrameCanBeTheOneEvicted() {
+    CoalescingSendQueue queue(50);
+    queue.push(frameOf(40, 'a'), "", RetainAlways);
+    CHECK(!queue.push(frameOf(20, 'l'), "arrivals/ENGM", RetainLatest));
+    CHECK(!queue.push(frameOf(20, 's'), "", RetainStream));
+    CHECK(queue.takeStreamLoss());
+    CHECK(queue.getStats().queuedFrames == 1);
+    CHECK(!queue.isOverCap());
+}
+
+static void framesThatMustBeKeptStayOverTheCap() {
+    CoalescingSendQueue queue(50);
+    CHECK(queue.push(frameOf(40, 'a'), "", RetainAlways));
+    CHECK(queue.push(frameOf(40, 'b'), "", RetainAlways));
+    CHECK(queue.isOverCap());
+    CHECK(queue.getStats().framesDropped == 0);
+}
+
+static void halfWrittenHeadIsNeverEvicted() {
+    CoalescingSendQueue queue(50);
+    queue.push(frameOf(30, 'l'), "arrivals/ENGM", RetainLatest);
+    queue.consume(10);
+    CHECK(queue.push(frameOf(30, 'a'), "", RetainAlways));
+    CHECK(queue.isOverCap());
+    CHECK(queue.getStats().framesDropped == 0);
+
+    // Nor replaced, as the rest of it still has to follow what was written; the newer copy is
+    // queued behind it instead, and evicted as it is over the cap
+    CHECK(!queue.push(frameOf(20, 'm'), "arrivals/ENGM", RetainLatest));
+    CHECK(queue.getStats().framesCoalesced == 0);
+    queue.consume(20);
+    CHECK(queue.getStats().queuedFrames == 1);
+}
+
+int main() {
+    newerSnapshotReplacesQueuedOne();
+    snapshotsAreEvictedBeforeStreams();
+    streamsAreEvictedFromTheTail();
+    pushedFrameCanBeTheOneEvicted();
+    framesThatMustBeKeptStayOverTheCap();
+    halfWrittenHeadIsNeverEvicted();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("All send queue checks passed\n");
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include "CaptureReader.h"
+#include "SocketLayer.h"
+#include "WireCodec.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+
+// Serves the frames one client received in a capture (see CaptureFormat.h) to whoever connects
+// to the bridge port, with the original timing scaled by --speed ("max" sends without pausing).
+// Whatever the connected client sends is read and discarded.
+//
+//   aman-replay FILE [--client N] [--speed 1|10|max] [--port N]
+//   aman-replay FILE --summary
+
+struct ReplayOptions {
+    std::string capturePath;
+    int clientId = 0;           // 0: the first client in the capture
+    double speed = 1;           // 0: as fast as possible
+    int port = 12345;
+    bool summary = false;
+};
+
+static bool parseOptions(int argc, char** argv, ReplayOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string name = argv[i];
+        if (name == "--summary") {
+            options.summary = true;
+            continue;
+        }
+        if (name.compare(0, 2, "--") != 0) {
+            options.capturePath = name;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (name == "--client") {
+            options.clientId = atoi(value.c_str());
+        } else if (name == "--speed") {
+            options.speed = value == "max" ? 0 : atof(value.c_str());
+            if (value != "max" && options.speed <= 0) {
+                return false;
+            }
+        } else if (name == "--port") {
+            options.port = atoi(value.c_str());
+        } else {
+            return false;
+        }
+    }
+    return !options.capturePath.empty();
+}
+
+static int printSummary(CaptureReader& reader) {
+    struct Totals {
+        uint64_t count = 0;
+        uint64_t rawBytes = 0;
+        uint64_t storedBytes = 0;
+    };
+    std::map<std::string, Totals> outbound;     // By message type
+    std::map<std::string, Totals> inbound;
+    std::map<int, Totals> framesByClient;
+    Totals file;
+    uint64_t connects = 0;
+    uint64_t droppedRecords = 0;
+    uint64_t lastTime = 0;
+
+    CaptureRecord record;
+    while (reader.next(record)) {
+        lastTime = record.timeMicros;
+        switch (record.type) {
+        case CaptureClientConnected:
+            connects++;
+            break;
+        case CaptureGap:
+            droppedRecords += record.droppedRecords;
+            break;
+        case CaptureInbound: {
+            Totals& totals = inbound[frameMessageType(*record.payload)];
+            totals.count++;
+            totals.rawBytes += record.payload->size();
+            file.rawBytes += record.payload->size();
+            file.storedBytes += record.storedBytes;
+            break;
+        }
+        case CaptureFrameSent:
+        case CaptureFrameRepeat: {
+            Totals& totals = outbound[frameMessageType(*record.payload)];
+            totals.count++;
+            totals.rawBytes += record.payload->size();
+            totals.storedBytes += record.storedBytes;
+            Totals& client = framesByClient[record.clientId];
+            client.count++;
+            client.rawBytes += record.payload->size();
+            if (record.type == CaptureFrameSent) {
+                file.rawBytes += record.payload->size();
+                file.storedBytes += record.storedBytes;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    if (!reader.getError().empty()) {
+        std::cerr << "Capture is damaged after " << lastTime / 1e6 << " s: " << reader.getError() << std::endl;
+    }
+
+    std::cout << "Duration " << lastTime / 1e6 << " s, " << connects << " client connection(s)";
+    if (droppedRecords > 0) {
+        std::cout << ", " << droppedRecords << " record(s) dropped by the writer";
+    }
+    std::cout << std::endl;
+    std::cout << "Payloads: " << file.rawBytes << " bytes, stored as " << file.storedBytes << " ("
+        << (file.storedBytes > 0 ? (double)file.rawBytes / file.storedBytes : 0) << "x)" << std::endl;
+    for (auto& entry : framesByClient) {
+        std::cout << "Client " << entry.first << ": " << entry.second.count << " frames, " << entry.second.rawBytes << " bytes" << std::endl;
+    }
+    for (auto& entry : outbound) {
+        std::cout << "  sent " << entry.first << ": " << entry.second.count << " frames, " << entry.second.rawBytes << " bytes" << std::endl;
+    }
+    for (auto& entry : inbound) {
+        std::cout << "  received " << entry.first << ": " << entry.second.count << " messages" << std::endl;
+    }
+    return 0;
+}
+
+static SOCKET acceptOneClient(int port) {
+    SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+#ifndef _WIN32
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons((unsigned short)port);
+    if (bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) == SOCKET_ERROR
+        || listen(listenSocket, 1) == SOCKET_ERROR) {
+        closeSocket(listenSocket);
+        return INVALID_SOCKET;
+    }
+
+    std::cerr << "Waiting for a client on port " << port << "..." << std::endl;
+    SOCKET clientSocket = accept(listenSocket, nullptr, nullptr);
+    closeSocket(listenSocket);
+    return clientSocket;
+}
+
+// Blocking write of one frame and, for JSON, its delimiter
+static bool sendFrame(SOCKET socket, const std::string& frame) {
+    SendSlice slices[2] = { { frame.data(), frame.size() }, { "\n", 1 } };
+    size_t count = isCborFrame(frame) ? 1 : 2;
+    size_t first = 0;
+    while (first < count) {
+        int result = sendVectored(socket, slices + first, count - first);
+        if (result == SOCKET_ERROR) {
+            return false;
+        }
+        size_t written = (size_t)result;
+        while (first < count && written >= slices[first].length) {
+            written -= slices[first].length;
+            first++;
+        }
+        if (first < count) {
+            slices[first].data += written;
+            slices[first].length -= written;
+        }
+    }
+    return true;
+}
+
+static int replay(CaptureReader& reader, const ReplayOptions& options) {
+    if (!socketStartup()) {
+        std::cerr << "Socket startup failed" << std::endl;
+        return 1;
+    }
+    SOCKET clientSocket = acceptOneClient(options.port);
+    if (clientSocket == INVALID_SOCKET) {
+        std::cerr << "Cannot serve on port " << options.port << ": error " << socketLastError() << std::endl;
+        return 1;
+    }
+
+    // The client's commands have nothing to act on; keep its socket drained
+    std::atomic<uint64_t> messagesReceived(0);
+    std::thread drainThread([clientSocket, &messagesReceived] {
+        char buffer[4096];
+        int received;
+        while ((received = recv(clientSocket, buffer, sizeof(buffer), 0)) > 0) {
+            for (int i = 0; i < received; i++) {
+                if (buffer[i] == '\n') {
+                    messagesReceived++;
+                }
+            }
+        }
+    });
+
+    int clientId = options.clientId;
+    uint64_t firstFrameMicros = 0;
+    uint64_t lastFrameMicros = 0;
+    uint64_t framesSent = 0;
+    uint64_t bytesSent = 0;
+    bool clientGone = false;
+    std::chrono::steady_clock::time_point started;
+
+    CaptureRecord record;
+    while (!clientGone && reader.next(record)) {
+        if (clientId == 0 && (record.type == CaptureClientConnected || record.type == CaptureFrameSent || record.type == CaptureFrameRepeat)) {
+            clientId = record.clientId;
+            std::cerr << "Replaying client " << clientId << std::endl;
+        }
+        if (record.clientId != clientId) {
+            continue;
+        }
+        if (record.type == CaptureClientDisconnected) {
+            break;
+        }
+        if (record.type != CaptureFrameSent && record.type != CaptureFrameRepeat) {
+            continue;
+        }
+
+        if (framesSent == 0) {
+            firstFrameMicros = record.timeMicros;
+            started = std::chrono::steady_clock::now();
+        } else if (options.speed > 0) {
+            auto offset = std::chrono::microseconds((int64_t)((record.timeMicros - firstFrameMicros) / options.speed));
+            std::this_thread::sleep_until(started + offset);
+        }
+
+        if (!sendFrame(clientSocket, *record.payload)) {
+            std::cerr << "Client went away: error " << socketLastError() << std::endl;
+            clientGone = true;
+            break;
+        }
+        lastFrameMicros = record.timeMicros;
+        framesSent++;
+        bytesSent += record.payload->size() + 1;
+    }
+    if (!reader.getError().empty()) {
+        std::cerr << "Capture is damaged: " << reader.getError() << std::endl;
+    }
+
+    double elapsedSeconds = framesSent > 0 ? std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() : 0;
+    double capturedSeconds = (lastFrameMicros - firstFrameMicros) / 1e6;
+
+    // Closing our side ends the drain thread once the client closes too
+#ifdef _WIN32
+    shutdown(clientSocket, SD_BOTH);
+#else
+    shutdown(clientSocket, SHUT_RDWR);
+#endif
+    drainThread.join();
+    closeSocket(clientSocket);
+    socketCleanup();
+
+    std::cerr << "Sent " << framesSent << " frames (" << bytesSent << " bytes) covering " << capturedSeconds << " s in "
+        << elapsedSeconds << " s";
+    if (elapsedSeconds > 0) {
+        std::cerr << " (" << capturedSeconds / elapsedSeconds << "x)";
+    }
+    std::cerr << ", received " << messagesReceived << " messages" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    ReplayOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: aman-replay FILE [--client N] [--speed 1|10|max] [--port N]" << std::endl;
+        std::cerr << "       aman-replay FILE --summary" << std::endl;
+        return 1;
+    }
+
+    CaptureReader reader;
+    std::string error;
+    if (!reader.open(options.capturePath, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    return options.summary ? printSummary(reader) : replay(reader, options);
+}
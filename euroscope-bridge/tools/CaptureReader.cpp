@@ -0,0 +1,123 @@
+#include "CaptureReader.h"
+#include "FrameCompression.h"
+
+#include <cstring>
+
+bool CaptureReader::open(const std::string& path, std::string& error) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    char magic[CAPTURE_MAGIC_LENGTH];
+    if (!file.read(magic, sizeof(magic)) || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0
+        || !readVarint(startUnixMicros)) {
+        error = path + " is not an Aman capture";
+        return false;
+    }
+
+    frames.assign(CAPTURE_FRAME_WINDOW, std::string());
+    frameIds.assign(CAPTURE_FRAME_WINDOW, UINT64_MAX);
+    return true;
+}
+
+bool CaptureReader::next(CaptureRecord& record) {
+    int type = file.get();
+    if (type == EOF) {
+        return false;
+    }
+
+    record = CaptureRecord();
+    record.type = (CaptureRecordType)type;
+    uint64_t delta;
+    if (!readVarint(delta)) {
+        return false;
+    }
+    timeMicros += delta;
+    record.timeMicros = timeMicros;
+
+    uint64_t value;
+    switch (record.type) {
+    case CaptureGap:
+        return readVarint(record.droppedRecords);
+
+    case CaptureClientConnected:
+    case CaptureClientDisconnected:
+        if (!readVarint(value)) {
+            return false;
+        }
+        record.clientId = (int)value;
+        return true;
+
+    case CaptureInbound:
+        if (!readVarint(value) || !readPayload(inbound, record.storedBytes)) {
+            return false;
+        }
+        record.clientId = (int)value;
+        record.payload = &inbound;
+        return true;
+
+    case CaptureFrameSent:
+    case CaptureFrameRepeat: {
+        if (!readVarint(value) || !readVarint(record.frameId)) {
+            return false;
+        }
+        record.clientId = (int)value;
+        size_t slot = (size_t)(record.frameId % CAPTURE_FRAME_WINDOW);
+        if (record.type == CaptureFrameSent) {
+            if (!readPayload(frames[slot], record.storedBytes)) {
+                return false;
+            }
+            frameIds[slot] = record.frameId;
+        } else if (frameIds[slot] != record.frameId) {
+            return fail("repeat of unknown frame " + std::to_string(record.frameId));
+        }
+        record.payload = &frames[slot];
+        return true;
+    }
+
+    default:
+        return fail("unknown record type " + std::to_string(type));
+    }
+}
+
+bool CaptureReader::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = file.get();
+        if (byte == EOF) {
+            return false;
+        }
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return fail("malformed varint");
+}
+
+bool CaptureReader::readPayload(std::string& payload, uint64_t& storedBytes) {
+    uint64_t rawLength;
+    if (!readVarint(rawLength) || !readVarint(storedBytes)) {
+        return false;
+    }
+    if (storedBytes > rawLength) {
+        return fail("stored payload larger than its raw length");
+    }
+
+    std::string& target = storedBytes == rawLength ? payload : stored;
+    target.resize((size_t)storedBytes);
+    if (storedBytes > 0 && !file.read(&target[0], (std::streamsize)storedBytes)) {
+        return false;
+    }
+    if (storedBytes < rawLength && !decompressBlock(stored.data(), stored.size(), (size_t)rawLength, payload)) {
+        return fail("damaged compressed payload");
+    }
+    return true;
+}
+
+bool CaptureReader::fail(const std::string& message) {
+    error = message;
+    return false;
+}
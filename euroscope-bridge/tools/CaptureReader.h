@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CaptureFormat.h"
+
+struct CaptureRecord {
+    CaptureRecordType type;
+    uint64_t timeMicros = 0;            // Since the start of the capture
+    int clientId = 0;
+    uint64_t frameId = 0;               // CaptureFrameSent, CaptureFrameRepeat
+    uint64_t droppedRecords = 0;        // CaptureGap
+    const std::string* payload = nullptr;   // Decompressed; valid until the next call to next()
+    uint64_t storedBytes = 0;           // Payload bytes in the file, 0 for a repeat
+};
+
+// Sequential reader for .amancap files. Repeated frames are resolved, so every frame record
+// comes with its payload.
+class CaptureReader {
+public:
+    bool open(const std::string& path, std::string& error);
+    // False at the end of the capture. A capture cut short by a crash ends at its last complete
+    // record; anything else unreadable sets getError().
+    bool next(CaptureRecord& record);
+
+    uint64_t getStartUnixMicros() const { return startUnixMicros; }
+    const std::string& getError() const { return error; }
+
+private:
+    bool readVarint(uint64_t& value);
+    bool readPayload(std::string& payload, uint64_t& storedBytes);
+    bool fail(const std::string& message);
+
+    std::ifstream file;
+    std::string error;
+    uint64_t startUnixMicros = 0;
+    uint64_t timeMicros = 0;
+    std::string inbound;
+    std::string stored;
+    // The frames a repeat may refer to, by frameId % CAPTURE_FRAME_WINDOW
+    std::vector<std::string> frames;
+    std::vector<uint64_t> frameIds;
+};